@@ -0,0 +1,40 @@
+#ifndef I2CLIB_BENCHMARK_ALLOCATIONCOUNTER_HPP
+#define I2CLIB_BENCHMARK_ALLOCATIONCOUNTER_HPP
+
+#include "../test/AllocationCounter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+namespace i2clib {
+    namespace benchmarks {
+        /** Reports the heap allocations per iteration as the allocs/op counter
+         *
+         * Create it just before the benchmark loop, and call \c stop right
+         * after it, before anything else touches the benchmark state (e.g.
+         * SetItemsProcessed, which allocates)
+         */
+        class AllocationCounter {
+            benchmark::State& m_state;
+            std::uint64_t m_start;
+
+        public:
+            explicit AllocationCounter(benchmark::State& state)
+                : m_state(state)
+                , m_start(tests::allocationCount())
+            {
+            }
+
+            /** Stop counting and set the counter */
+            void stop()
+            {
+                auto count = tests::allocationCount() - m_start;
+                m_state.counters["allocs/op"] = benchmark::Counter(
+                    static_cast<double>(count), benchmark::Counter::kAvgIterations);
+            }
+        };
+    }
+}
+
+#endif
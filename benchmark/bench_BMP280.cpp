@@ -0,0 +1,104 @@
+#include "AllocationCounter.hpp"
+
+#include <i2clib/BMP280.hpp>
+#include <i2clib/SimulatedBMP280.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+
+#include <vector>
+
+using namespace i2clib;
+
+static BMP280::Calibration datasheetCalibration()
+{
+    BMP280::Calibration calibration;
+    calibration.dig_T1 = 27504;
+    calibration.dig_T2 = 26435;
+    calibration.dig_T3 = -1000;
+    calibration.dig_P1 = 36477;
+    calibration.dig_P2 = -10685;
+    calibration.dig_P3 = 3024;
+    calibration.dig_P4 = 2855;
+    calibration.dig_P5 = 140;
+    calibration.dig_P6 = -7;
+    calibration.dig_P7 = 15500;
+    calibration.dig_P8 = -14600;
+    calibration.dig_P9 = 6000;
+    return calibration;
+}
+
+static void BMP280_compensate_T_int32(benchmark::State& state)
+{
+    auto calibration = datasheetCalibration();
+    int32_t raw = 519888;
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(raw);
+        auto result = BMP280::compensate_T_int32(raw, calibration);
+        benchmark::DoNotOptimize(result);
+    }
+    counter.stop();
+}
+BENCHMARK(BMP280_compensate_T_int32);
+
+static void BMP280_compensate_P_int32(benchmark::State& state)
+{
+    auto calibration = datasheetCalibration();
+    int32_t raw = 415148;
+    int32_t t_fine = BMP280::compensate_T_int32(519888, calibration).second;
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(raw);
+        auto result = BMP280::compensate_P_int32(raw, t_fine, calibration);
+        benchmark::DoNotOptimize(result);
+    }
+    counter.stop();
+}
+BENCHMARK(BMP280_compensate_P_int32);
+
+/** Reading the last measurement from a chip in normal mode */
+static void BMP280_read(benchmark::State& state)
+{
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setCalibration(datasheetCalibration());
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+
+    BMP280 chip(bus, 0x76);
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        auto measurement = chip.read();
+        benchmark::DoNotOptimize(measurement);
+    }
+    counter.stop();
+}
+BENCHMARK(BMP280_read);
+
+static void BMP280_compensateBatch(benchmark::State& state)
+{
+    auto calibration = datasheetCalibration();
+    auto implementation = static_cast<BMP280::BatchImplementation>(state.range(0));
+    if (!BMP280::hasBatchImplementation(implementation)) {
+        state.SkipWithError("implementation not available on this machine");
+        return;
+    }
+
+    size_t count = 4096;
+    std::vector<int32_t> raw_T(count, 519888), raw_P(count, 415148);
+    std::vector<int32_t> temperature(count);
+    std::vector<uint32_t> pressure(count);
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        BMP280::compensateBatch(count, raw_T.data(), raw_P.data(), calibration,
+            temperature.data(), pressure.data(), implementation);
+        benchmark::DoNotOptimize(pressure.data());
+    }
+    counter.stop();
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BMP280_compensateBatch)
+    ->ArgName("implementation")
+    ->Arg(BMP280::BATCH_SCALAR)
+    ->Arg(BMP280::BATCH_SSE41)
+    ->Arg(BMP280::BATCH_AVX2)
+    ->Arg(BMP280::BATCH_NEON);
@@ -0,0 +1,97 @@
+#include "AllocationCounter.hpp"
+
+#include <i2clib/AsyncI2CBus.hpp>
+#include <i2clib/I2CBusScheduler.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+
+using namespace i2clib;
+
+/** Per-call overhead of the transport layer, against a bus without latency
+ *
+ * The overhead of the real I2CBus is measured by I2CBus/read_1_byte, see
+ * main.cpp
+ */
+static void SimulatedI2CBus_read(benchmark::State& state)
+{
+    SimulatedI2CBus bus;
+    SimulatedRegisterDevice device;
+    bus.attach(0x40, device);
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        auto bytes = bus.read<1>(0x40, 0x10);
+        benchmark::DoNotOptimize(bytes);
+    }
+    counter.stop();
+}
+BENCHMARK(SimulatedI2CBus_read);
+
+static void SimulatedI2CBus_write(benchmark::State& state)
+{
+    SimulatedI2CBus bus;
+    SimulatedRegisterDevice device;
+    bus.attach(0x40, device);
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        bus.write(0x40, {0x10, 1});
+    }
+    counter.stop();
+}
+BENCHMARK(SimulatedI2CBus_write);
+
+/** A batch of state.range(0) register reads */
+static void SimulatedI2CBus_transfer(benchmark::State& state)
+{
+    SimulatedI2CBus bus;
+    SimulatedRegisterDevice device;
+    bus.attach(0x40, device);
+
+    uint8_t reg = 0x10;
+    std::vector<uint8_t> bytes(state.range(0));
+    I2CTransactionBatch batch;
+    for (auto& byte : bytes) {
+        batch.read(0x40, &reg, 1, &byte, 1);
+    }
+
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        bus.transfer(batch);
+    }
+    counter.stop();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(SimulatedI2CBus_transfer)->Arg(1)->Arg(8)->Arg(21)->Arg(64);
+
+/** Round-trip of a blocking read through the AsyncI2CBus worker thread */
+static void AsyncI2CBus_read(benchmark::State& state)
+{
+    SimulatedRegisterDevice device;
+    auto* simulated_bus = new SimulatedI2CBus();
+    simulated_bus->attach(0x40, device);
+    AsyncI2CBus bus(std::unique_ptr<I2CTransport>{simulated_bus});
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        auto bytes = bus.read<1>(0x40, 0x10);
+        benchmark::DoNotOptimize(bytes);
+    }
+    counter.stop();
+}
+BENCHMARK(AsyncI2CBus_read)->UseRealTime();
+
+static void I2CBusScheduler_plan(benchmark::State& state)
+{
+    I2CBusScheduler scheduler;
+    for (int i = 0; i < state.range(0); ++i) {
+        I2CBusScheduler::Task task;
+        task.name = "task" + std::to_string(i);
+        task.period = base::Time::fromMilliseconds(10 << (i % 4));
+        task.cost = scheduler.transferDuration(1, 6);
+        scheduler.add(task);
+    }
+
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        scheduler.plan();
+    }
+    counter.stop();
+}
+BENCHMARK(I2CBusScheduler_plan)->Arg(4)->Arg(16);
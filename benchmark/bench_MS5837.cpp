@@ -0,0 +1,96 @@
+#include "AllocationCounter.hpp"
+
+#include <i2clib/MS5837.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+#include <i2clib/SimulatedMS5837.hpp>
+
+#include <vector>
+
+using namespace i2clib;
+
+static MS5837::PROM datasheetPROM()
+{
+    MS5837::PROM prom;
+    prom.C[0] = 0;
+    prom.C[1] = 34982;
+    prom.C[2] = 36352;
+    prom.C[3] = 20328;
+    prom.C[4] = 22354;
+    prom.C[5] = 26646;
+    prom.C[6] = 26146;
+    return prom;
+}
+
+static void MS5837_compensateRawTemperature(benchmark::State& state)
+{
+    auto prom = datasheetPROM();
+    int32_t raw = 6815414;
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(raw);
+        auto result = MS5837::compensateRawTemperature(raw, prom);
+        benchmark::DoNotOptimize(result);
+    }
+    counter.stop();
+}
+BENCHMARK(MS5837_compensateRawTemperature);
+
+static void MS5837_compensateRawPressure(benchmark::State& state)
+{
+    auto prom = datasheetPROM();
+    int32_t raw = 4958179;
+    int64_t dT = MS5837::compensateRawTemperature(6815414, prom).second;
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(raw);
+        auto result = MS5837::compensateRawPressure(raw, dT, prom);
+        benchmark::DoNotOptimize(result);
+    }
+    counter.stop();
+}
+BENCHMARK(MS5837_compensateRawPressure);
+
+/** A complete measurement cycle, without the conversion wait */
+static void MS5837_measurement_cycle(benchmark::State& state)
+{
+    SimulatedI2CBus bus;
+    SimulatedMS5837 device;
+    bus.attach(118, device);
+    device.setPROM(datasheetPROM());
+    device.setRawMeasurements(4958179, 6815414);
+    device.setSimulateConversionTime(false);
+
+    MS5837 chip(MS5837::MODEL_30BA, bus);
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        chip.startTemperatureConversion(0);
+        int32_t raw_temperature = chip.readConversionResult();
+        chip.startPressureConversion(0);
+        int32_t raw_pressure = chip.readConversionResult();
+        auto measurement = chip.compensate(raw_temperature, raw_pressure);
+        benchmark::DoNotOptimize(measurement);
+    }
+    counter.stop();
+}
+BENCHMARK(MS5837_measurement_cycle);
+
+static void MS5837_compensateBatch(benchmark::State& state)
+{
+    auto prom = datasheetPROM();
+    auto model = static_cast<MS5837::Models>(state.range(0));
+    size_t count = 4096;
+    std::vector<int32_t> raw_T(count, 6815414), raw_P(count, 4958179);
+    std::vector<int32_t> temperature(count), pressure(count);
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        MS5837::compensateBatch(model, count, raw_T.data(), raw_P.data(), prom,
+            temperature.data(), pressure.data());
+        benchmark::DoNotOptimize(pressure.data());
+    }
+    counter.stop();
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(MS5837_compensateBatch)
+    ->ArgName("model")
+    ->Arg(MS5837::MODEL_30BA)
+    ->Arg(MS5837::MODEL_02BA);
@@ -0,0 +1,132 @@
+#include "AllocationCounter.hpp"
+
+#include <i2clib/PCA9685.hpp>
+#include <i2clib/PCA9685DutyConversion.hpp>
+#include <i2clib/PCA9685Ramp.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+#include <i2clib/SimulatedPCA9685.hpp>
+
+#include <vector>
+
+using namespace i2clib;
+
+static void PCA9685_pwmConfigurationToRegisters(benchmark::State& state)
+{
+    PCA9685::PWMConfiguration configuration;
+    configuration.mode = PCA9685::PWMConfiguration::MODE_NORMAL;
+    configuration.on_edge = 100;
+    configuration.off_edge = 2148;
+    uint8_t registers[4];
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(configuration);
+        PCA9685::pwmConfigurationToRegisters(registers, configuration);
+        benchmark::DoNotOptimize(registers);
+    }
+    counter.stop();
+}
+BENCHMARK(PCA9685_pwmConfigurationToRegisters);
+
+/** Conversion of the 16 duty durations of a chip */
+static void PCA9685DutyConversion_fromDurations(benchmark::State& state)
+{
+    PCA9685DutyConversion conversion(PCA9685::prescaleToPeriod(121));
+    uint32_t durations[16];
+    for (int i = 0; i < 16; ++i) {
+        durations[i] = 1000000 + i * 62500;
+    }
+    PCA9685::PWMConfiguration configurations[16];
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(durations);
+        conversion.fromDurations(durations, 16, configurations);
+        benchmark::DoNotOptimize(configurations);
+    }
+    counter.stop();
+}
+BENCHMARK(PCA9685DutyConversion_fromDurations);
+
+struct PCA9685Fixture {
+    SimulatedI2CBus bus;
+    SimulatedPCA9685 device;
+    PCA9685 chip{bus, 0x40};
+
+    PCA9685Fixture()
+    {
+        bus.attach(0x40, device);
+        chip.writeNormalMode();
+    }
+};
+
+/** Update of all 16 channels, with every register changing */
+static void PCA9685_writeDutyRatios_all_changed(benchmark::State& state)
+{
+    PCA9685Fixture fixture;
+    std::vector<float> ratios[2] = {
+        std::vector<float>(16, 0.25), std::vector<float>(16, 0.75)
+    };
+    size_t i = 0;
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        fixture.chip.writeDutyRatios(0, ratios[i++ % 2]);
+    }
+    counter.stop();
+}
+BENCHMARK(PCA9685_writeDutyRatios_all_changed);
+
+/** Update of all 16 channels, with a single channel changing */
+static void PCA9685_writeDutyRatios_one_changed(benchmark::State& state)
+{
+    PCA9685Fixture fixture;
+    std::vector<float> ratios[2] = {
+        std::vector<float>(16, 0.3), std::vector<float>(16, 0.3)
+    };
+    ratios[1][7] = 0.6;
+    size_t i = 0;
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        fixture.chip.writeDutyRatios(0, ratios[i++ % 2]);
+    }
+    counter.stop();
+}
+BENCHMARK(PCA9685_writeDutyRatios_one_changed);
+
+/** Update of all 16 channels, that does not change anything */
+static void PCA9685_writeDutyRatios_unchanged(benchmark::State& state)
+{
+    PCA9685Fixture fixture;
+    std::vector<float> ratios(16, 0.3);
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        fixture.chip.writeDutyRatios(0, ratios);
+    }
+    counter.stop();
+}
+BENCHMARK(PCA9685_writeDutyRatios_unchanged);
+
+/** A tick of a ramp of all 16 channels, back and forth between 0.2 and 0.8 */
+static void PCA9685Ramp_step(benchmark::State& state)
+{
+    PCA9685Fixture fixture;
+    PCA9685Ramp ramp(fixture.chip, 0, 16, base::Time::fromMilliseconds(5));
+    PCA9685Ramp::Limits limits;
+    limits.max_rate = 2;
+    limits.max_acceleration = 20;
+    for (int i = 0; i < 16; ++i) {
+        ramp.setLimits(i, limits);
+        ramp.setPosition(i, 0.2);
+    }
+
+    float target = 0.8;
+    benchmarks::AllocationCounter counter(state);
+    for (auto _ : state) {
+        if (!ramp.step()) {
+            target = 1 - target;
+            for (int i = 0; i < 16; ++i) {
+                ramp.setTarget(i, target);
+            }
+        }
+    }
+    counter.stop();
+}
+BENCHMARK(PCA9685Ramp_step);
@@ -0,0 +1,48 @@
+#include "AllocationCounter.hpp"
+
+#include <i2clib/I2CBus.hpp>
+
+#include <cstdlib>
+#include <string>
+
+using namespace i2clib;
+
+/** Overhead of a one-byte register read on a real bus
+ *
+ * Enabled by setting I2CLIB_BENCHMARK_BUS to the i2c device (e.g. /dev/i2c-1)
+ * and I2CLIB_BENCHMARK_ADDRESS to the address of a device on that bus
+ */
+static void registerI2CBusBenchmark()
+{
+    char const* path = std::getenv("I2CLIB_BENCHMARK_BUS");
+    char const* address = std::getenv("I2CLIB_BENCHMARK_ADDRESS");
+    if (!path || !address) {
+        return;
+    }
+
+    std::string bus_path(path);
+    uint8_t device = std::stoi(address, nullptr, 0);
+    auto run = [bus_path, device](benchmark::State& state) {
+        I2CBus bus(bus_path);
+        benchmarks::AllocationCounter counter(state);
+        for (auto _ : state) {
+            auto bytes = bus.read<1>(device, 0);
+            benchmark::DoNotOptimize(bytes);
+        }
+        counter.stop();
+    };
+    benchmark::RegisterBenchmark("I2CBus/read_1_byte", run)->UseRealTime();
+}
+
+int main(int argc, char** argv)
+{
+    registerI2CBusBenchmark();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include <i2clib/AsyncI2CBus.hpp>
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/I2CBus.hpp>
+
+using namespace i2clib;
+using namespace std;
+
+AsyncI2CBus::SubmissionQueue::SubmissionQueue()
+    : m_head(&m_stub)
+    , m_tail(&m_stub)
+{
+}
+
+void AsyncI2CBus::SubmissionQueue::push(Node* node)
+{
+    node->next.store(nullptr, memory_order_relaxed);
+    Node* previous = m_head.exchange(node, memory_order_acq_rel);
+    previous->next.store(node, memory_order_release);
+}
+
+AsyncI2CBus::Node* AsyncI2CBus::SubmissionQueue::pop()
+{
+    Node* tail = m_tail;
+    Node* next = tail->next.load(memory_order_acquire);
+    if (tail == &m_stub) {
+        if (!next) {
+            return nullptr;
+        }
+        m_tail = next;
+        tail = next;
+        next = next->next.load(memory_order_acquire);
+    }
+
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+
+    // tail is the last node. We can't remove it without having another node
+    // behind it, so push the stub back
+    if (tail != m_head.load(memory_order_acquire)) {
+        // A push is in progress
+        return nullptr;
+    }
+    push(&m_stub);
+    next = tail->next.load(memory_order_acquire);
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+AsyncI2CBus::PriorityTransport::PriorityTransport(AsyncI2CBus& bus, Priority priority)
+    : m_bus(bus)
+    , m_priority(priority)
+{
+}
+
+void AsyncI2CBus::PriorityTransport::read(uint8_t address,
+    uint8_t* write_bytes,
+    size_t write_size,
+    uint8_t* bytes,
+    size_t size)
+{
+    I2CTransactionBatch batch;
+    batch.read(address, write_bytes, write_size, bytes, size);
+    try {
+        m_bus.submit(batch, m_priority).get();
+    }
+    catch (BatchError const& e) {
+        throw ReadError(e.what(), e.error_code);
+    }
+}
+
+void AsyncI2CBus::PriorityTransport::write(uint8_t address, uint8_t* bytes, size_t size)
+{
+    I2CTransactionBatch batch;
+    batch.write(address, bytes, size);
+    try {
+        m_bus.submit(batch, m_priority).get();
+    }
+    catch (BatchError const& e) {
+        throw WriteError(e.what(), e.error_code);
+    }
+}
+
+void AsyncI2CBus::PriorityTransport::transfer(I2CTransactionBatch const& batch)
+{
+    m_bus.submit(batch, m_priority).get();
+}
+
+AsyncI2CBus::AsyncI2CBus(string const& path)
+    : AsyncI2CBus(unique_ptr<I2CTransport>(new I2CBus(path)))
+{
+}
+
+AsyncI2CBus::AsyncI2CBus(unique_ptr<I2CTransport> transport)
+    : m_transport(move(transport))
+{
+    for (int i = 0; i < PRIORITY_COUNT; ++i) {
+        m_priority_transports[i].reset(
+            new PriorityTransport(*this, static_cast<Priority>(i)));
+    }
+    m_worker = thread([this] { run(); });
+}
+
+AsyncI2CBus::~AsyncI2CBus()
+{
+    m_quit.store(true);
+    {
+        lock_guard<mutex> lock(m_wakeup_mutex);
+    }
+    m_wakeup.notify_one();
+    m_worker.join();
+}
+
+future<void> AsyncI2CBus::submit(I2CTransactionBatch const& batch, Priority priority)
+{
+    auto* submission = new Submission();
+    submission->batch = batch;
+    submission->has_promise = true;
+    auto result = submission->promise.get_future();
+    push(submission, priority);
+    return result;
+}
+
+void AsyncI2CBus::submit(I2CTransactionBatch const& batch,
+    Priority priority,
+    Callback callback)
+{
+    auto* submission = new Submission();
+    submission->batch = batch;
+    submission->callback = move(callback);
+    push(submission, priority);
+}
+
+I2CTransport& AsyncI2CBus::withPriority(Priority priority)
+{
+    return *m_priority_transports[priority];
+}
+
+void AsyncI2CBus::push(Submission* submission, Priority priority)
+{
+    // Count the submission before publishing it, so that the worker can't
+    // pop it and decrement the counter first
+    m_pending.fetch_add(1);
+    m_queues[priority].push(submission);
+
+    // Only take the lock if the worker might be waiting. Otherwise, it will
+    // see the submission on its next iteration
+    if (m_worker_sleeping.load()) {
+        {
+            lock_guard<mutex> lock(m_wakeup_mutex);
+        }
+        m_wakeup.notify_one();
+    }
+}
+
+AsyncI2CBus::Submission* AsyncI2CBus::pop()
+{
+    for (auto& queue : m_queues) {
+        if (auto* node = queue.pop()) {
+            m_pending.fetch_sub(1);
+            return static_cast<Submission*>(node);
+        }
+    }
+    return nullptr;
+}
+
+void AsyncI2CBus::complete(Submission* submission, exception_ptr error)
+{
+    if (submission->has_promise) {
+        if (error) {
+            submission->promise.set_exception(error);
+        }
+        else {
+            submission->promise.set_value();
+        }
+    }
+    else if (submission->callback) {
+        submission->callback(error);
+    }
+    delete submission;
+}
+
+void AsyncI2CBus::run()
+{
+    while (!m_quit.load()) {
+        if (auto* submission = pop()) {
+            exception_ptr error;
+            try {
+                m_transport->transfer(submission->batch);
+            }
+            catch (...) {
+                error = current_exception();
+            }
+            complete(submission, error);
+            continue;
+        }
+
+        if (m_pending.load() > 0) {
+            // A push is in progress, it will be visible shortly
+            this_thread::yield();
+            continue;
+        }
+
+        m_worker_sleeping.store(true);
+        {
+            unique_lock<mutex> lock(m_wakeup_mutex);
+            m_wakeup.wait(lock, [this] { return m_pending.load() > 0 || m_quit.load(); });
+        }
+        m_worker_sleeping.store(false);
+    }
+
+    // Fail the submissions that were not performed from the worker as well,
+    // so that the callbacks are always called from the same thread
+    while (m_pending.load() > 0) {
+        if (auto* submission = pop()) {
+            complete(submission,
+                make_exception_ptr(IOError("AsyncI2CBus destroyed before the "
+                                           "submission was performed")));
+        }
+    }
+}
+
+void AsyncI2CBus::read(uint8_t address,
+    uint8_t* write_bytes,
+    size_t write_size,
+    uint8_t* bytes,
+    size_t size)
+{
+    withPriority(PRIORITY_NORMAL).read(address, write_bytes, write_size, bytes, size);
+}
+
+void AsyncI2CBus::write(uint8_t address, uint8_t* bytes, size_t size)
+{
+    withPriority(PRIORITY_NORMAL).write(address, bytes, size);
+}
+
+void AsyncI2CBus::transfer(I2CTransactionBatch const& batch)
+{
+    withPriority(PRIORITY_NORMAL).transfer(batch);
+}
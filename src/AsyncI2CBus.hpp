@@ -0,0 +1,166 @@
+#ifndef I2CLIB_ASYNCI2CBUS_HPP
+#define I2CLIB_ASYNCI2CBUS_HPP
+
+#include <i2clib/I2CTransport.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace i2clib {
+    /** Access to an i2c bus from a dedicated worker thread
+     *
+     * Transactions are submitted as I2CTransactionBatch objects, through
+     * lock-free submission queues. The worker thread performs them in order of
+     * priority, and reports completion through either a future or a callback.
+     *
+     * The I2CTransport interface is implemented as blocking wrappers on top of
+     * the submission queue at PRIORITY_NORMAL. Use \c withPriority to get an
+     * I2CTransport object that submits at a different priority, e.g. to have the
+     * PCA9685 writes jump ahead of the sensor reads.
+     */
+    class AsyncI2CBus : public I2CTransport {
+    public:
+        enum Priority {
+            PRIORITY_HIGH,
+            PRIORITY_NORMAL,
+            PRIORITY_LOW,
+            PRIORITY_COUNT
+        };
+
+        /** Function called by the worker thread when a submission is completed
+         *
+         * The argument is null on success, and holds the exception otherwise.
+         * The callback must not throw. It must not wait for another submission
+         * either, e.g. by calling the blocking read, write and transfer
+         * methods, as the worker would wait for itself
+         */
+        using Callback = std::function<void(std::exception_ptr)>;
+
+    private:
+        struct Node {
+            std::atomic<Node*> next{nullptr};
+        };
+
+        struct Submission : Node {
+            I2CTransactionBatch batch;
+            Callback callback;
+            std::promise<void> promise;
+            bool has_promise = false;
+        };
+
+        /** Multiple-producer single-consumer intrusive queue (Vyukov's)
+         *
+         * push is wait-free, pop is lock-free but may return null while a push
+         * is in progress
+         */
+        class SubmissionQueue {
+            std::atomic<Node*> m_head;
+            Node* m_tail;
+            Node m_stub;
+
+        public:
+            SubmissionQueue();
+
+            void push(Node* node);
+            Node* pop();
+        };
+
+        /** I2CTransport implementation that submits at a given priority */
+        class PriorityTransport : public I2CTransport {
+            AsyncI2CBus& m_bus;
+            Priority m_priority;
+
+        public:
+            PriorityTransport(AsyncI2CBus& bus, Priority priority);
+
+            using I2CTransport::read;
+            using I2CTransport::write;
+
+            void read(uint8_t address,
+                uint8_t* write_bytes,
+                size_t write_size,
+                uint8_t* bytes,
+                size_t size) override;
+            void write(uint8_t address, uint8_t* bytes, size_t size) override;
+            void transfer(I2CTransactionBatch const& batch) override;
+        };
+
+        std::unique_ptr<I2CTransport> m_transport;
+        SubmissionQueue m_queues[PRIORITY_COUNT];
+        std::unique_ptr<PriorityTransport> m_priority_transports[PRIORITY_COUNT];
+
+        std::atomic<size_t> m_pending{0};
+        std::atomic<bool> m_worker_sleeping{false};
+        std::atomic<bool> m_quit{false};
+        std::mutex m_wakeup_mutex;
+        std::condition_variable m_wakeup;
+        std::thread m_worker;
+
+        void push(Submission* submission, Priority priority);
+        Submission* pop();
+        void run();
+        static void complete(Submission* submission, std::exception_ptr error);
+
+    public:
+        /** Open the given i2c device and start the worker thread */
+        explicit AsyncI2CBus(std::string const& path);
+
+        /** Start a worker thread that uses the given transport
+         *
+         * The transport is accessed only from the worker thread
+         */
+        explicit AsyncI2CBus(std::unique_ptr<I2CTransport> transport);
+
+        /** Stop the worker thread
+         *
+         * Submissions that have not been performed yet fail with IOError. The
+         * worker completes them before it exits
+         */
+        ~AsyncI2CBus() override;
+
+        /** Submit a batch for execution
+         *
+         * The batch is copied, but the buffers it refers to must remain valid
+         * until the future is ready
+         */
+        std::future<void> submit(I2CTransactionBatch const& batch,
+            Priority priority = PRIORITY_NORMAL);
+
+        /** Submit a batch for execution, and get notified with a callback
+         *
+         * The batch is copied, but the buffers it refers to must remain valid
+         * until the callback is called. The callback is called from the worker
+         * thread, including when the submission fails because the bus is
+         * destroyed. See \c Callback for its restrictions
+         */
+        void submit(I2CTransactionBatch const& batch,
+            Priority priority,
+            Callback callback);
+
+        /** An I2CTransport whose blocking methods submit at the given priority
+         *
+         * The returned object is owned by this bus
+         */
+        I2CTransport& withPriority(Priority priority);
+
+        using I2CTransport::read;
+        using I2CTransport::write;
+
+        void read(uint8_t address,
+            uint8_t* write_bytes,
+            size_t write_size,
+            uint8_t* bytes,
+            size_t size) override;
+        void write(uint8_t address, uint8_t* bytes, size_t size) override;
+        void transfer(I2CTransactionBatch const& batch) override;
+    };
+}
+
+#endif
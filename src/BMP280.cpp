@@ -1,20 +1,106 @@
 #include <i2clib/BMP280.hpp>
+#include <i2clib/CalibrationCache.hpp>
+#include <i2clib/ClockAnchor.hpp>
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/I2CTransactionBatch.hpp>
 
 #include <base/Float.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 using namespace base;
 using namespace i2clib;
 using namespace std;
 
-BMP280::BMP280(I2CBus& bus, std::uint8_t address)
+BMP280::BMP280(I2CTransport& bus, std::uint8_t address)
     : m_i2c(bus)
     , m_address(address)
 {
     m_calibration = readCalibration();
 }
 
+BMP280::BMP280(I2CTransport& bus, std::uint8_t address, Calibration const& calibration)
+    : m_i2c(bus)
+    , m_address(address)
+    , m_calibration(calibration)
+{
+}
+
+BMP280 BMP280::fastInit(I2CTransport& bus,
+    uint8_t address,
+    Configuration const& conf,
+    BMP280Measurement& measurement,
+    CalibrationCache* cache,
+    string const& bus_path)
+{
+    string key;
+    vector<uint8_t> cached;
+    if (cache) {
+        key = CalibrationCache::key("bmp280", bus_path, address);
+        if (!cache->get(key, cached) || cached.size() != 1 + CALIBRATION_SIZE) {
+            cached.clear();
+        }
+    }
+
+    // With a cached calibration, only read the first calibration word to
+    // verify that it is still the same chip
+    uint8_t id_register = REGISTER_ID;
+    uint8_t calibration_register = REGISTER_COMPENSATION_PARAMETERS_START;
+    uint8_t id = 0;
+    array<uint8_t, CALIBRATION_SIZE> calibration_bytes;
+    size_t calibration_read_size = cached.empty() ? CALIBRATION_SIZE : 2;
+    auto config = configurationRegisters(MODE_FORCED, conf);
+
+    I2CTransactionBatch batch;
+    batch.read(address, &id_register, 1, &id, 1);
+    batch.read(address,
+        &calibration_register,
+        1,
+        calibration_bytes.data(),
+        calibration_read_size);
+    batch.write(address, config.data(), config.size());
+    bus.transfer(batch);
+    auto start = chrono::steady_clock::now();
+    if (id != CHIP_ID) {
+        throw ReadError("device at address " + to_string(address) + " has ID " +
+                        to_string(id) + ", expected the BMP280 ID " +
+                        to_string(CHIP_ID));
+    }
+
+    bool cache_hit = !cached.empty() && cached[0] == id &&
+                     equal(cached.begin() + 1, cached.begin() + 3, calibration_bytes.begin());
+    if (cache_hit) {
+        copy(cached.begin() + 1, cached.end(), calibration_bytes.begin());
+    }
+    else {
+        if (calibration_read_size != CALIBRATION_SIZE) {
+            bus.read(address, &calibration_register, 1, calibration_bytes.data(),
+                CALIBRATION_SIZE);
+        }
+        if (cache) {
+            vector<uint8_t> entry{id};
+            entry.insert(entry.end(), calibration_bytes.begin(), calibration_bytes.end());
+            cache->set(key, entry);
+        }
+    }
+
+    BMP280 chip(bus, address, parseCalibration(calibration_bytes.data()));
+    chip.m_conf = conf;
+    measurement = chip.waitForcedMeasurement(start, 5);
+    return chip;
+}
+
+BMP280::Calibration BMP280::getCalibration() const
+{
+    return m_calibration;
+}
+
 uint8_t BMP280::readID()
 {
     return m_i2c.read<1>(m_address, REGISTER_ID)[0];
@@ -32,18 +118,29 @@ void BMP280::sleepAndWriteConfiguration(Configuration const& conf)
 }
 
 void BMP280::writeConfigurationRegisters(DeviceMode mode, Configuration const& conf)
+{
+    auto bytes = configurationRegisters(mode, conf);
+    m_i2c.write(m_address, bytes.data(), bytes.size());
+}
+
+array<uint8_t, 3> BMP280::configurationRegisters(DeviceMode mode,
+    Configuration const& conf)
 {
     uint8_t measurement_control =
         mode | (conf.pressure_oversampling << 2) | (conf.temperature_oversampling << 5);
     uint8_t config = (conf.iir_time_constant << 2) | (conf.standby_time << 5);
-
-    m_i2c.write(m_address, {REGISTER_MEASUREMENT_CONTROL, measurement_control, config});
+    return {REGISTER_MEASUREMENT_CONTROL, measurement_control, config};
 }
 
 BMP280::RawMeasurements BMP280::readRaw()
 {
-    RawMeasurements raw;
     auto bytes = m_i2c.read<6>(m_address, REGISTER_PRESSURE_START);
+    return parseRaw(bytes.data());
+}
+
+BMP280::RawMeasurements BMP280::parseRaw(uint8_t const* bytes)
+{
+    RawMeasurements raw;
     uint32_t p = (static_cast<uint32_t>(bytes[0]) << 16) | (static_cast<uint32_t>(bytes[1]) << 8) | bytes[2];
     raw.pressure = p >> 4;
     uint32_t t = (static_cast<uint32_t>(bytes[3]) << 16) | (static_cast<uint32_t>(bytes[4]) << 8) | bytes[5];
@@ -64,8 +161,13 @@ static int16_t lsb_msb_to_int16_t(uint8_t lsb, uint8_t msb)
 
 BMP280::Calibration BMP280::readCalibration()
 {
-    auto bytes = m_i2c.read<24>(m_address, REGISTER_COMPENSATION_PARAMETERS_START);
+    auto bytes =
+        m_i2c.read<CALIBRATION_SIZE>(m_address, REGISTER_COMPENSATION_PARAMETERS_START);
+    return parseCalibration(bytes.data());
+}
 
+BMP280::Calibration BMP280::parseCalibration(uint8_t const* bytes)
+{
     Calibration c;
     c.dig_T1 = lsb_msb_to_uint16_t(bytes[0], bytes[1]);
     c.dig_T2 = lsb_msb_to_int16_t(bytes[2], bytes[3]);
@@ -86,10 +188,33 @@ BMP280::Calibration BMP280::readCalibration()
 
 BMP280Measurement BMP280::read()
 {
-    BMP280Measurement result;
-    result.time = Time::now();
+    // The data registers hold the last finished measurement. We can't know when
+    // it happened, assume it just finished
+    auto end = chrono::steady_clock::now();
+    auto duration = chrono::microseconds(measurementDuration(m_conf).toMicroseconds());
+    return readMeasurement(end - duration, end);
+}
 
+BMP280Measurement BMP280::readMeasurement(chrono::steady_clock::time_point start,
+    chrono::steady_clock::time_point end)
+{
+    auto read_start = chrono::steady_clock::now();
     auto raw = readRaw();
+    auto read_end = chrono::steady_clock::now();
+    return makeMeasurement(start, end, raw, read_end - read_start);
+}
+
+BMP280Measurement BMP280::makeMeasurement(chrono::steady_clock::time_point start,
+    chrono::steady_clock::time_point end,
+    RawMeasurements const& raw,
+    chrono::steady_clock::duration transport_latency) const
+{
+    ClockAnchor anchor;
+    BMP280Measurement result;
+    result.time = anchor.toTime(start + (end - start) / 2);
+    result.acquisition_start = anchor.toTime(start);
+    result.acquisition_end = anchor.toTime(end);
+    result.transport_latency = ClockAnchor::toDuration(transport_latency);
     if (raw.pressure == 0x80000 || raw.temperature == 0x80000) {
         return result;
     }
@@ -101,6 +226,77 @@ BMP280Measurement BMP280::read()
     return result;
 }
 
+uint8_t BMP280::readStatus()
+{
+    return m_i2c.read<1>(m_address, REGISTER_STATUS)[0];
+}
+
+BMP280Measurement BMP280::readForced(int max_polls)
+{
+    if (max_polls < 1) {
+        throw invalid_argument("readForced needs at least one poll");
+    }
+
+    writeConfigurationRegisters(MODE_FORCED, m_conf);
+    auto start = chrono::steady_clock::now();
+    return waitForcedMeasurement(start, max_polls);
+}
+
+BMP280Measurement BMP280::waitForcedMeasurement(chrono::steady_clock::time_point start,
+    int max_polls)
+{
+    auto typical = chrono::microseconds(measurementDuration(m_conf).toMicroseconds());
+    auto max = chrono::microseconds(measurementDuration(m_conf, true).toMicroseconds());
+
+    // The polls are spread from the typical to the maximum duration, so that
+    // the last one happens once the measurement is guaranteed to be finished
+    for (int i = 0; i < max_polls; ++i) {
+        if (max_polls == 1) {
+            this_thread::sleep_until(start + max);
+        }
+        else {
+            this_thread::sleep_until(start + typical + (max - typical) * i / (max_polls - 1));
+        }
+
+        auto poll_time = chrono::steady_clock::now();
+        auto bytes = m_i2c.read<STATUS_AND_DATA_SIZE>(m_address, REGISTER_STATUS);
+        auto read_end = chrono::steady_clock::now();
+        if (!(bytes[0] & STATUS_MEASURING)) {
+            auto raw = parseRaw(bytes.data() + REGISTER_PRESSURE_START - REGISTER_STATUS);
+            return makeMeasurement(start, poll_time, raw, read_end - poll_time);
+        }
+    }
+
+    throw ReadError("BMP280 at address " + to_string(m_address) +
+                    " did not finish its measurement after " +
+                    to_string(max.count()) + "us");
+}
+
+static int oversamplingCount(BMP280Configuration::Oversampling oversampling)
+{
+    if (oversampling == BMP280Configuration::NO_SAMPLING) {
+        return 0;
+    }
+    return 1 << (oversampling - 1);
+}
+
+base::Time BMP280::measurementDuration(Configuration const& conf, bool max)
+{
+    // Section 3.8.1 of the datasheet, in microseconds
+    int64_t fixed = max ? 1250 : 1000;
+    int64_t per_sample = max ? 2300 : 2000;
+    int64_t pressure_setup = max ? 575 : 500;
+
+    int pressure_count = oversamplingCount(conf.pressure_oversampling);
+    int64_t duration =
+        fixed + per_sample * (oversamplingCount(conf.temperature_oversampling) +
+                                pressure_count);
+    if (pressure_count) {
+        duration += pressure_setup;
+    }
+    return base::Time::fromMicroseconds(duration);
+}
+
 /** Conversion from raw ADC values to temperature using the device's calibration
  *
  * Copied from the Bosch datasheet
@@ -111,6 +307,14 @@ BMP280Measurement BMP280::read()
  */
 pair<Temperature, int32_t> BMP280::compensate_T_int32(int32_t adc_T,
     BMP280::Calibration const& c)
+{
+    int32_t t_fine = compensateTFine(adc_T, c);
+    auto t = base::Temperature::fromCelsius(
+        static_cast<double>((t_fine * 5 + 128) >> 8) / 100.0);
+    return make_pair(t, t_fine);
+}
+
+int32_t BMP280::compensateTFine(int32_t adc_T, BMP280::Calibration const& c)
 {
     int32_t var1 =
         ((((adc_T >> 3) - ((int32_t)c.dig_T1 << 1))) * ((int32_t)c.dig_T2)) >> 11;
@@ -119,10 +323,7 @@ pair<Temperature, int32_t> BMP280::compensate_T_int32(int32_t adc_T,
              12) *
             ((int32_t)c.dig_T3)) >>
         14;
-    int32_t t_fine = var1 + var2;
-    auto t = base::Temperature::fromCelsius(
-        static_cast<double>((t_fine * 5 + 128) >> 8) / 100.0);
-    return make_pair(t, t_fine);
+    return var1 + var2;
 }
 
 /** Conversion from raw ADC values and temperature estimate to pressure using the device's
@@ -135,6 +336,17 @@ pair<Temperature, int32_t> BMP280::compensate_T_int32(int32_t adc_T,
 Pressure BMP280::compensate_P_int32(int32_t adc_P,
     int32_t t_fine,
     BMP280::Calibration const& c)
+{
+    uint32_t p = compensatePressure(adc_P, t_fine, c);
+    if (p == 0) {
+        return base::Pressure();
+    }
+    return Pressure::fromPascal(p);
+}
+
+uint32_t BMP280::compensatePressure(int32_t adc_P,
+    int32_t t_fine,
+    BMP280::Calibration const& c)
 {
     int32_t var1, var2;
     uint32_t p;
@@ -147,7 +359,7 @@ Pressure BMP280::compensate_P_int32(int32_t adc_P,
            18;
     var1 = ((((32768 + var1)) * ((int32_t)c.dig_P1)) >> 15);
     if (var1 == 0) {
-        return base::Pressure(); // avoid exception caused by division by zero
+        return 0; // avoid exception caused by division by zero
     }
     p = (((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
     if (p < 0x80000000) {
@@ -159,5 +371,5 @@ Pressure BMP280::compensate_P_int32(int32_t adc_P,
     var1 = (((int32_t)c.dig_P9) * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
     var2 = (((int32_t)(p >> 2)) * ((int32_t)c.dig_P8)) >> 13;
     p = (uint32_t)((int32_t)p + ((var1 + var2 + c.dig_P7) >> 4));
-    return Pressure::fromPascal(p);
+    return p;
 }
@@ -3,11 +3,17 @@
 
 #include <i2clib/BMP280Configuration.hpp>
 #include <i2clib/BMP280Measurement.hpp>
-#include <i2clib/I2CBus.hpp>
+#include <i2clib/I2CTransport.hpp>
 
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <string>
 
 namespace i2clib {
+    class CalibrationCache;
+    struct BMP280BatchKernels;
+
     /** Driver for Bosch's BMP280 i2c pressure sensor
      *
      * This is an _optionated_ driver. It does not implement all functions, only what
@@ -39,16 +45,27 @@ namespace i2clib {
             int16_t dig_T3 = 0;
         };
 
+        struct RawMeasurements {
+            uint32_t pressure;
+            uint32_t temperature;
+        };
+
     private:
         static constexpr std::uint8_t REGISTER_ID = 0xD0;
+        static constexpr std::uint8_t CHIP_ID = 0x58;
         static constexpr std::uint8_t REGISTER_STATUS = 0xF3;
         static constexpr std::uint8_t REGISTER_MEASUREMENT_CONTROL = 0xF4;
         static constexpr std::uint8_t REGISTER_CONFIG = 0xF5;
         static constexpr std::uint8_t REGISTER_PRESSURE_START = 0xF7;
         static constexpr std::uint8_t REGISTER_TEMPERATURE_START = 0xFA;
         static constexpr std::uint8_t REGISTER_COMPENSATION_PARAMETERS_START = 0x88;
+        static constexpr std::uint8_t STATUS_MEASURING = 1 << 3;
+        static constexpr std::size_t CALIBRATION_SIZE = 24;
+        /** Size of a read of the status register up to the end of the data
+         * registers */
+        static constexpr std::size_t STATUS_AND_DATA_SIZE = 10;
 
-        I2CBus& m_i2c;
+        I2CTransport& m_i2c;
 
         std::uint8_t m_address = 0;
         Configuration m_conf;
@@ -56,8 +73,105 @@ namespace i2clib {
 
         void writeConfigurationRegisters(DeviceMode mode, Configuration const& conf);
 
+        /** The register address and values written by
+         * \c writeConfigurationRegisters */
+        static std::array<std::uint8_t, 3> configurationRegisters(DeviceMode mode,
+            Configuration const& conf);
+
+        static Calibration parseCalibration(std::uint8_t const* bytes);
+        static RawMeasurements parseRaw(std::uint8_t const* bytes);
+
+        /** Read and compensate the data registers
+         *
+         * @param start start of the acquisition window
+         * @param end end of the acquisition window
+         */
+        BMP280Measurement readMeasurement(std::chrono::steady_clock::time_point start,
+            std::chrono::steady_clock::time_point end);
+
+        /** Compensate raw data and timestamp the result */
+        BMP280Measurement makeMeasurement(std::chrono::steady_clock::time_point start,
+            std::chrono::steady_clock::time_point end,
+            RawMeasurements const& raw,
+            std::chrono::steady_clock::duration transport_latency) const;
+
+        /** Wait for the end of a forced measurement and read it
+         *
+         * Each poll reads the status and data registers in a single
+         * transaction, so that the data is available as soon as the status
+         * reports the end of the measurement
+         *
+         * @param start the time at which the measurement was triggered
+         */
+        BMP280Measurement waitForcedMeasurement(std::chrono::steady_clock::time_point start,
+            int max_polls);
+
+        friend struct BMP280BatchKernels;
+
+        /** The Bosch reference temperature compensation, returning t_fine */
+        static std::int32_t compensateTFine(std::int32_t adc_T, Calibration const& c);
+
+        /** The Bosch reference pressure compensation, in Pa
+         *
+         * Returns zero if the calibration leads to a division by zero
+         */
+        static std::uint32_t compensatePressure(std::int32_t adc_P,
+            std::int32_t t_fine,
+            Calibration const& c);
+
     public:
-        BMP280(I2CBus& bus, std::uint8_t address);
+        /** Implementations of \c compensateBatch */
+        enum BatchImplementation {
+            /** The fastest implementation available on this machine */
+            BATCH_AUTO,
+            BATCH_SCALAR,
+            BATCH_SSE41,
+            BATCH_AVX2,
+            BATCH_NEON
+        };
+
+        BMP280(I2CTransport& bus, std::uint8_t address);
+
+        /** Create the driver with known calibration data
+         *
+         * Unlike the other constructor, this does not access the bus
+         */
+        BMP280(I2CTransport& bus, std::uint8_t address, Calibration const& calibration);
+
+        /** Create the driver and acquire a first measurement with as few
+         * transactions as possible
+         *
+         * The ID read, the calibration read and the configuration write that
+         * triggers a forced measurement are submitted as a single batch. The
+         * measurement is then read along with the status register, see
+         * \c readForced. This is meant for chips that are power-cycled often.
+         *
+         * With a cache, the calibration read is replaced by a read of the
+         * first calibration word. The cached calibration is used if both the ID
+         * and that word match, otherwise the calibration is read again and the
+         * cache updated. Only that word is verified: if the chip is replaced
+         * by one with the same first calibration word, the stale calibration
+         * is used. Clear the cache entry when swapping chips.
+         *
+         * @param conf the configuration of the first measurement. It is
+         *   retained as the driver's configuration
+         * @param measurement the first measurement
+         * @param cache optional calibration cache
+         * @param bus_path path of the bus, used to identify the chip in the
+         *   cache (see \c I2CBus::getPath)
+         * @throw ReadError if the chip ID is not the BMP280's, in which case
+         *   the cache is not updated, or if the measurement does not finish in
+         *   time
+         */
+        static BMP280 fastInit(I2CTransport& bus,
+            std::uint8_t address,
+            Configuration const& conf,
+            BMP280Measurement& measurement,
+            CalibrationCache* cache = nullptr,
+            std::string const& bus_path = std::string());
+
+        /** The calibration data in use */
+        Calibration getCalibration() const;
 
         /** Read the calibration data
          *
@@ -82,11 +196,6 @@ namespace i2clib {
          */
         void sleepAndWriteConfiguration(Configuration const& conf);
 
-        struct RawMeasurements {
-            uint32_t pressure;
-            uint32_t temperature;
-        };
-
         /** Read the raw data from registers
          *
          * The BMP280 requires a complex compensation calculation to actually produce
@@ -97,6 +206,35 @@ namespace i2clib {
         /** Read data and calculate the actual measurements */
         BMP280Measurement read();
 
+        /** Read the status register */
+        std::uint8_t readStatus();
+
+        /** Trigger a single measurement in forced mode and read it
+         *
+         * The method sleeps for the typical measurement duration given the
+         * current configuration (see \c measurementDuration), and then polls the
+         * status register until the measurement is finished. The polls are spread
+         * until the maximum measurement duration, the last one happening at the
+         * maximum duration. Each poll also reads the data registers, so the last
+         * poll returns the measurement.
+         *
+         * The chip is back in sleep mode once this method returns.
+         *
+         * @param max_polls maximum number of status reads
+         * @throw std::invalid_argument if max_polls is lower than 1
+         * @throw ReadError if the measurement is not finished after \c max_polls
+         *   reads
+         */
+        BMP280Measurement readForced(int max_polls = 5);
+
+        /** Duration of a single measurement from the datasheet
+         *
+         * @param max if true, return the maximum measurement time. Otherwise,
+         *   return the typical one
+         */
+        static base::Time measurementDuration(Configuration const& conf,
+            bool max = false);
+
         /** Conversion from raw ADC values to temperature using the device's calibration
          *
          * Copied from the Bosch datasheet
@@ -120,6 +258,40 @@ namespace i2clib {
         static base::Pressure compensate_P_int32(int32_t adc_P,
             std::int32_t t_fine,
             BMP280::Calibration const& c);
+
+        /** Compensate arrays of raw measurements
+         *
+         * This is meant to reprocess large amounts of logged raw data. The
+         * results are bit-exact with \c compensate_T_int32 and
+         * \c compensate_P_int32, in the datasheet's fixed-point units. Outputs
+         * may not alias the inputs.
+         *
+         * @param count number of samples
+         * @param adc_T raw temperatures
+         * @param adc_P raw pressures
+         * @param temperature output temperatures, in hundredths of degrees
+         *   Celsius
+         * @param pressure output pressures in Pa, zero if the calibration is
+         *   invalid
+         * @param implementation the implementation to use. This is meant for
+         *   testing and benchmarking
+         * @throw std::invalid_argument if the implementation is not available
+         *   on this machine
+         */
+        static void compensateBatch(std::size_t count,
+            std::int32_t const* adc_T,
+            std::int32_t const* adc_P,
+            Calibration const& c,
+            std::int32_t* temperature,
+            std::uint32_t* pressure,
+            BatchImplementation implementation = BATCH_AUTO);
+
+        /** Whether the given \c compensateBatch implementation can run on this
+         * machine */
+        static bool hasBatchImplementation(BatchImplementation implementation);
+
+        /** The implementation selected by BATCH_AUTO on this machine */
+        static BatchImplementation getBatchImplementation();
     };
 }
 
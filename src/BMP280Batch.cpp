@@ -0,0 +1,420 @@
+#include <i2clib/BMP280.hpp>
+
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define I2CLIB_BMP280_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define I2CLIB_BMP280_NEON 1
+#include <arm_neon.h>
+#endif
+
+using namespace i2clib;
+using namespace std;
+
+// The batch kernels are straight transcriptions of the Bosch reference code
+// (compensateTFine and compensatePressure) on 32 bits lanes. Multiplications
+// wrap the same way the scalar code does, and the only operation without an
+// integer SIMD equivalent, the unsigned division, is done in double precision.
+// This is exact: for a, b < 2^32, a/b is at least 1/b away from the next
+// integer, which is well above the rounding error of the double division.
+
+namespace {
+    using Kernel = void (*)(size_t count,
+        int32_t const* adc_T,
+        int32_t const* adc_P,
+        BMP280::Calibration const& c,
+        int32_t* temperature,
+        uint32_t* pressure);
+}
+
+namespace i2clib {
+    /** Gives the batch kernels access to the scalar reference */
+    struct BMP280BatchKernels {
+        static void scalar(size_t count,
+            int32_t const* adc_T,
+            int32_t const* adc_P,
+            BMP280::Calibration const& c,
+            int32_t* temperature,
+            uint32_t* pressure)
+        {
+            for (size_t i = 0; i < count; ++i) {
+                int32_t t_fine = BMP280::compensateTFine(adc_T[i], c);
+                temperature[i] = (t_fine * 5 + 128) >> 8;
+                pressure[i] = BMP280::compensatePressure(adc_P[i], t_fine, c);
+            }
+        }
+
+#if I2CLIB_BMP280_X86
+        __attribute__((target("sse4.1"))) static __m128i divideSSE41(__m128i n,
+            __m128i d)
+        {
+            // Unsigned to double conversion, by flipping the sign bit and
+            // adding 2^31 back
+            __m128i sign = _mm_set1_epi32(0x80000000);
+            __m128d offset = _mm_set1_pd(2147483648.0);
+            __m128i n_signed = _mm_xor_si128(n, sign);
+            __m128i d_signed = _mm_xor_si128(d, sign);
+
+            __m128d n_lo = _mm_add_pd(_mm_cvtepi32_pd(n_signed), offset);
+            __m128d n_hi = _mm_add_pd(_mm_cvtepi32_pd(_mm_srli_si128(n_signed, 8)), offset);
+            __m128d d_lo = _mm_add_pd(_mm_cvtepi32_pd(d_signed), offset);
+            __m128d d_hi = _mm_add_pd(_mm_cvtepi32_pd(_mm_srli_si128(d_signed, 8)), offset);
+
+            __m128d q_lo = _mm_sub_pd(_mm_floor_pd(_mm_div_pd(n_lo, d_lo)), offset);
+            __m128d q_hi = _mm_sub_pd(_mm_floor_pd(_mm_div_pd(n_hi, d_hi)), offset);
+            __m128i q = _mm_unpacklo_epi64(_mm_cvttpd_epi32(q_lo), _mm_cvttpd_epi32(q_hi));
+            return _mm_xor_si128(q, sign);
+        }
+
+        __attribute__((target("sse4.1"))) static void sse41(size_t count,
+            int32_t const* adc_T,
+            int32_t const* adc_P,
+            BMP280::Calibration const& c,
+            int32_t* temperature,
+            uint32_t* pressure)
+        {
+            __m128i const T1 = _mm_set1_epi32(c.dig_T1);
+            __m128i const T1x2 = _mm_set1_epi32(int32_t(c.dig_T1) << 1);
+            __m128i const T2 = _mm_set1_epi32(c.dig_T2);
+            __m128i const T3 = _mm_set1_epi32(c.dig_T3);
+            __m128i const P1 = _mm_set1_epi32(c.dig_P1);
+            __m128i const P2 = _mm_set1_epi32(c.dig_P2);
+            __m128i const P3 = _mm_set1_epi32(c.dig_P3);
+            __m128i const P4x65536 = _mm_set1_epi32(int32_t(c.dig_P4) * 65536);
+            __m128i const P5 = _mm_set1_epi32(c.dig_P5);
+            __m128i const P6 = _mm_set1_epi32(c.dig_P6);
+            __m128i const P7 = _mm_set1_epi32(c.dig_P7);
+            __m128i const P8 = _mm_set1_epi32(c.dig_P8);
+            __m128i const P9 = _mm_set1_epi32(c.dig_P9);
+            __m128i const zero = _mm_setzero_si128();
+
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                __m128i t = _mm_loadu_si128(reinterpret_cast<__m128i const*>(adc_T + i));
+                __m128i var1 = _mm_srai_epi32(
+                    _mm_mullo_epi32(_mm_sub_epi32(_mm_srai_epi32(t, 3), T1x2), T2),
+                    11);
+                __m128i dt = _mm_sub_epi32(_mm_srai_epi32(t, 4), T1);
+                __m128i var2 = _mm_srai_epi32(
+                    _mm_mullo_epi32(_mm_srai_epi32(_mm_mullo_epi32(dt, dt), 12), T3),
+                    14);
+                __m128i t_fine = _mm_add_epi32(var1, var2);
+                __m128i t_out = _mm_srai_epi32(
+                    _mm_add_epi32(_mm_mullo_epi32(t_fine, _mm_set1_epi32(5)),
+                        _mm_set1_epi32(128)),
+                    8);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(temperature + i), t_out);
+
+                __m128i adc = _mm_loadu_si128(reinterpret_cast<__m128i const*>(adc_P + i));
+                var1 = _mm_sub_epi32(_mm_srai_epi32(t_fine, 1), _mm_set1_epi32(64000));
+                __m128i var1_4 = _mm_srai_epi32(var1, 2);
+                __m128i square = _mm_mullo_epi32(var1_4, var1_4);
+                var2 = _mm_mullo_epi32(_mm_srai_epi32(square, 11), P6);
+                var2 = _mm_add_epi32(var2, _mm_slli_epi32(_mm_mullo_epi32(var1, P5), 1));
+                var2 = _mm_add_epi32(_mm_srai_epi32(var2, 2), P4x65536);
+                var1 = _mm_srai_epi32(
+                    _mm_add_epi32(
+                        _mm_srai_epi32(_mm_mullo_epi32(P3, _mm_srai_epi32(square, 13)), 3),
+                        _mm_srai_epi32(_mm_mullo_epi32(P2, var1), 1)),
+                    18);
+                var1 = _mm_srai_epi32(
+                    _mm_mullo_epi32(_mm_add_epi32(_mm_set1_epi32(32768), var1), P1),
+                    15);
+                __m128i invalid = _mm_cmpeq_epi32(var1, zero);
+
+                __m128i p = _mm_mullo_epi32(
+                    _mm_sub_epi32(_mm_sub_epi32(_mm_set1_epi32(1048576), adc),
+                        _mm_srai_epi32(var2, 12)),
+                    _mm_set1_epi32(3125));
+                // p < 0x80000000 ? (p << 1) / var1 : (p / var1) * 2
+                __m128i large = _mm_srai_epi32(p, 31);
+                __m128i n = _mm_blendv_epi8(_mm_slli_epi32(p, 1), p, large);
+                __m128i q = divideSSE41(n, var1);
+                p = _mm_blendv_epi8(q, _mm_slli_epi32(q, 1), large);
+
+                __m128i p_8 = _mm_srli_epi32(p, 3);
+                var1 = _mm_srai_epi32(
+                    _mm_mullo_epi32(P9, _mm_srli_epi32(_mm_mullo_epi32(p_8, p_8), 13)),
+                    12);
+                var2 = _mm_srai_epi32(_mm_mullo_epi32(_mm_srli_epi32(p, 2), P8), 13);
+                p = _mm_add_epi32(p,
+                    _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(var1, var2), P7), 4));
+                p = _mm_andnot_si128(invalid, p);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pressure + i), p);
+            }
+            scalar(count - i, adc_T + i, adc_P + i, c, temperature + i, pressure + i);
+        }
+
+        __attribute__((target("avx2"))) static __m256i divideAVX2(__m256i n, __m256i d)
+        {
+            __m256i sign = _mm256_set1_epi32(0x80000000);
+            __m256d offset = _mm256_set1_pd(2147483648.0);
+            __m256i n_signed = _mm256_xor_si256(n, sign);
+            __m256i d_signed = _mm256_xor_si256(d, sign);
+
+            __m256d n_lo = _mm256_add_pd(
+                _mm256_cvtepi32_pd(_mm256_castsi256_si128(n_signed)), offset);
+            __m256d n_hi = _mm256_add_pd(
+                _mm256_cvtepi32_pd(_mm256_extracti128_si256(n_signed, 1)), offset);
+            __m256d d_lo = _mm256_add_pd(
+                _mm256_cvtepi32_pd(_mm256_castsi256_si128(d_signed)), offset);
+            __m256d d_hi = _mm256_add_pd(
+                _mm256_cvtepi32_pd(_mm256_extracti128_si256(d_signed, 1)), offset);
+
+            __m256d q_lo = _mm256_sub_pd(_mm256_floor_pd(_mm256_div_pd(n_lo, d_lo)), offset);
+            __m256d q_hi = _mm256_sub_pd(_mm256_floor_pd(_mm256_div_pd(n_hi, d_hi)), offset);
+            __m256i q = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm256_cvttpd_epi32(q_lo)),
+                _mm256_cvttpd_epi32(q_hi),
+                1);
+            return _mm256_xor_si256(q, sign);
+        }
+
+        __attribute__((target("avx2"))) static void avx2(size_t count,
+            int32_t const* adc_T,
+            int32_t const* adc_P,
+            BMP280::Calibration const& c,
+            int32_t* temperature,
+            uint32_t* pressure)
+        {
+            __m256i const T1 = _mm256_set1_epi32(c.dig_T1);
+            __m256i const T1x2 = _mm256_set1_epi32(int32_t(c.dig_T1) << 1);
+            __m256i const T2 = _mm256_set1_epi32(c.dig_T2);
+            __m256i const T3 = _mm256_set1_epi32(c.dig_T3);
+            __m256i const P1 = _mm256_set1_epi32(c.dig_P1);
+            __m256i const P2 = _mm256_set1_epi32(c.dig_P2);
+            __m256i const P3 = _mm256_set1_epi32(c.dig_P3);
+            __m256i const P4x65536 = _mm256_set1_epi32(int32_t(c.dig_P4) * 65536);
+            __m256i const P5 = _mm256_set1_epi32(c.dig_P5);
+            __m256i const P6 = _mm256_set1_epi32(c.dig_P6);
+            __m256i const P7 = _mm256_set1_epi32(c.dig_P7);
+            __m256i const P8 = _mm256_set1_epi32(c.dig_P8);
+            __m256i const P9 = _mm256_set1_epi32(c.dig_P9);
+            __m256i const zero = _mm256_setzero_si256();
+
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m256i t =
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const*>(adc_T + i));
+                __m256i var1 = _mm256_srai_epi32(
+                    _mm256_mullo_epi32(_mm256_sub_epi32(_mm256_srai_epi32(t, 3), T1x2), T2),
+                    11);
+                __m256i dt = _mm256_sub_epi32(_mm256_srai_epi32(t, 4), T1);
+                __m256i var2 = _mm256_srai_epi32(
+                    _mm256_mullo_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(dt, dt), 12),
+                        T3),
+                    14);
+                __m256i t_fine = _mm256_add_epi32(var1, var2);
+                __m256i t_out = _mm256_srai_epi32(
+                    _mm256_add_epi32(_mm256_mullo_epi32(t_fine, _mm256_set1_epi32(5)),
+                        _mm256_set1_epi32(128)),
+                    8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(temperature + i), t_out);
+
+                __m256i adc =
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const*>(adc_P + i));
+                var1 = _mm256_sub_epi32(_mm256_srai_epi32(t_fine, 1),
+                    _mm256_set1_epi32(64000));
+                __m256i var1_4 = _mm256_srai_epi32(var1, 2);
+                __m256i square = _mm256_mullo_epi32(var1_4, var1_4);
+                var2 = _mm256_mullo_epi32(_mm256_srai_epi32(square, 11), P6);
+                var2 = _mm256_add_epi32(var2,
+                    _mm256_slli_epi32(_mm256_mullo_epi32(var1, P5), 1));
+                var2 = _mm256_add_epi32(_mm256_srai_epi32(var2, 2), P4x65536);
+                var1 = _mm256_srai_epi32(
+                    _mm256_add_epi32(
+                        _mm256_srai_epi32(
+                            _mm256_mullo_epi32(P3, _mm256_srai_epi32(square, 13)), 3),
+                        _mm256_srai_epi32(_mm256_mullo_epi32(P2, var1), 1)),
+                    18);
+                var1 = _mm256_srai_epi32(
+                    _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(32768), var1),
+                        P1),
+                    15);
+                __m256i invalid = _mm256_cmpeq_epi32(var1, zero);
+
+                __m256i p = _mm256_mullo_epi32(
+                    _mm256_sub_epi32(_mm256_sub_epi32(_mm256_set1_epi32(1048576), adc),
+                        _mm256_srai_epi32(var2, 12)),
+                    _mm256_set1_epi32(3125));
+                __m256i large = _mm256_srai_epi32(p, 31);
+                __m256i n = _mm256_blendv_epi8(_mm256_slli_epi32(p, 1), p, large);
+                __m256i q = divideAVX2(n, var1);
+                p = _mm256_blendv_epi8(q, _mm256_slli_epi32(q, 1), large);
+
+                __m256i p_8 = _mm256_srli_epi32(p, 3);
+                var1 = _mm256_srai_epi32(
+                    _mm256_mullo_epi32(P9,
+                        _mm256_srli_epi32(_mm256_mullo_epi32(p_8, p_8), 13)),
+                    12);
+                var2 = _mm256_srai_epi32(
+                    _mm256_mullo_epi32(_mm256_srli_epi32(p, 2), P8), 13);
+                p = _mm256_add_epi32(p,
+                    _mm256_srai_epi32(
+                        _mm256_add_epi32(_mm256_add_epi32(var1, var2), P7), 4));
+                p = _mm256_andnot_si256(invalid, p);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(pressure + i), p);
+            }
+            scalar(count - i, adc_T + i, adc_P + i, c, temperature + i, pressure + i);
+        }
+#endif
+
+#if I2CLIB_BMP280_NEON
+        static uint32x4_t divideNEON(uint32x4_t n, uint32x4_t d)
+        {
+            float64x2_t n_lo = vcvtq_f64_u64(vmovl_u32(vget_low_u32(n)));
+            float64x2_t n_hi = vcvtq_f64_u64(vmovl_u32(vget_high_u32(n)));
+            float64x2_t d_lo = vcvtq_f64_u64(vmovl_u32(vget_low_u32(d)));
+            float64x2_t d_hi = vcvtq_f64_u64(vmovl_u32(vget_high_u32(d)));
+            // The quotients are positive, so the conversion's truncation is a floor
+            uint64x2_t q_lo = vcvtq_u64_f64(vdivq_f64(n_lo, d_lo));
+            uint64x2_t q_hi = vcvtq_u64_f64(vdivq_f64(n_hi, d_hi));
+            return vcombine_u32(vmovn_u64(q_lo), vmovn_u64(q_hi));
+        }
+
+        static void neon(size_t count,
+            int32_t const* adc_T,
+            int32_t const* adc_P,
+            BMP280::Calibration const& c,
+            int32_t* temperature,
+            uint32_t* pressure)
+        {
+            int32x4_t const T1 = vdupq_n_s32(c.dig_T1);
+            int32x4_t const T1x2 = vdupq_n_s32(int32_t(c.dig_T1) << 1);
+            int32x4_t const T2 = vdupq_n_s32(c.dig_T2);
+            int32x4_t const T3 = vdupq_n_s32(c.dig_T3);
+            int32x4_t const P1 = vdupq_n_s32(c.dig_P1);
+            int32x4_t const P2 = vdupq_n_s32(c.dig_P2);
+            int32x4_t const P3 = vdupq_n_s32(c.dig_P3);
+            int32x4_t const P4x65536 = vdupq_n_s32(int32_t(c.dig_P4) * 65536);
+            int32x4_t const P5 = vdupq_n_s32(c.dig_P5);
+            int32x4_t const P6 = vdupq_n_s32(c.dig_P6);
+            int32x4_t const P7 = vdupq_n_s32(c.dig_P7);
+            int32x4_t const P8 = vdupq_n_s32(c.dig_P8);
+            int32x4_t const P9 = vdupq_n_s32(c.dig_P9);
+
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                int32x4_t t = vld1q_s32(adc_T + i);
+                int32x4_t var1 =
+                    vshrq_n_s32(vmulq_s32(vsubq_s32(vshrq_n_s32(t, 3), T1x2), T2), 11);
+                int32x4_t dt = vsubq_s32(vshrq_n_s32(t, 4), T1);
+                int32x4_t var2 =
+                    vshrq_n_s32(vmulq_s32(vshrq_n_s32(vmulq_s32(dt, dt), 12), T3), 14);
+                int32x4_t t_fine = vaddq_s32(var1, var2);
+                int32x4_t t_out = vshrq_n_s32(
+                    vaddq_s32(vmulq_n_s32(t_fine, 5), vdupq_n_s32(128)), 8);
+                vst1q_s32(temperature + i, t_out);
+
+                int32x4_t adc = vld1q_s32(adc_P + i);
+                var1 = vsubq_s32(vshrq_n_s32(t_fine, 1), vdupq_n_s32(64000));
+                int32x4_t var1_4 = vshrq_n_s32(var1, 2);
+                int32x4_t square = vmulq_s32(var1_4, var1_4);
+                var2 = vmulq_s32(vshrq_n_s32(square, 11), P6);
+                var2 = vaddq_s32(var2, vshlq_n_s32(vmulq_s32(var1, P5), 1));
+                var2 = vaddq_s32(vshrq_n_s32(var2, 2), P4x65536);
+                var1 = vshrq_n_s32(
+                    vaddq_s32(vshrq_n_s32(vmulq_s32(P3, vshrq_n_s32(square, 13)), 3),
+                        vshrq_n_s32(vmulq_s32(P2, var1), 1)),
+                    18);
+                var1 = vshrq_n_s32(vmulq_s32(vaddq_s32(vdupq_n_s32(32768), var1), P1), 15);
+                uint32x4_t invalid = vceqq_s32(var1, vdupq_n_s32(0));
+
+                uint32x4_t p = vreinterpretq_u32_s32(vmulq_n_s32(
+                    vsubq_s32(vsubq_s32(vdupq_n_s32(1048576), adc), vshrq_n_s32(var2, 12)),
+                    3125));
+                uint32x4_t large = vcgeq_u32(p, vdupq_n_u32(0x80000000));
+                uint32x4_t n = vbslq_u32(large, p, vshlq_n_u32(p, 1));
+                uint32x4_t q = divideNEON(n, vreinterpretq_u32_s32(var1));
+                p = vbslq_u32(large, vshlq_n_u32(q, 1), q);
+
+                uint32x4_t p_8 = vshrq_n_u32(p, 3);
+                var1 = vshrq_n_s32(
+                    vmulq_s32(P9,
+                        vreinterpretq_s32_u32(vshrq_n_u32(vmulq_u32(p_8, p_8), 13))),
+                    12);
+                var2 = vshrq_n_s32(
+                    vmulq_s32(vreinterpretq_s32_u32(vshrq_n_u32(p, 2)), P8), 13);
+                int32x4_t result = vaddq_s32(vreinterpretq_s32_u32(p),
+                    vshrq_n_s32(vaddq_s32(vaddq_s32(var1, var2), P7), 4));
+                p = vbicq_u32(vreinterpretq_u32_s32(result), invalid);
+                vst1q_u32(pressure + i, p);
+            }
+            scalar(count - i, adc_T + i, adc_P + i, c, temperature + i, pressure + i);
+        }
+#endif
+    };
+}
+
+bool BMP280::hasBatchImplementation(BatchImplementation implementation)
+{
+    switch (implementation) {
+        case BATCH_AUTO:
+        case BATCH_SCALAR:
+            return true;
+#if I2CLIB_BMP280_X86
+        case BATCH_SSE41:
+            return __builtin_cpu_supports("sse4.1");
+        case BATCH_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+#if I2CLIB_BMP280_NEON
+        case BATCH_NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+BMP280::BatchImplementation BMP280::getBatchImplementation()
+{
+    static BatchImplementation const selected = [] {
+        for (auto implementation : {BATCH_AVX2, BATCH_SSE41, BATCH_NEON}) {
+            if (hasBatchImplementation(implementation)) {
+                return implementation;
+            }
+        }
+        return BATCH_SCALAR;
+    }();
+    return selected;
+}
+
+static Kernel kernel(BMP280::BatchImplementation implementation)
+{
+    switch (implementation) {
+#if I2CLIB_BMP280_X86
+        case BMP280::BATCH_SSE41:
+            return &BMP280BatchKernels::sse41;
+        case BMP280::BATCH_AVX2:
+            return &BMP280BatchKernels::avx2;
+#endif
+#if I2CLIB_BMP280_NEON
+        case BMP280::BATCH_NEON:
+            return &BMP280BatchKernels::neon;
+#endif
+        default:
+            return &BMP280BatchKernels::scalar;
+    }
+}
+
+void BMP280::compensateBatch(size_t count,
+    int32_t const* adc_T,
+    int32_t const* adc_P,
+    Calibration const& c,
+    int32_t* temperature,
+    uint32_t* pressure,
+    BatchImplementation implementation)
+{
+    if (implementation == BATCH_AUTO) {
+        implementation = getBatchImplementation();
+    }
+    else if (!hasBatchImplementation(implementation)) {
+        throw invalid_argument("BMP280 batch implementation " +
+                               to_string(implementation) +
+                               " is not available on this machine");
+    }
+    kernel(implementation)(count, adc_T, adc_P, c, temperature, pressure);
+}
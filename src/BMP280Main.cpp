@@ -1,4 +1,7 @@
 #include <i2clib/BMP280.hpp>
+#include <i2clib/I2CBus.hpp>
+
+#include "StreamCommand.hpp"
 
 #include <iostream>
 
@@ -19,6 +22,11 @@ void usage(string const& cmd, ostream& io)
        << "  calibration: display calibration data\n"
        << "  raw: display raw data\n"
        << "  read: display compensated data\n"
+       << "  read-forced: trigger a single measurement and display compensated data\n"
+       << "  stream RATE COUNT [OSR] [FORMAT]: acquire COUNT forced measurements at\n"
+       << "    RATE Hz and write them to stdout, then display a summary on stderr.\n"
+       << "    OSR is the pressure oversampling (1, 2, 4, 8 or 16, default 1).\n"
+       << "    FORMAT is csv (default) or binary\n"
        << flush;
 }
 
@@ -96,6 +104,39 @@ int main(int argc, char** argv) {
         cout << meas.pressure.toBar() << " Bar, "
              << meas.temperature.getCelsius() << "C" << endl;
     }
+    else if (cmd == "read-forced") {
+        auto meas = chip.readForced();
+        cout << meas.pressure.toBar() << " Bar, "
+             << meas.temperature.getCelsius() << "C" << endl;
+    }
+    else if (cmd == "stream") {
+        if (argc < ARGC_MIN + 2 || argc > ARGC_MIN + 4) {
+            cerr << "stream expects RATE COUNT [OSR] [FORMAT]" << endl;
+            return 1;
+        }
+        int osr = argc > ARGC_MIN + 2 ? stoi(argv[ARGC_MIN + 2]) : 1;
+        string format = argc > ARGC_MIN + 3 ? argv[ARGC_MIN + 3] : "csv";
+        auto options = stream::parseOptions(argv[ARGC_MIN], argv[ARGC_MIN + 1], format);
+        BMP280Configuration conf;
+        switch (osr) {
+            case 1: conf.pressure_oversampling = BMP280Configuration::SAMPLING_1; break;
+            case 2: conf.pressure_oversampling = BMP280Configuration::OVERSAMPLING_2; break;
+            case 4: conf.pressure_oversampling = BMP280Configuration::OVERSAMPLING_4; break;
+            case 8: conf.pressure_oversampling = BMP280Configuration::OVERSAMPLING_8; break;
+            case 16: conf.pressure_oversampling = BMP280Configuration::OVERSAMPLING_16; break;
+            default:
+                cerr << "invalid oversampling " << osr << ", expected 1, 2, 4, 8 or 16"
+                     << endl;
+                return 1;
+        }
+        chip.sleepAndWriteConfiguration(conf);
+
+        auto summary = stream::run(options, [&]() {
+            auto meas = chip.readForced();
+            return stream::Sample{meas.pressure.toPa(), meas.temperature.getCelsius()};
+        }, cout);
+        stream::printSummary(options, summary, cerr);
+    }
     else {
         cerr << "Unknown command '" << cmd << "'" << endl;
         usage(argv[0], cerr);
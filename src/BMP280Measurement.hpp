@@ -7,9 +7,23 @@
 
 namespace i2clib {
     /** Compensated measurements from the BMP280
+     *
+     * The acquisition window is measured in forced mode. In normal mode, it
+     * is estimated assuming that the measurement finished right before it was
+     * read.
      */
     struct BMP280Measurement {
+        /** Estimated time at which the sample was taken
+         *
+         * This is the middle of the acquisition window
+         */
         base::Time time;
+        /** Start of the window during which the chip acquired the sample */
+        base::Time acquisition_start;
+        /** End of the window during which the chip acquired the sample */
+        base::Time acquisition_end;
+        /** Duration of the i2c transaction that read the sample from the chip */
+        base::Time transport_latency;
         base::Pressure pressure;
         base::Temperature temperature;
     };
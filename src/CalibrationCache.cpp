@@ -0,0 +1,139 @@
+#include <i2clib/CalibrationCache.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+using namespace i2clib;
+using namespace std;
+
+CalibrationCache::CalibrationCache()
+{
+}
+
+CalibrationCache::CalibrationCache(string const& path)
+    : m_path(path)
+{
+    load();
+}
+
+string CalibrationCache::key(string const& driver, string const& bus, uint8_t address)
+{
+    ostringstream key;
+    key << driver << "@" << bus << ":0x" << hex << setw(2) << setfill('0')
+        << static_cast<int>(address);
+    return key.str();
+}
+
+string const& CalibrationCache::getPath() const
+{
+    return m_path;
+}
+
+static bool parseHex(string const& text, vector<uint8_t>& data)
+{
+    if (text.size() % 2) {
+        return false;
+    }
+
+    data.resize(text.size() / 2);
+    for (size_t i = 0; i < data.size(); ++i) {
+        int byte = 0;
+        for (size_t j = 0; j < 2; ++j) {
+            char c = text[2 * i + j];
+            int digit = 0;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            }
+            else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            }
+            else if (c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            }
+            else {
+                return false;
+            }
+            byte = byte * 16 + digit;
+        }
+        data[i] = byte;
+    }
+    return true;
+}
+
+void CalibrationCache::load()
+{
+    ifstream file(m_path);
+    string line;
+    while (getline(file, line)) {
+        // Bus paths may contain spaces, the data may not
+        size_t separator = line.rfind(' ');
+        if (separator == string::npos || separator == 0) {
+            continue;
+        }
+
+        vector<uint8_t> data;
+        if (parseHex(line.substr(separator + 1), data)) {
+            m_entries[line.substr(0, separator)] = data;
+        }
+    }
+}
+
+bool CalibrationCache::get(string const& key, vector<uint8_t>& data) const
+{
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return false;
+    }
+    data = it->second;
+    return true;
+}
+
+void CalibrationCache::set(string const& key, vector<uint8_t> const& data)
+{
+    if (key.empty() || key.find('\n') != string::npos) {
+        throw invalid_argument("invalid calibration cache key '" + key + "'");
+    }
+
+    m_entries[key] = data;
+    save();
+}
+
+void CalibrationCache::erase(string const& key)
+{
+    if (m_entries.erase(key)) {
+        save();
+    }
+}
+
+void CalibrationCache::save() const
+{
+    if (m_path.empty()) {
+        return;
+    }
+
+    string tmp_path = m_path + ".tmp";
+    {
+        ofstream file(tmp_path, ios::trunc);
+        for (auto const& entry : m_entries) {
+            file << entry.first << " " << hex << setfill('0');
+            for (uint8_t byte : entry.second) {
+                file << setw(2) << static_cast<int>(byte);
+            }
+            file << dec << "\n";
+        }
+        file.flush();
+        if (!file) {
+            throw runtime_error("failed to write calibration cache " + tmp_path);
+        }
+    }
+
+    if (rename(tmp_path.c_str(), m_path.c_str()) != 0) {
+        throw runtime_error("failed to replace calibration cache " + m_path + ": " +
+                            strerror(errno));
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef I2CLIB_CALIBRATIONCACHE_HPP
+#define I2CLIB_CALIBRATIONCACHE_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace i2clib {
+    /** Store of per-chip calibration data, optionally persisted in a file
+     *
+     * Drivers use it to skip reading calibration data they already know. Each
+     * driver defines what it stores, and how it verifies that the entry still
+     * matches the chip (e.g. chip ID or CRC). Entries are keyed by driver, bus
+     * path and address, see \c key.
+     *
+     * The file is a text file with one entry per line: the key, a space and the
+     * data as hexadecimal bytes. Lines that cannot be parsed are ignored, since
+     * a lost entry only means that the driver reads the chip again.
+     *
+     * This class is not thread-safe
+     */
+    class CalibrationCache {
+        std::string m_path;
+        std::map<std::string, std::vector<std::uint8_t>> m_entries;
+
+        void load();
+
+    public:
+        /** A cache that only lives in memory */
+        CalibrationCache();
+
+        /** A cache persisted in the given file
+         *
+         * The file is loaded if it exists, and rewritten on every change
+         */
+        explicit CalibrationCache(std::string const& path);
+
+        /** The key of a given chip
+         *
+         * @param driver name of the driver, e.g. "bmp280"
+         * @param bus path of the bus the chip is on, see \c I2CBus::getPath
+         * @param address address of the chip on the bus
+         */
+        static std::string key(std::string const& driver,
+            std::string const& bus,
+            std::uint8_t address);
+
+        /** The file the cache is persisted in, empty if it is in memory only */
+        std::string const& getPath() const;
+
+        /** Get the data stored for the given key
+         *
+         * @return false if there is none, in which case \c data is unchanged
+         */
+        bool get(std::string const& key, std::vector<std::uint8_t>& data) const;
+
+        /** Store data for the given key, and save the cache
+         *
+         * @throw std::runtime_error if the cache file cannot be written
+         */
+        void set(std::string const& key, std::vector<std::uint8_t> const& data);
+
+        /** Remove the data stored for the given key, and save the cache
+         *
+         * @throw std::runtime_error if the cache file cannot be written
+         */
+        void erase(std::string const& key);
+
+        /** Write the cache file
+         *
+         * The file is replaced atomically. This does nothing for an in-memory
+         * cache
+         *
+         * @throw std::runtime_error if the cache file cannot be written
+         */
+        void save() const;
+    };
+}
+
+#endif
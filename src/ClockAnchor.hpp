@@ -0,0 +1,34 @@
+#ifndef I2CLIB_CLOCKANCHOR_HPP
+#define I2CLIB_CLOCKANCHOR_HPP
+
+#include <base/Time.hpp>
+
+#include <chrono>
+
+namespace i2clib {
+    /** Conversion of monotonic clock time points into base::Time
+     *
+     * The drivers timestamp the steps of an acquisition with the monotonic clock,
+     * which is not affected by system clock adjustments. The anchor samples both
+     * clocks once, so that all the time points of a measurement are converted
+     * consistently.
+     */
+    struct ClockAnchor {
+        base::Time time = base::Time::now();
+        std::chrono::steady_clock::time_point steady = std::chrono::steady_clock::now();
+
+        base::Time toTime(std::chrono::steady_clock::time_point point) const
+        {
+            return time - toDuration(steady - point);
+        }
+
+        static base::Time toDuration(std::chrono::steady_clock::duration duration)
+        {
+            return base::Time::fromMicroseconds(
+                std::chrono::duration_cast<std::chrono::microseconds>(duration)
+                    .count());
+        }
+    };
+}
+
+#endif
@@ -1,11 +1,21 @@
 #ifndef I2CLIB_EXCEPTIONS_HPP
 #define I2CLIB_EXCEPTIONS_HPP
 
+#include <cstddef>
 #include <stdexcept>
+#include <string>
 
 namespace i2clib {
     struct IOError : public std::runtime_error {
+        /** The errno value reported by the system, or zero if there was none */
+        int error_code = 0;
+
         using std::runtime_error::runtime_error;
+        IOError(std::string const& message, int error_code)
+            : std::runtime_error(message)
+            , error_code(error_code)
+        {
+        }
     };
     struct ReadError : public IOError {
         using IOError::IOError;
@@ -13,6 +23,35 @@ namespace i2clib {
     struct WriteError : public IOError {
         using IOError::IOError;
     };
+
+    /** Error raised when a I2CTransactionBatch fails
+     *
+     * Messages before \c first_message have been completed. One of the
+     * \c message_count messages starting at \c first_message failed, and the
+     * messages after them have not been performed. \c message_count is 1 when
+     * the adapter reported the failing message.
+     */
+    struct BatchError : public IOError {
+        std::size_t first_message = 0;
+        std::size_t message_count = 0;
+
+        BatchError(std::string const& message,
+            int error_code,
+            std::size_t first_message,
+            std::size_t message_count)
+            : IOError(message, error_code)
+            , first_message(first_message)
+            , message_count(message_count)
+        {
+        }
+    };
+
+    /** Error raised by ReplayI2CBus when the transactions requested by the
+     * drivers do not match the log, or when the log is exhausted
+     */
+    struct ReplayError : public std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
 }
 
-#endif
\ No newline at end of file
+#endif
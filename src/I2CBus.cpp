@@ -1,6 +1,7 @@
 #include <i2clib/Exceptions.hpp>
 #include <i2clib/I2CBus.hpp>
 
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <errno.h>
@@ -8,6 +9,7 @@
 #include <linux/i2c-dev.h>
 #include <linux/i2c.h>
 #include <sstream>
+#include <stdexcept>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -16,7 +18,53 @@
 using namespace i2clib;
 using namespace std;
 
+/** Perform a I2C_RDWR ioctl, and record it if statistics are enabled
+ *
+ * @param messages the batch messages matching \c kernel_messages. If null,
+ *   the messages are considered to be part of a single transaction
+ */
+static int rdwr(int fd,
+    i2c_msg* kernel_messages,
+    size_t count,
+    I2CTransactionBatch::Message const* messages,
+    I2CBusStatistics* statistics)
+{
+    i2c_rdwr_ioctl_data query;
+    query.msgs = kernel_messages;
+    query.nmsgs = count;
+    if (!statistics) {
+        return ioctl(fd, I2C_RDWR, &query);
+    }
+
+    auto start = chrono::steady_clock::now();
+    int ret = ioctl(fd, I2C_RDWR, &query);
+    int error = ret == -1 ? errno : 0;
+    auto latency = chrono::steady_clock::now() - start;
+
+    I2CTransactionBatch::Message transaction[2];
+    if (!messages) {
+        for (size_t i = 0; i < count; ++i) {
+            transaction[i].address = kernel_messages[i].addr;
+            transaction[i].read = kernel_messages[i].flags & I2C_M_RD;
+            transaction[i].size = kernel_messages[i].len;
+        }
+        messages = transaction;
+    }
+
+    size_t completed = ret == -1 ? 0 : ret;
+    if (ret != -1 && completed < count) {
+        error = EIO;
+    }
+    statistics->record(messages, count, completed, error, latency);
+
+    if (ret == -1) {
+        errno = error;
+    }
+    return ret;
+}
+
 I2CBus::I2CBus(std::string const& path)
+    : m_path(path)
 {
     int fd = open(path.c_str(), O_RDWR);
     if (fd == -1) {
@@ -32,6 +80,11 @@ I2CBus::~I2CBus()
     close(m_fd);
 }
 
+string const& I2CBus::getPath() const
+{
+    return m_path;
+}
+
 void I2CBus::setTimeout(base::Time const& timeout)
 {
     int ret = ioctl(m_fd,
@@ -42,6 +95,23 @@ void I2CBus::setTimeout(base::Time const& timeout)
     }
 }
 
+void I2CBus::enableStatistics()
+{
+    if (!m_statistics) {
+        m_statistics.reset(new I2CBusStatistics());
+    }
+}
+
+void I2CBus::disableStatistics()
+{
+    m_statistics.reset();
+}
+
+I2CBusStatistics* I2CBus::getStatistics()
+{
+    return m_statistics.get();
+}
+
 void I2CBus::read(uint8_t address,
     uint8_t* write_bytes,
     size_t write_size,
@@ -58,15 +128,12 @@ void I2CBus::read(uint8_t address,
     messages[1].len = size;
     messages[1].buf = bytes;
 
-    i2c_rdwr_ioctl_data query;
-    query.msgs = messages;
-    query.nmsgs = 2;
-
-    if (ioctl(m_fd, I2C_RDWR, &query) == -1) {
+    if (rdwr(m_fd, messages, 2, nullptr, m_statistics.get()) == -1) {
+        int error = errno;
         ostringstream message;
         message << "failed read to address " + to_string(address) << ": ";
-        message << strerror(errno);
-        throw ReadError(message.str());
+        message << strerror(error);
+        throw ReadError(message.str(), error);
     }
 }
 
@@ -78,13 +145,65 @@ void I2CBus::write(uint8_t address, uint8_t* registers, size_t size)
     config_msg.len = size;
     config_msg.buf = registers;
 
-    i2c_rdwr_ioctl_data query;
-    query.msgs = &config_msg;
-    query.nmsgs = 1;
-    if (ioctl(m_fd, I2C_RDWR, &query) == -1) {
+    if (rdwr(m_fd, &config_msg, 1, nullptr, m_statistics.get()) == -1) {
+        int error = errno;
         ostringstream message;
         message << "failed write to address " + to_string(address) << ": ";
-        message << strerror(errno);
-        throw WriteError(message.str());
+        message << strerror(error);
+        throw WriteError(message.str(), error);
+    }
+}
+
+static_assert(I2CBus::MAX_MESSAGES_PER_TRANSFER == I2C_RDWR_IOCTL_MAX_MSGS,
+    "MAX_MESSAGES_PER_TRANSFER does not match the kernel's I2C_RDWR_IOCTL_MAX_MSGS");
+
+void I2CBus::transfer(I2CTransactionBatch const& batch)
+{
+    auto const& messages = batch.messages();
+
+    i2c_msg kernel_messages[MAX_MESSAGES_PER_TRANSFER];
+    size_t begin = 0;
+    while (begin < messages.size()) {
+        size_t end = batch.splitPoint(begin, MAX_MESSAGES_PER_TRANSFER);
+        for (size_t i = begin; i < end; ++i) {
+            auto const& m = messages[i];
+            if (m.size > 0xFFFF) {
+                throw invalid_argument(
+                    "message " + to_string(i) + " is too long (" + to_string(m.size) +
+                    " bytes, maximum is 65535)");
+            }
+
+            auto& msg = kernel_messages[i - begin];
+            msg.addr = m.address;
+            msg.flags = m.read ? I2C_M_RD : 0;
+            msg.len = m.size;
+            msg.buf = m.buffer;
+        }
+
+        // On success, the ioctl returns the number of messages actually transferred.
+        // Some adapters report a failure this way, which tells us exactly which
+        // message failed
+        int ret = rdwr(m_fd,
+            kernel_messages,
+            end - begin,
+            &messages[begin],
+            m_statistics.get());
+        if (ret == -1) {
+            int error = errno;
+            ostringstream message;
+            message << "failed batch transfer of messages " << begin << " to "
+                    << end - 1 << ": " << strerror(error);
+            throw BatchError(message.str(), error, begin, end - begin);
+        }
+        else if (static_cast<size_t>(ret) < end - begin) {
+            size_t failed = begin + ret;
+            ostringstream message;
+            message << "failed batch transfer at message " << failed
+                    << " (address " << to_string(messages[failed].address)
+                    << ", transaction " << messages[failed].transaction << ")";
+            throw BatchError(message.str(), EIO, failed, 1);
+        }
+
+        begin = end;
     }
 }
\ No newline at end of file
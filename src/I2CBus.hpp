@@ -2,8 +2,10 @@
 #define I2CLIB_I2CBUS_HPP
 
 #include <base/Time.hpp>
+#include <i2clib/I2CBusStatistics.hpp>
+#include <i2clib/I2CTransport.hpp>
 
-#include <array>
+#include <memory>
 #include <string>
 
 namespace i2clib {
@@ -13,14 +15,25 @@ namespace i2clib {
      * more than one I2CBus object access the same bus, both in the same process and in
      * different processes
      */
-    class I2CBus {
+    class I2CBus : public I2CTransport {
+        std::string m_path;
         int m_fd = -1;
 
         base::Time m_timeout = base::Time::fromMilliseconds(100);
 
+        std::unique_ptr<I2CBusStatistics> m_statistics;
+
     public:
+        /** Maximum number of messages the kernel accepts in a single I2C_RDWR
+         * ioctl (I2C_RDWR_IOCTL_MAX_MSGS)
+         */
+        static constexpr std::size_t MAX_MESSAGES_PER_TRANSFER = 42;
+
         I2CBus(std::string const& path);
-        ~I2CBus();
+        ~I2CBus() override;
+
+        /** The path of the bus device, as given to the constructor */
+        std::string const& getPath() const;
 
         /** Configure the i2c timeout
          *
@@ -28,45 +41,48 @@ namespace i2clib {
          */
         void setTimeout(base::Time const& timeout);
 
-        /** Perform a transaction with a write followed by a read
+        /** Start recording statistics about the transactions on this bus
+         *
+         * Statistics are disabled by default. When disabled, their cost is a
+         * single test per ioctl. This does nothing if they are already enabled.
          *
-         * \c data contains information for the write. The read information is
-         * returned.
+         * Enabling and disabling statistics is not thread-safe, but reading them
+         * with \c getStatistics is.
          */
-        template <int Size> std::array<uint8_t, Size> read(uint8_t address, uint8_t reg)
-        {
-            std::array<uint8_t, Size> read_bytes;
-            uint8_t reg_rw{reg};
+        void enableStatistics();
 
-            read(address, &reg_rw, 1, read_bytes.data(), read_bytes.size());
-            return read_bytes;
-        }
+        /** Stop recording statistics, and discard the recorded ones */
+        void disableStatistics();
 
-        /** Perform a transaction with a write followed by a read
+        /** The recorded statistics, or null if they are not enabled
          *
-         * \c data contains information for the write. The read information is
-         * returned.
+         * The returned object is owned by the bus, and is valid until
+         * \c disableStatistics is called
          */
+        I2CBusStatistics* getStatistics();
+
+        using I2CTransport::read;
+        using I2CTransport::write;
+
         void read(uint8_t address,
             uint8_t* write_bytes,
             size_t write_size,
             uint8_t* bytes,
-            size_t size);
+            size_t size) override;
 
-        /** Write \c size bytes at the given address
-         */
-        void write(uint8_t address, uint8_t* bytes, size_t size);
+        void write(uint8_t address, uint8_t* bytes, size_t size) override;
 
-        /** @overload compatible with initializer lists
+        /** Perform all transactions of a batch
+         *
+         * The transactions are submitted with a single I2C_RDWR ioctl, unless
+         * the batch has more than \c MAX_MESSAGES_PER_TRANSFER messages. In
+         * this case, it is split in as few ioctls as possible, without
+         * splitting transactions.
          *
-         * @example i2c.write(DEVICE_ADRESS, { 1, 2 })
+         * @throw BatchError if one of the messages failed. The exception
+         *   identifies the messages that were not completed
          */
-        template <int Size> void write(uint8_t address, uint8_t const (&data)[Size])
-        {
-            std::array<uint8_t, Size> rw_data;
-            std::copy(data, data + Size, rw_data.begin());
-            return write(address, rw_data.data(), Size);
-        }
+        void transfer(I2CTransactionBatch const& batch) override;
     };
 }
 
@@ -0,0 +1,274 @@
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/I2CBus.hpp>
+#include <i2clib/I2CBusStatistics.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+#include <i2clib/SimulatedPCA9685.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace i2clib;
+using namespace std;
+
+static constexpr int ARGC_MIN = 3;
+/** Name of the DEV argument that selects the simulated bus */
+static char const* SIMULATED_DEV = "sim";
+/** First register of the transfers, the first PWM register of the PCA9685 */
+static constexpr uint8_t BENCH_REGISTER = 0x06;
+/** Data sizes of the transfers, up to the registers of the 16 PCA9685 PWMs */
+static const vector<size_t> SIZES = {1, 2, 4, 8, 16, 32, 64};
+
+void usage(string const& cmd, ostream& io)
+{
+    io << "usage: " << cmd << " DEV ADDRESSES [ITERATIONS] [BATCH_SIZE] [TIMEOUTS_MS]\n"
+       << "  measure the throughput and latency of the bus for data sizes from 1\n"
+       << "  to 64 bytes, with one ioctl per message (single) and BATCH_SIZE messages\n"
+       << "  per I2C_RDWR ioctl (batched)\n"
+       << "\n"
+       << "  DEV the i2c device, or '" << SIMULATED_DEV << "' for an in-process\n"
+       << "    simulated bus, to measure the software overhead alone\n"
+       << "  ADDRESSES comma-separated list of device addresses. The transfers\n"
+       << "    go to each address in turn\n"
+       << "  ITERATIONS number of messages per measurement (default 1000)\n"
+       << "  BATCH_SIZE messages per batched ioctl (default 8, max "
+       << I2CBus::MAX_MESSAGES_PER_TRANSFER << ")\n"
+       << "  TIMEOUTS_MS comma-separated list of bus timeouts (default 100). Ignored\n"
+       << "    on the simulated bus\n"
+       << "\n"
+       << "  Transfers start at register " << static_cast<int>(BENCH_REGISTER)
+       << " (the PCA9685 PWM registers). Writes\n"
+       << "  write back the values read from the device beforehand, so that the\n"
+       << "  benchmark does not change its state. The sizes and bytes/s count the\n"
+       << "  data bytes in both directions, without the register byte that precedes\n"
+       << "  them and the address bytes. The latencies are those of the ioctls,\n"
+       << "  i.e. of a whole batch in batched mode\n"
+       << flush;
+}
+
+vector<string> split(string const& list)
+{
+    vector<string> result;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ',')) {
+        result.push_back(item);
+    }
+    return result;
+}
+
+struct Result {
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    chrono::steady_clock::duration duration{};
+    /** Latency of each ioctl */
+    LatencyHistogram latency;
+    /** Largest latency in nanoseconds. LatencyHistogram::max is in
+     * microseconds, which is too coarse for the simulated bus */
+    uint64_t max_ns = 0;
+
+    void record(chrono::steady_clock::duration d)
+    {
+        uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(d).count();
+        ++latency.buckets[LatencyHistogram::bucketIndex(ns)];
+        max_ns = max(max_ns, ns);
+    }
+
+    /** The latency in nanoseconds below which the given fraction of the
+     * ioctls fall, see LatencyHistogram::percentile */
+    uint64_t percentile(double fraction) const
+    {
+        uint64_t threshold = ceil(fraction * latency.count());
+        uint64_t cumulated = 0;
+        for (unsigned i = 0; i < latency.buckets.size(); ++i) {
+            cumulated += latency.buckets[i];
+            if (cumulated > 0 && cumulated >= threshold) {
+                return min(LatencyHistogram::bucketUpperBound(i), max_ns);
+            }
+        }
+        return max_ns;
+    }
+};
+
+class Bench {
+    I2CTransport& m_bus;
+    vector<uint8_t> m_addresses;
+    size_t m_iterations;
+    size_t m_batch_size;
+
+    /** Register byte followed by the current register values, per address */
+    vector<vector<uint8_t>> m_write_buffers;
+    vector<uint8_t> m_read_buffer;
+    uint8_t m_register = BENCH_REGISTER;
+    I2CTransactionBatch m_batch;
+
+public:
+    Bench(I2CTransport& bus,
+        vector<uint8_t> const& addresses,
+        size_t iterations,
+        size_t batch_size)
+        : m_bus(bus)
+        , m_addresses(addresses)
+        , m_iterations(iterations)
+        , m_batch_size(batch_size)
+        , m_write_buffers(addresses.size())
+        , m_read_buffer(batch_size * SIZES.back())
+    {
+        m_batch.reserve(batch_size);
+    }
+
+    /** Read the registers that the writes of the given size will write back */
+    void prepareWrites(size_t size)
+    {
+        for (size_t i = 0; i < m_addresses.size(); ++i) {
+            auto& buffer = m_write_buffers[i];
+            buffer.resize(1 + size);
+            buffer[0] = m_register;
+            m_bus.read(m_addresses[i], &m_register, 1, buffer.data() + 1, size);
+        }
+    }
+
+    Result run(bool write, bool batched, size_t size)
+    {
+        if (write) {
+            prepareWrites(size);
+        }
+
+        Result result;
+        size_t per_transfer = batched ? m_batch_size : 1;
+        size_t transfers = (m_iterations + per_transfer - 1) / per_transfer;
+        auto start = chrono::steady_clock::now();
+        for (size_t t = 0; t < transfers; ++t) {
+            m_batch.clear();
+            for (size_t m = 0; m < per_transfer; ++m) {
+                size_t index = (t * per_transfer + m) % m_addresses.size();
+                if (write) {
+                    m_batch.write(m_addresses[index], m_write_buffers[index].data(), 1 + size);
+                }
+                else {
+                    m_batch.read(m_addresses[index],
+                        &m_register,
+                        1,
+                        m_read_buffer.data() + m * size,
+                        size);
+                }
+            }
+
+            auto transfer_start = chrono::steady_clock::now();
+            try {
+                if (batched) {
+                    m_bus.transfer(m_batch);
+                }
+                else {
+                    auto const& message = m_batch.messages().back();
+                    if (write) {
+                        m_bus.write(message.address, message.buffer, message.size);
+                    }
+                    else {
+                        m_bus.read(message.address, &m_register, 1, message.buffer, size);
+                    }
+                }
+                result.messages += per_transfer;
+                result.bytes += per_transfer * size;
+            }
+            catch (IOError const&) {
+                ++result.errors;
+            }
+            result.record(chrono::steady_clock::now() - transfer_start);
+        }
+        result.duration = chrono::steady_clock::now() - start;
+        return result;
+    }
+};
+
+void printHeader(ostream& io)
+{
+    io << setw(5) << "op" << setw(9) << "mode" << setw(6) << "size" << setw(9)
+       << "timeout" << setw(11) << "msgs/s" << setw(12) << "bytes/s" << setw(9)
+       << "p50_ns" << setw(9) << "p90_ns" << setw(9) << "p99_ns" << setw(9) << "max_ns"
+       << setw(8) << "errors" << "\n";
+}
+
+void printResult(ostream& io,
+    bool write,
+    bool batched,
+    size_t size,
+    string const& timeout,
+    Result const& result)
+{
+    double seconds = chrono::duration<double>(result.duration).count();
+    io << setw(5) << (write ? "write" : "read") << setw(9)
+       << (batched ? "batched" : "single") << setw(6) << size << setw(9) << timeout
+       << fixed << setprecision(0) << setw(11) << result.messages / seconds << setw(12)
+       << result.bytes / seconds << setw(9)
+       << result.percentile(0.5) << setw(9) << result.percentile(0.9) << setw(9)
+       << result.percentile(0.99) << setw(9) << result.max_ns << setw(8)
+       << result.errors << endl;
+}
+
+void sweep(Bench& bench, string const& timeout)
+{
+    for (size_t size : SIZES) {
+        for (bool write : {false, true}) {
+            for (bool batched : {false, true}) {
+                auto result = bench.run(write, batched, size);
+                printResult(cout, write, batched, size, timeout, result);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 1) {
+        usage(argv[0], cout);
+        return 0;
+    }
+    else if (argc < ARGC_MIN || argc > ARGC_MIN + 3) {
+        usage(argv[0], cerr);
+        return 1;
+    }
+
+    string i2c_dev = argv[1];
+    vector<uint8_t> addresses;
+    for (auto const& address : split(argv[2])) {
+        addresses.push_back(stoi(address, nullptr, 0));
+    }
+    size_t iterations = argc > ARGC_MIN ? stoul(argv[ARGC_MIN]) : 1000;
+    size_t batch_size = argc > ARGC_MIN + 1 ? stoul(argv[ARGC_MIN + 1]) : 8;
+    vector<string> timeouts = split(argc > ARGC_MIN + 2 ? argv[ARGC_MIN + 2] : "100");
+    if (addresses.empty() || iterations == 0 || batch_size == 0 ||
+        batch_size > I2CBus::MAX_MESSAGES_PER_TRANSFER) {
+        usage(argv[0], cerr);
+        return 1;
+    }
+
+    printHeader(cout);
+    if (i2c_dev == SIMULATED_DEV) {
+        SimulatedI2CBus bus;
+        vector<unique_ptr<SimulatedPCA9685>> devices;
+        for (uint8_t address : addresses) {
+            devices.emplace_back(new SimulatedPCA9685());
+            bus.attach(address, *devices.back());
+        }
+
+        Bench bench(bus, addresses, iterations, batch_size);
+        sweep(bench, "-");
+        return 0;
+    }
+
+    I2CBus bus(i2c_dev);
+    Bench bench(bus, addresses, iterations, batch_size);
+    for (auto const& timeout : timeouts) {
+        bus.setTimeout(base::Time::fromMilliseconds(stoi(timeout)));
+        sweep(bench, timeout + "ms");
+    }
+    return 0;
+}
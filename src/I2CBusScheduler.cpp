@@ -0,0 +1,254 @@
+#include <i2clib/I2CBusScheduler.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+using namespace i2clib;
+using namespace std;
+
+const base::Time I2CBusScheduler::MAX_HYPERPERIOD = base::Time::fromSeconds(60.0);
+
+/** Bits on the wire for the start condition, address and data of a message */
+static size_t messageBits(size_t size)
+{
+    // Start condition, then 8 bits + ACK for the address and each data byte
+    return 1 + 9 * (1 + size);
+}
+
+static base::Time bitsToTime(size_t bits, uint32_t bus_frequency)
+{
+    // Round up to the microsecond
+    uint64_t us = (static_cast<uint64_t>(bits) * 1000000 + bus_frequency - 1) /
+                  bus_frequency;
+    return base::Time::fromMicroseconds(us);
+}
+
+I2CBusScheduler::I2CBusScheduler(uint32_t bus_frequency)
+    : m_bus_frequency(bus_frequency)
+{
+}
+
+base::Time I2CBusScheduler::transferDuration(size_t write_size,
+    size_t read_size,
+    uint32_t bus_frequency)
+{
+    size_t bits = messageBits(write_size) + 1;
+    if (read_size) {
+        bits += messageBits(read_size);
+    }
+    return bitsToTime(bits, bus_frequency);
+}
+
+base::Time I2CBusScheduler::transferDuration(I2CTransactionBatch const& batch,
+    uint32_t bus_frequency)
+{
+    size_t bits = 1;
+    for (auto const& message : batch.messages()) {
+        bits += messageBits(message.size);
+    }
+    return bitsToTime(bits, bus_frequency);
+}
+
+base::Time I2CBusScheduler::transferDuration(size_t write_size, size_t read_size) const
+{
+    return transferDuration(write_size, read_size, m_bus_frequency);
+}
+
+size_t I2CBusScheduler::add(Task const& task)
+{
+    if (task.period.toMicroseconds() <= 0) {
+        throw invalid_argument("task " + task.name + " has a null period");
+    }
+    if (task.deadline > task.period) {
+        throw invalid_argument(
+            "task " + task.name + " has a deadline greater than its period");
+    }
+
+    m_tasks.push_back(task);
+    m_statistics.push_back(TaskStatistics());
+    m_timeline.clear();
+    m_running = false;
+    return m_tasks.size() - 1;
+}
+
+double I2CBusScheduler::getUtilization() const
+{
+    double result = 0;
+    for (auto const& task : m_tasks) {
+        result += task.cost.toSeconds() / task.period.toSeconds();
+    }
+    return result;
+}
+
+void I2CBusScheduler::plan()
+{
+    m_timeline.clear();
+    m_running = false;
+
+    int64_t hyperperiod = 1;
+    for (auto const& task : m_tasks) {
+        hyperperiod = lcm(hyperperiod, task.period.toMicroseconds());
+        if (hyperperiod > MAX_HYPERPERIOD.toMicroseconds()) {
+            throw invalid_argument("the hyperperiod of the task set is too long, "
+                                   "use periods that are multiples of each other");
+        }
+    }
+
+    vector<size_t> order(m_tasks.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return m_tasks[a].period < m_tasks[b].period;
+    });
+
+    // Bus usage over the hyperperiod, as sorted non-overlapping [start, end)
+    // intervals
+    vector<pair<int64_t, int64_t>> busy;
+    auto isFree = [&busy](int64_t start, int64_t end) {
+        auto it = lower_bound(busy.begin(),
+            busy.end(),
+            make_pair(start, start),
+            [](auto const& a, auto const& b) { return a.second <= b.first; });
+        return it == busy.end() || it->first >= end;
+    };
+
+    vector<int64_t> offsets(m_tasks.size(), 0);
+    for (size_t task_index : order) {
+        auto const& task = m_tasks[task_index];
+        int64_t period = task.period.toMicroseconds();
+        int64_t cost = task.cost.toMicroseconds();
+        int64_t deadline =
+            task.deadline.isNull() ? period : task.deadline.toMicroseconds();
+
+        // The earliest offset at which the task fits is either zero, or the end
+        // of an interval that is already used
+        vector<int64_t> candidates{0};
+        for (auto const& interval : busy) {
+            candidates.push_back(interval.second % period);
+        }
+        sort(candidates.begin(), candidates.end());
+        candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+        bool placed = false;
+        for (int64_t offset : candidates) {
+            if (offset + cost > deadline) {
+                break;
+            }
+
+            bool fits = true;
+            for (int64_t start = offset; start < hyperperiod && fits; start += period) {
+                fits = isFree(start, start + cost);
+            }
+            if (fits) {
+                offsets[task_index] = offset;
+                placed = true;
+                break;
+            }
+        }
+        if (!placed) {
+            throw invalid_argument("cannot schedule task " + task.name);
+        }
+
+        for (int64_t start = offsets[task_index]; start < hyperperiod; start += period) {
+            if (cost > 0) {
+                busy.insert(
+                    lower_bound(busy.begin(), busy.end(), make_pair(start, start)),
+                    make_pair(start, start + cost));
+            }
+            Job job;
+            job.task = task_index;
+            job.start = base::Time::fromMicroseconds(start);
+            job.deadline = base::Time::fromMicroseconds(start - offsets[task_index] + deadline);
+            m_timeline.push_back(job);
+        }
+    }
+
+    stable_sort(m_timeline.begin(), m_timeline.end(), [](Job const& a, Job const& b) {
+        return a.start < b.start;
+    });
+
+    m_hyperperiod = base::Time::fromMicroseconds(hyperperiod);
+    m_offsets.clear();
+    for (auto offset : offsets) {
+        m_offsets.push_back(base::Time::fromMicroseconds(offset));
+    }
+}
+
+base::Time I2CBusScheduler::getHyperperiod() const
+{
+    return m_hyperperiod;
+}
+
+base::Time I2CBusScheduler::getOffset(size_t task) const
+{
+    return m_offsets.at(task);
+}
+
+vector<I2CBusScheduler::Job> const& I2CBusScheduler::getTimeline() const
+{
+    return m_timeline;
+}
+
+void I2CBusScheduler::step()
+{
+    if (m_timeline.empty()) {
+        throw logic_error("no plan, call plan() first");
+    }
+    if (!m_running) {
+        m_cycle_start = chrono::steady_clock::now();
+        m_next_job = 0;
+        m_running = true;
+    }
+
+    auto const& job = m_timeline[m_next_job];
+    auto planned_start =
+        m_cycle_start + chrono::microseconds(job.start.toMicroseconds());
+    auto deadline = m_cycle_start + chrono::microseconds(job.deadline.toMicroseconds());
+
+    ++m_next_job;
+    if (m_next_job == m_timeline.size()) {
+        m_next_job = 0;
+        m_cycle_start += chrono::microseconds(m_hyperperiod.toMicroseconds());
+    }
+
+    this_thread::sleep_until(planned_start);
+    auto start = chrono::steady_clock::now();
+    m_tasks[job.task].callback();
+    auto end = chrono::steady_clock::now();
+
+    auto toTime = [](chrono::steady_clock::duration d) {
+        return base::Time::fromMicroseconds(
+            chrono::duration_cast<chrono::microseconds>(d).count());
+    };
+    auto& stats = m_statistics[job.task];
+    ++stats.runs;
+    stats.max_duration = max(stats.max_duration, toTime(end - start));
+    stats.max_start_delay = max(stats.max_start_delay, toTime(start - planned_start));
+    if (end > deadline) {
+        ++stats.deadline_misses;
+    }
+}
+
+void I2CBusScheduler::runUntil(chrono::steady_clock::time_point end)
+{
+    while (true) {
+        if (m_running) {
+            auto const& job = m_timeline.at(m_next_job);
+            auto next_start =
+                m_cycle_start + chrono::microseconds(job.start.toMicroseconds());
+            if (next_start >= end) {
+                return;
+            }
+        }
+        else if (chrono::steady_clock::now() >= end) {
+            return;
+        }
+        step();
+    }
+}
+
+I2CBusScheduler::TaskStatistics const& I2CBusScheduler::getStatistics(size_t task) const
+{
+    return m_statistics.at(task);
+}
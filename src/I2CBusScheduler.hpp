@@ -0,0 +1,149 @@
+#ifndef I2CLIB_I2CBUSSCHEDULER_HPP
+#define I2CLIB_I2CBUSSCHEDULER_HPP
+
+#include <base/Time.hpp>
+#include <i2clib/I2CTransactionBatch.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace i2clib {
+    /** Static cyclic scheduling of periodic tasks sharing an i2c bus
+     *
+     * Each task (e.g. reading a sensor or updating a PWM generator) is registered
+     * with its period, deadline and an estimate of the bus time it needs.
+     * \c plan then assigns a fixed offset within its period to each task, so that
+     * no two tasks use the bus at the same time over the whole hyperperiod (the
+     * least common multiple of all periods). Tasks are placed in rate-monotonic
+     * order, i.e. shortest period first.
+     *
+     * If \c plan succeeds, the task set fits on the bus. \c step and \c runUntil
+     * then execute the tasks on this timeline and record deadline misses, to
+     * check that the estimates hold in practice.
+     *
+     * All times are handled with a microsecond resolution
+     */
+    class I2CBusScheduler {
+    public:
+        struct Task {
+            std::string name;
+            /** Period of the task */
+            base::Time period;
+            /** Deadline relative to the start of the period. Set to zero to use
+             * the period */
+            base::Time deadline;
+            /** Estimated bus time needed by one execution of the task
+             *
+             * @see transferDuration
+             */
+            base::Time cost;
+            /** The function performing the task's i2c transactions */
+            std::function<void()> callback;
+        };
+
+        struct TaskStatistics {
+            uint64_t runs = 0;
+            uint64_t deadline_misses = 0;
+            /** Longest measured execution time */
+            base::Time max_duration;
+            /** Longest delay between the planned and actual start time */
+            base::Time max_start_delay;
+        };
+
+        /** A job, that is an execution of a task in the hyperperiod */
+        struct Job {
+            size_t task;
+            /** Start of the job, relative to the start of the hyperperiod */
+            base::Time start;
+            /** Deadline of the job, relative to the start of the hyperperiod */
+            base::Time deadline;
+        };
+
+        /** Maximum hyperperiod accepted by \c plan */
+        static const base::Time MAX_HYPERPERIOD;
+
+    private:
+        uint32_t m_bus_frequency;
+        std::vector<Task> m_tasks;
+        std::vector<TaskStatistics> m_statistics;
+        std::vector<base::Time> m_offsets;
+        std::vector<Job> m_timeline;
+        base::Time m_hyperperiod;
+
+        std::chrono::steady_clock::time_point m_cycle_start;
+        size_t m_next_job = 0;
+        bool m_running = false;
+
+    public:
+        /**
+         * @param bus_frequency the bus clock in Hz, used by \c transferDuration
+         */
+        explicit I2CBusScheduler(uint32_t bus_frequency = 400000);
+
+        /** Estimate the time on the wire of a transaction
+         *
+         * It is a write of \c write_size bytes followed, if \c read_size is
+         * nonzero, by a read of \c read_size bytes. It accounts for the start,
+         * address, data, acknowledge and stop bits, not for clock stretching
+         * nor software overhead
+         */
+        static base::Time transferDuration(size_t write_size,
+            size_t read_size,
+            uint32_t bus_frequency);
+
+        /** Estimate the time on the wire of a batch
+         *
+         * @see transferDuration
+         */
+        static base::Time transferDuration(I2CTransactionBatch const& batch,
+            uint32_t bus_frequency);
+
+        /** @overload using the scheduler's bus frequency */
+        base::Time transferDuration(size_t write_size, size_t read_size) const;
+
+        /** Register a task
+         *
+         * This invalidates the current plan
+         *
+         * @return the task index
+         */
+        size_t add(Task const& task);
+
+        /** Fraction of the bus time used by the tasks */
+        double getUtilization() const;
+
+        /** Compute the timeline
+         *
+         * @throw std::invalid_argument if the task set cannot be scheduled. The
+         *   message names the first task that could not be placed
+         */
+        void plan();
+
+        /** The hyperperiod of the last plan */
+        base::Time getHyperperiod() const;
+
+        /** The offset of a task within its period in the last plan */
+        base::Time getOffset(size_t task) const;
+
+        /** The jobs of the last plan, sorted by start time */
+        std::vector<Job> const& getTimeline() const;
+
+        /** Wait for the next job of the timeline and execute it
+         *
+         * The first call starts the timeline. Jobs that are late are executed
+         * immediately.
+         */
+        void step();
+
+        /** Execute jobs until the given time */
+        void runUntil(std::chrono::steady_clock::time_point end);
+
+        /** Execution statistics of a task */
+        TaskStatistics const& getStatistics(size_t task) const;
+    };
+}
+
+#endif
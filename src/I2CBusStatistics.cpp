@@ -0,0 +1,230 @@
+#include <i2clib/I2CBusStatistics.hpp>
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+
+using namespace i2clib;
+using namespace std;
+
+static base::Time nsToTime(uint64_t ns)
+{
+    return base::Time::fromMicroseconds((ns + 999) / 1000);
+}
+
+unsigned LatencyHistogram::bucketIndex(uint64_t ns)
+{
+    if (ns < SUB_BUCKET_COUNT) {
+        return ns;
+    }
+
+    uint64_t max = (uint64_t(1) << (MAX_EXPONENT + 1)) - 1;
+    ns = std::min(ns, max);
+    unsigned exponent = 63 - __builtin_clzll(ns);
+    unsigned shift = exponent - SUB_BUCKET_BITS;
+    unsigned sub_bucket = (ns >> shift) - SUB_BUCKET_COUNT;
+    return (shift + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(unsigned index)
+{
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    unsigned shift = index / SUB_BUCKET_COUNT - 1;
+    uint64_t sub_bucket = index % SUB_BUCKET_COUNT;
+    return ((SUB_BUCKET_COUNT + sub_bucket + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    uint64_t result = 0;
+    for (auto n : buckets) {
+        result += n;
+    }
+    return result;
+}
+
+base::Time LatencyHistogram::percentile(double fraction) const
+{
+    uint64_t total = count();
+    if (total == 0) {
+        return base::Time();
+    }
+
+    uint64_t target = std::max<uint64_t>(1, ceil(fraction * total));
+    uint64_t cumulated = 0;
+    for (unsigned i = 0; i < buckets.size(); ++i) {
+        cumulated += buckets[i];
+        if (cumulated >= target) {
+            return std::min(max, nsToTime(bucketUpperBound(i)));
+        }
+    }
+    return max;
+}
+
+double I2CBusStatistics::Snapshot::getUtilization() const
+{
+    if (duration.isNull()) {
+        return 0;
+    }
+    return bus.busy_time.toSeconds() / duration.toSeconds();
+}
+
+void I2CBusStatistics::AtomicCounters::recordLatency(uint64_t ns)
+{
+    busy_ns.fetch_add(ns, memory_order_relaxed);
+    latency[LatencyHistogram::bucketIndex(ns)].fetch_add(1, memory_order_relaxed);
+
+    uint64_t current = max_ns.load(memory_order_relaxed);
+    while (ns > current &&
+           !max_ns.compare_exchange_weak(current, ns, memory_order_relaxed)) {
+    }
+}
+
+void I2CBusStatistics::AtomicCounters::recordError(int error)
+{
+    errors.fetch_add(1, memory_order_relaxed);
+    if (error < 0 || error >= ERRNO_COUNT) {
+        error = 0;
+    }
+    errors_by_errno[error].fetch_add(1, memory_order_relaxed);
+}
+
+void I2CBusStatistics::AtomicCounters::reset()
+{
+    transactions.store(0, memory_order_relaxed);
+    transfers.store(0, memory_order_relaxed);
+    errors.store(0, memory_order_relaxed);
+    bytes_written.store(0, memory_order_relaxed);
+    bytes_read.store(0, memory_order_relaxed);
+    busy_ns.store(0, memory_order_relaxed);
+    max_ns.store(0, memory_order_relaxed);
+    for (auto& n : errors_by_errno) {
+        n.store(0, memory_order_relaxed);
+    }
+    for (auto& n : latency) {
+        n.store(0, memory_order_relaxed);
+    }
+}
+
+I2CBusStatistics::Counters I2CBusStatistics::AtomicCounters::snapshot() const
+{
+    Counters result;
+    result.transactions = transactions.load(memory_order_relaxed);
+    result.transfers = transfers.load(memory_order_relaxed);
+    result.errors = errors.load(memory_order_relaxed);
+    result.bytes_written = bytes_written.load(memory_order_relaxed);
+    result.bytes_read = bytes_read.load(memory_order_relaxed);
+    result.busy_time = nsToTime(busy_ns.load(memory_order_relaxed));
+    for (int i = 0; i < ERRNO_COUNT; ++i) {
+        if (uint64_t n = errors_by_errno[i].load(memory_order_relaxed)) {
+            result.errors_by_errno[i] = n;
+        }
+    }
+    for (unsigned i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+        result.latency.buckets[i] = latency[i].load(memory_order_relaxed);
+    }
+    result.latency.max = nsToTime(max_ns.load(memory_order_relaxed));
+    return result;
+}
+
+I2CBusStatistics::I2CBusStatistics()
+    : m_start(chrono::steady_clock::now().time_since_epoch().count())
+{
+}
+
+I2CBusStatistics::~I2CBusStatistics()
+{
+    for (auto& counters : m_addresses) {
+        delete counters.load();
+    }
+}
+
+I2CBusStatistics::AtomicCounters& I2CBusStatistics::address(uint8_t address)
+{
+    auto& slot = m_addresses[address & 0x7F];
+    AtomicCounters* counters = slot.load(memory_order_acquire);
+    if (counters) {
+        return *counters;
+    }
+
+    // First transaction to this address. Another thread might be doing the
+    // same, the loser of the race deletes its copy
+    auto* allocated = new AtomicCounters();
+    if (slot.compare_exchange_strong(counters, allocated, memory_order_acq_rel)) {
+        return *allocated;
+    }
+    delete allocated;
+    return *counters;
+}
+
+void I2CBusStatistics::record(I2CTransactionBatch::Message const* messages,
+    size_t count,
+    size_t completed,
+    int error,
+    chrono::steady_clock::duration latency)
+{
+    uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(latency).count();
+    bitset<128> targeted;
+
+    m_bus.transfers.fetch_add(1, memory_order_relaxed);
+    m_bus.recordLatency(ns);
+    for (size_t i = 0; i < count; ++i) {
+        auto const& message = messages[i];
+        auto& counters = address(message.address);
+
+        bool first_of_address = !targeted[message.address & 0x7F];
+        if (first_of_address) {
+            targeted[message.address & 0x7F] = true;
+            counters.transfers.fetch_add(1, memory_order_relaxed);
+            counters.recordLatency(ns);
+        }
+
+        if (i == 0 || messages[i - 1].transaction != message.transaction) {
+            counters.transactions.fetch_add(1, memory_order_relaxed);
+            m_bus.transactions.fetch_add(1, memory_order_relaxed);
+        }
+
+        if (i < completed) {
+            auto& bus_bytes = message.read ? m_bus.bytes_read : m_bus.bytes_written;
+            auto& bytes = message.read ? counters.bytes_read : counters.bytes_written;
+            bus_bytes.fetch_add(message.size, memory_order_relaxed);
+            bytes.fetch_add(message.size, memory_order_relaxed);
+        }
+        else if (i == completed) {
+            m_bus.recordError(error);
+            counters.recordError(error);
+        }
+    }
+}
+
+I2CBusStatistics::Snapshot I2CBusStatistics::snapshot() const
+{
+    Snapshot result;
+    auto start = chrono::steady_clock::time_point(
+        chrono::steady_clock::duration(m_start.load(memory_order_relaxed)));
+    result.duration = nsToTime(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start)
+            .count());
+    result.bus = m_bus.snapshot();
+    for (unsigned i = 0; i < m_addresses.size(); ++i) {
+        if (auto* counters = m_addresses[i].load(memory_order_acquire)) {
+            result.addresses[i] = counters->snapshot();
+        }
+    }
+    return result;
+}
+
+void I2CBusStatistics::reset()
+{
+    m_bus.reset();
+    for (auto& slot : m_addresses) {
+        if (auto* counters = slot.load(memory_order_acquire)) {
+            counters->reset();
+        }
+    }
+    m_start.store(chrono::steady_clock::now().time_since_epoch().count(),
+        memory_order_relaxed);
+}
@@ -0,0 +1,163 @@
+#ifndef I2CLIB_I2CBUSSTATISTICS_HPP
+#define I2CLIB_I2CBUSSTATISTICS_HPP
+
+#include <base/Time.hpp>
+#include <i2clib/I2CTransactionBatch.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace i2clib {
+    /** Latency distribution, as a log-linear histogram
+     *
+     * Values are recorded in nanoseconds. Values below 2^SUB_BUCKET_BITS have
+     * their own bucket. Above, each power of two is split in 2^SUB_BUCKET_BITS
+     * buckets, which bounds the relative error of the percentiles to 1/16.
+     */
+    struct LatencyHistogram {
+        static constexpr unsigned SUB_BUCKET_BITS = 4;
+        static constexpr unsigned SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+        /** Values above 2^MAX_EXPONENT ns (about 18 minutes) are clamped */
+        static constexpr unsigned MAX_EXPONENT = 40;
+        static constexpr unsigned BUCKET_COUNT =
+            SUB_BUCKET_COUNT * (MAX_EXPONENT - SUB_BUCKET_BITS + 2);
+
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(BUCKET_COUNT, 0);
+        /** Largest recorded value */
+        base::Time max;
+
+        /** The bucket a value in nanoseconds falls in */
+        static unsigned bucketIndex(uint64_t ns);
+        /** The largest value, in nanoseconds, that falls in the given bucket */
+        static uint64_t bucketUpperBound(unsigned index);
+
+        /** Total number of values */
+        uint64_t count() const;
+
+        /** The value below which the given fraction of the values fall
+         *
+         * The result is the upper bound of the bucket, capped by \c max. It is
+         * zero if the histogram is empty
+         *
+         * @param fraction between 0 and 1, e.g. 0.99 for the 99th percentile
+         */
+        base::Time percentile(double fraction) const;
+    };
+
+    /** Lock-free counters of the activity on an i2c bus
+     *
+     * The counters are kept for the whole bus and per device address. They
+     * are updated by \c record, which may be called concurrently from several
+     * threads, and read with \c snapshot.
+     *
+     * Per-address counters are allocated on the first transaction to that
+     * address.
+     */
+    class I2CBusStatistics {
+    public:
+        /** Errno values at or above this limit are counted as zero */
+        static constexpr int ERRNO_COUNT = 134;
+
+        struct Counters {
+            /** Number of transactions, i.e. of calls to read and write or of
+             * transactions in a batch */
+            uint64_t transactions = 0;
+            /** Number of ioctls */
+            uint64_t transfers = 0;
+            /** Number of failed ioctls */
+            uint64_t errors = 0;
+            /** Bytes written to the devices, in completed messages */
+            uint64_t bytes_written = 0;
+            /** Bytes read from the devices, in completed messages */
+            uint64_t bytes_read = 0;
+            /** Cumulated duration of the ioctls */
+            base::Time busy_time;
+            /** Number of errors by errno value */
+            std::map<int, uint64_t> errors_by_errno;
+            /** Duration of the ioctls */
+            LatencyHistogram latency;
+        };
+
+        struct Snapshot {
+            /** Time since the statistics were enabled or reset */
+            base::Time duration;
+            /** Counters for the whole bus */
+            Counters bus;
+            /** Counters for the addresses that had at least one transaction */
+            std::map<uint8_t, Counters> addresses;
+
+            /** Fraction of the time spent in ioctls */
+            double getUtilization() const;
+        };
+
+    private:
+        struct AtomicCounters {
+            std::atomic<uint64_t> transactions{0};
+            std::atomic<uint64_t> transfers{0};
+            std::atomic<uint64_t> errors{0};
+            std::atomic<uint64_t> bytes_written{0};
+            std::atomic<uint64_t> bytes_read{0};
+            std::atomic<uint64_t> busy_ns{0};
+            std::atomic<uint64_t> max_ns{0};
+            std::array<std::atomic<uint64_t>, ERRNO_COUNT> errors_by_errno{};
+            std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT> latency{};
+
+            void recordLatency(uint64_t ns);
+            void recordError(int error);
+            void reset();
+            Counters snapshot() const;
+        };
+
+        AtomicCounters m_bus;
+        std::array<std::atomic<AtomicCounters*>, 128> m_addresses{};
+        std::atomic<std::chrono::steady_clock::rep> m_start;
+
+        AtomicCounters& address(uint8_t address);
+
+    public:
+        I2CBusStatistics();
+        ~I2CBusStatistics();
+
+        I2CBusStatistics(I2CBusStatistics const&) = delete;
+        I2CBusStatistics& operator=(I2CBusStatistics const&) = delete;
+
+        /** Record a single ioctl
+         *
+         * The latency is recorded for the bus and for every address the ioctl
+         * targeted. Errors are attributed to the address of the message at
+         * \c completed, i.e. the first message that was not completed.
+         *
+         * @param messages the messages of the ioctl
+         * @param count the number of messages
+         * @param completed the number of messages that were completed. It is
+         *   \c count on success
+         * @param error the errno value, zero on success
+         * @param latency the duration of the ioctl
+         */
+        void record(I2CTransactionBatch::Message const* messages,
+            size_t count,
+            size_t completed,
+            int error,
+            std::chrono::steady_clock::duration latency);
+
+        /** Read all counters
+         *
+         * The counters are read individually, so a snapshot taken while
+         * transactions are recorded may be slightly inconsistent
+         */
+        Snapshot snapshot() const;
+
+        /** Zero all counters
+         *
+         * Transactions recorded while the reset is in progress may be partially
+         * lost
+         */
+        void reset();
+    };
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include <i2clib/I2CTransactionBatch.hpp>
+
+#include <stdexcept>
+#include <string>
+
+using namespace i2clib;
+using namespace std;
+
+void I2CTransactionBatch::add(uint8_t address, bool read, uint8_t* buffer, size_t size)
+{
+    Message message;
+    message.address = address;
+    message.read = read;
+    message.buffer = buffer;
+    message.size = size;
+    message.transaction = m_transaction_count;
+    m_messages.push_back(message);
+}
+
+void I2CTransactionBatch::write(uint8_t address, uint8_t* bytes, size_t size)
+{
+    add(address, false, bytes, size);
+    ++m_transaction_count;
+}
+
+void I2CTransactionBatch::read(uint8_t address,
+    uint8_t* write_bytes,
+    size_t write_size,
+    uint8_t* bytes,
+    size_t size)
+{
+    add(address, false, write_bytes, write_size);
+    add(address, true, bytes, size);
+    ++m_transaction_count;
+}
+
+void I2CTransactionBatch::read(uint8_t address, uint8_t* bytes, size_t size)
+{
+    add(address, true, bytes, size);
+    ++m_transaction_count;
+}
+
+void I2CTransactionBatch::clear()
+{
+    m_messages.clear();
+    m_transaction_count = 0;
+}
+
+void I2CTransactionBatch::reserve(size_t message_count)
+{
+    m_messages.reserve(message_count);
+}
+
+bool I2CTransactionBatch::empty() const
+{
+    return m_messages.empty();
+}
+
+size_t I2CTransactionBatch::transactionCount() const
+{
+    return m_transaction_count;
+}
+
+vector<I2CTransactionBatch::Message> const& I2CTransactionBatch::messages() const
+{
+    return m_messages;
+}
+
+size_t I2CTransactionBatch::splitPoint(size_t begin, size_t max_messages) const
+{
+    size_t end = begin + max_messages;
+    if (end >= m_messages.size()) {
+        return m_messages.size();
+    }
+
+    // Move back so that the transaction of the first message not in the group
+    // is not split
+    size_t transaction = m_messages[end].transaction;
+    while (end > begin && m_messages[end - 1].transaction == transaction) {
+        --end;
+    }
+    if (end == begin) {
+        throw invalid_argument("cannot fit a single transaction in " +
+                               to_string(max_messages) + " messages");
+    }
+    return end;
+}
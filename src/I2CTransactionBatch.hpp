@@ -0,0 +1,84 @@
+#ifndef I2CLIB_I2CTRANSACTIONBATCH_HPP
+#define I2CLIB_I2CTRANSACTIONBATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace i2clib {
+    /** A list of i2c transactions meant to be submitted in a single system call
+     *
+     * The transactions may target different devices on the same bus. They are
+     * performed in order with I2CBus::transfer, which submits them with as few
+     * I2C_RDWR ioctls as the kernel allows.
+     *
+     * The batch only references the caller's buffers. They must remain valid
+     * until the batch has been transferred. Read data is written directly in
+     * the buffers given to \c read.
+     */
+    class I2CTransactionBatch {
+    public:
+        /** A single i2c message, i.e. the part of a transaction between two
+         * (repeated) start conditions
+         */
+        struct Message {
+            std::uint8_t address = 0;
+            bool read = false;
+            std::uint8_t* buffer = nullptr;
+            std::size_t size = 0;
+            /** Index of the transaction this message is part of */
+            std::size_t transaction = 0;
+        };
+
+    private:
+        std::vector<Message> m_messages;
+        std::size_t m_transaction_count = 0;
+
+        void add(std::uint8_t address, bool read, std::uint8_t* buffer, std::size_t size);
+
+    public:
+        /** Queue a transaction that writes \c size bytes to the given address */
+        void write(std::uint8_t address, std::uint8_t* bytes, std::size_t size);
+
+        /** Queue a transaction with a write followed by a read
+         *
+         * This is the batch equivalent of I2CBus::read
+         */
+        void read(std::uint8_t address,
+            std::uint8_t* write_bytes,
+            std::size_t write_size,
+            std::uint8_t* bytes,
+            std::size_t size);
+
+        /** Queue a transaction that reads \c size bytes from the given address */
+        void read(std::uint8_t address, std::uint8_t* bytes, std::size_t size);
+
+        /** Remove all transactions, keeping the allocated memory */
+        void clear();
+
+        /** Pre-allocate memory for the given number of messages */
+        void reserve(std::size_t message_count);
+
+        /** Whether the batch has no transactions */
+        bool empty() const;
+
+        /** The number of transactions in this batch */
+        std::size_t transactionCount() const;
+
+        /** The messages in this batch */
+        std::vector<Message> const& messages() const;
+
+        /** Compute the end of the next group of messages that can be submitted
+         * in a single system call
+         *
+         * Transactions are never split between two groups
+         *
+         * @param begin index of the first message of the group
+         * @param max_messages maximum number of messages in a group
+         * @return the index one past the last message of the group
+         */
+        std::size_t splitPoint(std::size_t begin, std::size_t max_messages) const;
+    };
+}
+
+#endif
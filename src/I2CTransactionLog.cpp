@@ -0,0 +1,120 @@
+#include <i2clib/I2CTransactionLog.hpp>
+
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+using namespace i2clib;
+using namespace std;
+
+static const size_t ENTRY_HEADER_SIZE = 20;
+
+template <typename T> static void encode(uint8_t*& buffer, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        *buffer++ = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+template <typename T> static T decode(uint8_t const*& buffer)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<T>(*buffer++) << (8 * i);
+    }
+    return value;
+}
+
+void I2CTransactionLog::writeHeader(ostream& stream)
+{
+    uint8_t header[sizeof(MAGIC) + 4];
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    uint8_t* version = header + sizeof(MAGIC);
+    encode<uint32_t>(version, VERSION);
+    stream.write(reinterpret_cast<char const*>(header), sizeof(header));
+}
+
+void I2CTransactionLog::readHeader(istream& stream)
+{
+    uint8_t header[sizeof(MAGIC) + 4];
+    if (!stream.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+        throw runtime_error("not an i2c transaction log");
+    }
+
+    uint8_t const* version_bytes = header + sizeof(MAGIC);
+    uint32_t version = decode<uint32_t>(version_bytes);
+    if (version != VERSION) {
+        throw runtime_error("unsupported i2c transaction log version " +
+                            to_string(version) + ", expected " + to_string(VERSION));
+    }
+}
+
+void I2CTransactionLog::writeEntry(ostream& stream, Entry const& entry)
+{
+    if (entry.write_bytes.size() > 0xFFFF || entry.read_bytes.size() > 0xFFFF) {
+        throw invalid_argument("i2c transaction log entries are limited to 65535 "
+                               "bytes per message");
+    }
+
+    uint8_t header[ENTRY_HEADER_SIZE];
+    uint8_t* it = header;
+    encode<uint64_t>(it, entry.time.toMicroseconds());
+    encode<uint32_t>(it, entry.duration.toMicroseconds());
+    encode<uint8_t>(it, entry.address);
+    encode<uint8_t>(it, entry.flags);
+    encode<uint8_t>(it, entry.error);
+    encode<uint8_t>(it, 0);
+    encode<uint16_t>(it, entry.write_bytes.size());
+    encode<uint16_t>(it, entry.read_bytes.size());
+
+    stream.write(reinterpret_cast<char const*>(header), sizeof(header));
+    stream.write(reinterpret_cast<char const*>(entry.write_bytes.data()),
+        entry.write_bytes.size());
+    stream.write(reinterpret_cast<char const*>(entry.read_bytes.data()),
+        entry.read_bytes.size());
+}
+
+bool I2CTransactionLog::readEntry(istream& stream, Entry& entry)
+{
+    uint8_t header[ENTRY_HEADER_SIZE];
+    stream.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (stream.gcount() == 0) {
+        return false;
+    }
+    else if (static_cast<size_t>(stream.gcount()) != sizeof(header)) {
+        throw runtime_error("truncated i2c transaction log");
+    }
+
+    uint8_t const* it = header;
+    entry.time = base::Time::fromMicroseconds(decode<uint64_t>(it));
+    entry.duration = base::Time::fromMicroseconds(decode<uint32_t>(it));
+    entry.address = decode<uint8_t>(it);
+    entry.flags = decode<uint8_t>(it);
+    entry.error = decode<uint8_t>(it);
+    decode<uint8_t>(it);
+    entry.write_bytes.resize(decode<uint16_t>(it));
+    entry.read_bytes.resize(decode<uint16_t>(it));
+
+    stream.read(reinterpret_cast<char*>(entry.write_bytes.data()),
+        entry.write_bytes.size());
+    stream.read(reinterpret_cast<char*>(entry.read_bytes.data()),
+        entry.read_bytes.size());
+    if (!stream) {
+        throw runtime_error("truncated i2c transaction log");
+    }
+    return true;
+}
+
+vector<I2CTransactionLog::Entry> I2CTransactionLog::readAll(istream& stream)
+{
+    readHeader(stream);
+
+    vector<Entry> result;
+    Entry entry;
+    while (readEntry(stream, entry)) {
+        result.push_back(entry);
+    }
+    return result;
+}
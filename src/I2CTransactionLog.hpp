@@ -0,0 +1,80 @@
+#ifndef I2CLIB_I2CTRANSACTIONLOG_HPP
+#define I2CLIB_I2CTRANSACTIONLOG_HPP
+
+#include <base/Time.hpp>
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace i2clib {
+    /** Binary format of the logs written by RecordingI2CBus and read by
+     * ReplayI2CBus
+     *
+     * A log is a header (the MAGIC bytes and the format version) followed by
+     * one entry per transaction. An entry is a 20 bytes little-endian header,
+     * followed by the written bytes and then the read bytes:
+     *
+     * - time since the start of the recording (uint64, microseconds)
+     * - duration of the transfer (uint32, microseconds)
+     * - address (uint8)
+     * - flags (uint8, see Flags)
+     * - errno, zero on success (uint8)
+     * - reserved (uint8)
+     * - number of written bytes (uint16)
+     * - number of read bytes (uint16)
+     *
+     * Transactions of a single batch share the same time and duration.
+     */
+    class I2CTransactionLog {
+    public:
+        static constexpr char MAGIC[8] = {'I', '2', 'C', 'L', 'O', 'G', '\0', '\0'};
+        static constexpr std::uint32_t VERSION = 1;
+
+        enum Flags {
+            /** The transaction starts with a write message */
+            HAS_WRITE = 1,
+            /** The transaction has a read message */
+            HAS_READ = 2
+        };
+
+        struct Entry {
+            /** Start of the transfer, relative to the start of the recording */
+            base::Time time;
+            /** Duration of the whole transfer */
+            base::Time duration;
+            std::uint8_t address = 0;
+            std::uint8_t flags = 0;
+            /** The errno of the failure, or zero if the transaction succeeded */
+            int error = 0;
+            std::vector<std::uint8_t> write_bytes;
+            /** The bytes returned by the device. Their content is unspecified
+             * if \c error is nonzero */
+            std::vector<std::uint8_t> read_bytes;
+        };
+
+        /** Write the log header */
+        static void writeHeader(std::ostream& stream);
+
+        /** Read and validate the log header
+         *
+         * @throw std::runtime_error if the stream is not a log, or has an
+         *   unsupported version
+         */
+        static void readHeader(std::istream& stream);
+
+        static void writeEntry(std::ostream& stream, Entry const& entry);
+
+        /** Read the next entry
+         *
+         * @return false if the end of the log has been reached
+         * @throw std::runtime_error if the log is truncated
+         */
+        static bool readEntry(std::istream& stream, Entry& entry);
+
+        /** Read a complete log, including its header */
+        static std::vector<Entry> readAll(std::istream& stream);
+    };
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef I2CLIB_I2CTRANSPORT_HPP
+#define I2CLIB_I2CTRANSPORT_HPP
+
+#include <i2clib/I2CTransactionBatch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace i2clib {
+    /** Interface for the objects that perform i2c transactions
+     *
+     * The chip drivers only rely on this interface. \c I2CBus implements it on top
+     * of the Linux i2c-dev interface, and \c SimulatedI2CBus in-process for testing
+     * and benchmarking purposes.
+     *
+     * Implementations report errors with the exceptions defined in Exceptions.hpp
+     */
+    class I2CTransport {
+    public:
+        virtual ~I2CTransport() = default;
+
+        /** Perform a transaction with a write followed by a read
+         *
+         * \c data contains information for the write. The read information is
+         * returned.
+         */
+        template <int Size> std::array<uint8_t, Size> read(uint8_t address, uint8_t reg)
+        {
+            std::array<uint8_t, Size> read_bytes;
+            uint8_t reg_rw{reg};
+
+            read(address, &reg_rw, 1, read_bytes.data(), read_bytes.size());
+            return read_bytes;
+        }
+
+        /** Perform a transaction with a write followed by a read
+         *
+         * \c data contains information for the write. The read information is
+         * returned.
+         */
+        virtual void read(uint8_t address,
+            uint8_t* write_bytes,
+            size_t write_size,
+            uint8_t* bytes,
+            size_t size) = 0;
+
+        /** Write \c size bytes at the given address
+         */
+        virtual void write(uint8_t address, uint8_t* bytes, size_t size) = 0;
+
+        /** @overload compatible with initializer lists
+         *
+         * @example i2c.write(DEVICE_ADRESS, { 1, 2 })
+         */
+        template <int Size> void write(uint8_t address, uint8_t const (&data)[Size])
+        {
+            std::array<uint8_t, Size> rw_data;
+            std::copy(data, data + Size, rw_data.begin());
+            return write(address, rw_data.data(), Size);
+        }
+
+        /** Perform all transactions of a batch, in order
+         *
+         * @throw BatchError if one of the messages failed. The exception
+         *   identifies the messages that were not completed
+         */
+        virtual void transfer(I2CTransactionBatch const& batch) = 0;
+    };
+}
+
+#endif
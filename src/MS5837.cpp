@@ -1,20 +1,56 @@
+#include <algorithm>
 #include <chrono>
+#include <i2clib/CalibrationCache.hpp>
+#include <i2clib/ClockAnchor.hpp>
+#include <i2clib/I2CTransactionBatch.hpp>
 #include <i2clib/MS5837.hpp>
 #include <iostream>
 #include <stdexcept>
 #include <thread>
+#include <vector>
 
 using namespace i2clib;
 using namespace std;
 
-MS5837::MS5837(Models model, I2CBus& bus, uint8_t address)
+MS5837::MS5837(Models model, I2CTransport& bus, uint8_t address)
     : m_model(model)
+    , m_compensate(compensationFunction(model))
     , m_bus(bus)
     , m_address(address)
 {
     m_prom = readPROM();
 }
 
+MS5837::MS5837(Models model,
+    I2CTransport& bus,
+    uint8_t address,
+    CalibrationCache& cache,
+    string const& bus_path)
+    : m_model(model)
+    , m_compensate(compensationFunction(model))
+    , m_bus(bus)
+    , m_address(address)
+{
+    auto key = CalibrationCache::key("ms5837", bus_path, address);
+    vector<uint8_t> entry;
+    if (cache.get(key, entry) && entry.size() == 2 * CMD_PROM_READ_COUNT) {
+        for (int i = 0; i < CMD_PROM_READ_COUNT; ++i) {
+            m_prom.C[i] = static_cast<uint16_t>(entry[2 * i]) << 8 | entry[2 * i + 1];
+        }
+        if (isValidPROM(m_prom)) {
+            return;
+        }
+    }
+
+    m_prom = readPROM();
+    entry.resize(2 * CMD_PROM_READ_COUNT);
+    for (int i = 0; i < CMD_PROM_READ_COUNT; ++i) {
+        entry[2 * i] = m_prom.C[i] >> 8;
+        entry[2 * i + 1] = m_prom.C[i] & 0xFF;
+    }
+    cache.set(key, entry);
+}
+
 void MS5837::reset()
 {
     uint8_t cmd = CMD_RESET;
@@ -23,19 +59,168 @@ void MS5837::reset()
 
 MS5837Measurement MS5837::read(int temperature_osr, int pressure_osr)
 {
-    int64_t raw_temperature = readRawTemperature(temperature_osr);
-    int64_t raw_pressure = readRawPressure(pressure_osr);
+    startAcquisition(temperature_osr, pressure_osr);
+
+    Measurement result;
+    while (true) {
+        this_thread::sleep_until(m_conversion_ready_at);
+        if (poll(result)) {
+            return result;
+        }
+    }
+}
+
+void MS5837::startAcquisition(int temperature_osr, int pressure_osr)
+{
+    validateOSR(pressure_osr);
+    startTemperatureConversion(temperature_osr);
+    m_acquisition_pressure_osr = pressure_osr;
+}
 
-    auto [temperature, dT] = compensateRawTemperature(raw_temperature, m_prom);
-    auto pressure = compensateRawPressure(raw_pressure, dT, m_prom);
+void MS5837::startTemperatureConversion(int osr)
+{
+    startConversion(CONVERSION_TEMPERATURE, CMD_CONVERT_D2_BASE, osr);
+}
+
+void MS5837::startPressureConversion(int osr)
+{
+    startConversion(CONVERSION_PRESSURE, CMD_CONVERT_D1_BASE, osr);
+}
+
+void MS5837::startConversion(ConversionState state, uint8_t command_base, int osr)
+{
+    validateOSR(osr);
+
+    m_acquisition_pressure_osr = -1;
+    m_conversion_state = CONVERSION_IDLE;
+    m_bus.write(m_address, {static_cast<uint8_t>(command_base + 2 * osr)});
+    m_conversion_state = state;
+    // The conversion starts when the chip receives the command, i.e. just before
+    // the write returns
+    m_conversion_started_at = chrono::steady_clock::now();
+    m_conversion_ready_at = m_conversion_started_at + conversionDuration(osr);
+}
+
+MS5837::ConversionState MS5837::getConversionState() const
+{
+    return m_conversion_state;
+}
+
+chrono::steady_clock::time_point MS5837::conversionReadyAt() const
+{
+    return m_conversion_ready_at;
+}
+
+bool MS5837::poll(Measurement& measurement)
+{
+    if (m_conversion_state == CONVERSION_IDLE ||
+        chrono::steady_clock::now() < m_conversion_ready_at) {
+        return false;
+    }
+
+    if (m_conversion_state == CONVERSION_TEMPERATURE) {
+        int pressure_osr = m_acquisition_pressure_osr;
+        readConversionResult();
+        if (pressure_osr != -1) {
+            startPressureConversion(pressure_osr);
+        }
+        return false;
+    }
 
+    int32_t raw_pressure = readConversionResult();
+    if (!m_has_raw_temperature) {
+        throw runtime_error("cannot compensate the pressure, no temperature has "
+                            "been acquired yet");
+    }
+
+    measurement = compensate(m_raw_temperature, raw_pressure);
+    return true;
+}
+
+MS5837::Measurement MS5837::compensate(int32_t raw_temperature,
+    int32_t raw_pressure) const
+{
+    auto compensated = m_compensate(raw_temperature, raw_pressure, m_prom);
+
+    ClockAnchor anchor;
+    auto const& timing = m_pressure_timing;
     Measurement result;
-    result.time = base::Time::now();
-    result.pressure = pressure;
-    result.temperature = temperature;
+    result.time = anchor.toTime(timing.start + (timing.end - timing.start) / 2);
+    result.acquisition_start = anchor.toTime(timing.start);
+    result.acquisition_end = anchor.toTime(timing.end);
+    result.transport_latency = ClockAnchor::toDuration(timing.transport_latency);
+    result.pressure = base::Pressure::fromPascal(compensated.pressure);
+    result.temperature =
+        base::Temperature::fromCelsius(static_cast<double>(compensated.temperature) / 100);
     return result;
 }
 
+MS5837::CompensationFunction MS5837::compensationFunction(Models model)
+{
+    switch (model) {
+        case MODEL_30BA:
+            return &compensateFixed<MODEL_30BA>;
+        case MODEL_02BA:
+            return &compensateFixed<MODEL_02BA>;
+    }
+    throw std::invalid_argument("unknown MS5837 model " + to_string(model));
+}
+
+template <MS5837::Models model>
+static void compensateSeries(size_t count,
+    int32_t const* raw_temperature,
+    int32_t const* raw_pressure,
+    MS5837::PROM const& prom,
+    int32_t* temperature,
+    int32_t* pressure)
+{
+    for (size_t i = 0; i < count; ++i) {
+        auto compensated =
+            MS5837::compensateFixed<model>(raw_temperature[i], raw_pressure[i], prom);
+        temperature[i] = compensated.temperature;
+        pressure[i] = compensated.pressure;
+    }
+}
+
+void MS5837::compensateBatch(Models model,
+    size_t count,
+    int32_t const* raw_temperature,
+    int32_t const* raw_pressure,
+    PROM const& prom,
+    int32_t* temperature,
+    int32_t* pressure)
+{
+    switch (model) {
+        case MODEL_30BA:
+            return compensateSeries<MODEL_30BA>(count, raw_temperature, raw_pressure,
+                prom, temperature, pressure);
+        case MODEL_02BA:
+            return compensateSeries<MODEL_02BA>(count, raw_temperature, raw_pressure,
+                prom, temperature, pressure);
+    }
+    throw std::invalid_argument("unknown MS5837 model " + to_string(model));
+}
+
+int32_t MS5837::readConversionResult()
+{
+    ConversionState state = m_conversion_state;
+    m_conversion_state = CONVERSION_IDLE;
+    m_acquisition_pressure_osr = -1;
+
+    auto read_start = chrono::steady_clock::now();
+    int32_t raw = readADC();
+    if (state == CONVERSION_TEMPERATURE) {
+        m_raw_temperature = raw;
+        m_has_raw_temperature = true;
+    }
+    else if (state == CONVERSION_PRESSURE) {
+        m_pressure_timing.start = m_conversion_started_at;
+        m_pressure_timing.end = min(m_conversion_ready_at, read_start);
+        m_pressure_timing.transport_latency = chrono::steady_clock::now() - read_start;
+    }
+    return raw;
+}
+
 /** Compute the actual temperature from calibration and raw data */
 pair<base::Temperature, int64_t> MS5837::compensateRawTemperature(int32_t raw,
     PROM const& prom)
@@ -47,7 +232,7 @@ pair<base::Temperature, int64_t> MS5837::compensateRawTemperature(int32_t raw,
     return make_pair(temp, dT);
 }
 
-/** Compute the actual temperature from calibration and raw data */
+/** Compute the actual pressure from calibration and raw data */
 base::Pressure MS5837::compensateRawPressure(int32_t raw, int64_t dT, PROM const& prom)
 {
     int64_t offset = (static_cast<int64_t>(prom.C[2]) << 16) + ((prom.C[4] * dT) >> 7);
@@ -58,15 +243,24 @@ base::Pressure MS5837::compensateRawPressure(int32_t raw, int64_t dT, PROM const
 
 MS5837::PROM MS5837::readPROM()
 {
+    array<uint8_t, CMD_PROM_READ_COUNT> commands;
+    array<uint8_t, 2 * CMD_PROM_READ_COUNT> data;
+    I2CTransactionBatch batch;
+    batch.reserve(2 * CMD_PROM_READ_COUNT);
+    for (int i = 0; i < CMD_PROM_READ_COUNT; ++i) {
+        commands[i] = CMD_PROM_READ_BASE + i * 2;
+        batch.read(m_address, &commands[i], 1, &data[2 * i], 2);
+    }
+    m_bus.transfer(batch);
+
     PROM result;
     for (int i = 0; i < CMD_PROM_READ_COUNT; ++i) {
-        auto data = m_bus.read<2>(m_address, CMD_PROM_READ_BASE + i * 2);
-        result.C[i] = static_cast<uint16_t>(data[0]) << 8 | data[1];
+        result.C[i] = static_cast<uint16_t>(data[2 * i]) << 8 | data[2 * i + 1];
     }
 
-    uint8_t crc = crc4(result.C);
-    uint8_t actual_crc = (result.C[0] >> 12);
-    if (crc != actual_crc) {
+    if (!isValidPROM(result)) {
+        uint8_t crc = crc4(result.C);
+        uint8_t actual_crc = (result.C[0] >> 12);
         cerr << "Read PROM data\n";
         for (int i = 0; i < CMD_PROM_READ_COUNT; ++i) {
             cerr << hex << result.C[i] << "\n";
@@ -78,26 +272,35 @@ MS5837::PROM MS5837::readPROM()
     return result;
 }
 
-int32_t MS5837::readRawPressure(int osr)
+MS5837::PROM MS5837::getPROM() const
 {
-    if (osr < 0 || osr > CONVERT_OSR_8192) {
-        throw std::invalid_argument("OSR value must be between 0 and 5");
-    }
+    return m_prom;
+}
 
-    m_bus.write(m_address, {static_cast<uint8_t>(CMD_CONVERT_D1_BASE + 2 * osr)});
-    waitConversion(osr);
-    return readADC();
+bool MS5837::isValidPROM(PROM const& prom)
+{
+    return crc4(prom.C) == (prom.C[0] >> 12);
+}
+
+int32_t MS5837::readRawPressure(int osr)
+{
+    startPressureConversion(osr);
+    this_thread::sleep_until(m_conversion_ready_at);
+    return readConversionResult();
 }
 
 int32_t MS5837::readRawTemperature(int osr)
+{
+    startTemperatureConversion(osr);
+    this_thread::sleep_until(m_conversion_ready_at);
+    return readConversionResult();
+}
+
+void MS5837::validateOSR(int osr)
 {
     if (osr < 0 || osr > CONVERT_OSR_8192) {
         throw std::invalid_argument("OSR value must be between 0 and 5");
     }
-
-    m_bus.write(m_address, {static_cast<uint8_t>(CMD_CONVERT_D2_BASE + 2 * osr)});
-    waitConversion(osr);
-    return readADC();
 }
 
 int32_t MS5837::readADC()
@@ -107,13 +310,13 @@ int32_t MS5837::readADC()
            data[2];
 }
 
-void MS5837::waitConversion(int osr)
+chrono::nanoseconds MS5837::conversionDuration(int osr)
 {
     // Duration taken from bluerobotics python driver
     //
     // https://github.com/bluerobotics/ms5837-python/blob/master/ms5837/ms5837.py
     uint32_t nanoseconds = 2500 * (1 << (8 + osr));
-    this_thread::sleep_for(std::chrono::nanoseconds(nanoseconds));
+    return chrono::nanoseconds(nanoseconds);
 }
 
 uint8_t MS5837::crc4(array<uint16_t, CMD_PROM_READ_COUNT> const& prom)
@@ -2,12 +2,18 @@
 #define I2CLIB_MS5837_HPP
 
 #include <array>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 
-#include <i2clib/I2CBus.hpp>
+#include <i2clib/I2CTransport.hpp>
 #include <i2clib/MS5837Measurement.hpp>
 
+#include <string>
+
 namespace i2clib {
+    class CalibrationCache;
+
     /** TE Connectivity pressure sensor
      */
     class MS5837 {
@@ -31,31 +37,98 @@ namespace i2clib {
         };
 
         enum Models {
-            MODEL_30BA = 0
+            MODEL_30BA = 0,
+            MODEL_02BA = 1
+        };
+
+        /** Model-specific constants of the compensation
+         *
+         * Specialized for each value of \c Models below the class definition
+         */
+        template <Models model> struct ModelTraits;
+
+        /** Compensated measurement in fixed point */
+        struct Compensated {
+            /** Temperature in hundredths of degree Celsius */
+            std::int32_t temperature;
+            /** Pressure in Pascal */
+            std::int32_t pressure;
+        };
+
+        enum ConversionState {
+            /** No conversion in progress */
+            CONVERSION_IDLE,
+            /** A temperature (D2) conversion is in progress */
+            CONVERSION_TEMPERATURE,
+            /** A pressure (D1) conversion is in progress */
+            CONVERSION_PRESSURE
         };
 
     private:
+        typedef Compensated (*CompensationFunction)(std::int32_t raw_temperature,
+            std::int32_t raw_pressure,
+            PROM const& prom);
+
         Models m_model;
-        I2CBus& m_bus;
+        /** Compensation function for \c m_model, resolved in the constructor */
+        CompensationFunction m_compensate;
+        I2CTransport& m_bus;
         uint8_t m_address;
         PROM m_prom;
 
-        static uint8_t crc4(std::array<uint16_t, CMD_PROM_READ_COUNT> const& prom);
+        ConversionState m_conversion_state = CONVERSION_IDLE;
+        std::chrono::steady_clock::time_point m_conversion_started_at;
+        std::chrono::steady_clock::time_point m_conversion_ready_at;
+        /** OSR of the pressure conversion that follows the current temperature
+         * conversion during a complete acquisition, or -1 if there is none */
+        int m_acquisition_pressure_osr = -1;
+        int32_t m_raw_temperature = 0;
+        bool m_has_raw_temperature = false;
 
-        /** Wait the time required to perform the conversion
-         *
-         * @param osr the oversampling parameter
-         */
-        static void waitConversion(int osr);
+        /** Timing of the last pressure conversion whose result has been read */
+        struct ConversionTiming {
+            std::chrono::steady_clock::time_point start;
+            std::chrono::steady_clock::time_point end;
+            std::chrono::steady_clock::duration transport_latency{};
+        };
+        ConversionTiming m_pressure_timing;
+
+        static void validateOSR(int osr);
+
+        /** Send a conversion command and update the conversion state */
+        void startConversion(ConversionState state, std::uint8_t command_base, int osr);
 
         /** Read ADC data */
         int32_t readADC();
 
+        static CompensationFunction compensationFunction(Models model);
+
+        /** Whether the CRC stored in the PROM matches its contents */
+        static bool isValidPROM(PROM const& prom);
+
     public:
         /**
          * @param model the exact model of the chip. Affects the conversion function
          */
-        MS5837(Models model, I2CBus& bus, uint8_t address = 118);
+        MS5837(Models model, I2CTransport& bus, uint8_t address = 118);
+
+        /** Create the driver, using the PROM stored in a cache if there is one
+         *
+         * A cached PROM is used if its CRC is valid, in which case the
+         * constructor does not access the bus at all. Otherwise, the PROM is
+         * read from the chip and stored in the cache.
+         *
+         * Since the cached PROM is not compared with the chip's, the cache
+         * entry must be erased when the chip is replaced
+         *
+         * @param bus_path path of the bus, used to identify the chip in the
+         *   cache (see \c I2CBus::getPath)
+         */
+        MS5837(Models model,
+            I2CTransport& bus,
+            uint8_t address,
+            CalibrationCache& cache,
+            std::string const& bus_path);
 
         /** Reset the chip */
         void reset();
@@ -69,22 +142,134 @@ namespace i2clib {
          */
         Measurement read(int temperature_osr, int pressure_osr);
 
-        /** Compute the actual temperature from calibration and raw data */
+        /** Start a complete measurement cycle without waiting for it
+         *
+         * This starts the temperature conversion. \c poll starts the pressure
+         * conversion once the temperature is available, and returns the
+         * measurement once the pressure is available.
+         *
+         * @param temperature_osr oversampling parameter, see
+         *   \c readRawTemperature for more details
+         * @param pressure_osr oversampling parameter, see
+         *   \c readRawPressure for more details
+         */
+        void startAcquisition(int temperature_osr, int pressure_osr);
+
+        /** Start a temperature conversion without waiting for it
+         *
+         * Use \c conversionReadyAt and \c poll to get the result
+         */
+        void startTemperatureConversion(int osr);
+
+        /** Start a pressure conversion without waiting for it
+         *
+         * Use \c conversionReadyAt and \c poll to get the result. The pressure is
+         * compensated with the last temperature acquired by the driver
+         */
+        void startPressureConversion(int osr);
+
+        /** The state of the conversion started by the start methods */
+        ConversionState getConversionState() const;
+
+        /** The time at which the current conversion will be finished */
+        std::chrono::steady_clock::time_point conversionReadyAt() const;
+
+        /** Advance the conversion cycle
+         *
+         * This never waits. If the current conversion is finished, it reads its
+         * result and starts the next conversion of the cycle, if there is one.
+         *
+         * @param measurement set to the new measurement if the method returns true
+         * @return true if a pressure conversion finished and \c measurement has
+         *   been updated, false otherwise
+         */
+        bool poll(Measurement& measurement);
+
+        /** Read the result of the current conversion and go back to idle
+         *
+         * This is the low-level part of \c poll. Unlike \c poll, it does not
+         * check whether the conversion is finished. The chip returns zero if it
+         * is not
+         */
+        int32_t readConversionResult();
+
+        /** Compute a measurement from raw data, using this chip's calibration
+         *
+         * The measurement timestamps are the ones of the last pressure conversion
+         * read with \c readConversionResult
+         */
+        Measurement compensate(int32_t raw_temperature, int32_t raw_pressure) const;
+
+        /** Time needed by the chip to perform a conversion
+         *
+         * @param osr the oversampling parameter
+         */
+        static std::chrono::nanoseconds conversionDuration(int osr);
+
+        /** Compute the actual temperature from calibration and raw data
+         *
+         * This is the first-order compensation of the MS5837-30BA. Use
+         * \c compensateFixed or \c compensateBatch for the complete one
+         */
         static std::pair<base::Temperature, int64_t> compensateRawTemperature(int32_t raw,
             PROM const& prom);
 
-        /** Compute the actual pressure from calibration and raw data */
+        /** Compute the actual pressure from calibration and raw data
+         *
+         * This is the first-order compensation of the MS5837-30BA. Use
+         * \c compensateFixed or \c compensateBatch for the complete one
+         */
         static base::Pressure compensateRawPressure(int32_t raw,
             int64_t dT,
             PROM const& prom);
 
+        /** First and second order compensation of raw data for a given model
+         *
+         * The model constants are resolved at compile time. This is what
+         * \c compensate uses
+         */
+        template <Models model>
+        static Compensated compensateFixed(std::int32_t raw_temperature,
+            std::int32_t raw_pressure,
+            PROM const& prom);
+
+        /** Compensate a series of raw measurements, e.g. from a log
+         *
+         * The results are the same than \c compensateFixed. The model is
+         * resolved once for the whole series
+         *
+         * @param raw_temperature \c count raw temperatures (D2)
+         * @param raw_pressure \c count raw pressures (D1)
+         * @param temperature \c count temperatures in hundredths of degree
+         *   Celsius
+         * @param pressure \c count pressures in Pascal
+         */
+        static void compensateBatch(Models model,
+            std::size_t count,
+            std::int32_t const* raw_temperature,
+            std::int32_t const* raw_pressure,
+            PROM const& prom,
+            std::int32_t* temperature,
+            std::int32_t* pressure);
+
+        /** Compute the CRC of the PROM data
+         *
+         * The PROM stores it in the 4 most significant bits of C[0]
+         */
+        static uint8_t crc4(std::array<uint16_t, CMD_PROM_READ_COUNT> const& prom);
+
         /** Read calibration data
          *
-         * This is public for debugging and testing purposes. It is called in the
-         * class constructor
+         * All PROM words are read with a single transfer. This is public for
+         * debugging and testing purposes. It is called in the class constructor
+         *
+         * @throw std::runtime_error if the CRC does not match
          */
         PROM readPROM();
 
+        /** The calibration data in use */
+        PROM getPROM() const;
+
         /** Read the raw ADC value for the pressure
          *
          * @param osr the oversampling factor, between 0 and 5 that corresponds to
@@ -101,6 +286,108 @@ namespace i2clib {
          */
         int32_t readRawTemperature(int osr);
     };
+
+    /** Constants of the MS5837-30BA datasheet
+     *
+     * The pressure is computed in tenths of millibar
+     */
+    template <> struct MS5837::ModelTraits<MS5837::MODEL_30BA> {
+        static constexpr int OFF_C2_SHIFT = 16;
+        static constexpr int OFF_DT_SHIFT = 7;
+        static constexpr int SENS_C1_SHIFT = 15;
+        static constexpr int SENS_DT_SHIFT = 8;
+        static constexpr int PRESSURE_SHIFT = 13;
+        static constexpr std::int32_t PASCAL_PER_LSB = 10;
+
+        /** Second order corrections Ti, OFFi and SENSi */
+        static constexpr void secondOrder(std::int64_t dT,
+            std::int64_t temperature,
+            std::int64_t& Ti,
+            std::int64_t& OFFi,
+            std::int64_t& SENSi)
+        {
+            std::int64_t delta = temperature - 2000;
+            if (temperature < 2000) {
+                Ti = (3 * dT * dT) >> 33;
+                OFFi = (3 * delta * delta) >> 1;
+                SENSi = (5 * delta * delta) >> 3;
+                if (temperature < -1500) {
+                    std::int64_t very_low = temperature + 1500;
+                    OFFi += 7 * very_low * very_low;
+                    SENSi += 4 * very_low * very_low;
+                }
+            }
+            else {
+                Ti = (2 * dT * dT) >> 37;
+                OFFi = (delta * delta) >> 4;
+                SENSi = 0;
+            }
+        }
+    };
+
+    /** Constants of the MS5837-02BA datasheet
+     *
+     * The pressure is computed in hundredths of millibar
+     */
+    template <> struct MS5837::ModelTraits<MS5837::MODEL_02BA> {
+        static constexpr int OFF_C2_SHIFT = 17;
+        static constexpr int OFF_DT_SHIFT = 6;
+        static constexpr int SENS_C1_SHIFT = 16;
+        static constexpr int SENS_DT_SHIFT = 7;
+        static constexpr int PRESSURE_SHIFT = 15;
+        static constexpr std::int32_t PASCAL_PER_LSB = 1;
+
+        /** Second order corrections Ti, OFFi and SENSi */
+        static constexpr void secondOrder(std::int64_t dT,
+            std::int64_t temperature,
+            std::int64_t& Ti,
+            std::int64_t& OFFi,
+            std::int64_t& SENSi)
+        {
+            std::int64_t delta = temperature - 2000;
+            if (temperature < 2000) {
+                Ti = (11 * dT * dT) >> 35;
+                OFFi = (31 * delta * delta) >> 3;
+                SENSi = (63 * delta * delta) >> 5;
+            }
+            else {
+                Ti = 0;
+                OFFi = 0;
+                SENSi = 0;
+            }
+        }
+    };
+
+    template <MS5837::Models model>
+    MS5837::Compensated MS5837::compensateFixed(std::int32_t raw_temperature,
+        std::int32_t raw_pressure,
+        PROM const& prom)
+    {
+        using Traits = ModelTraits<model>;
+        auto const& C = prom.C;
+
+        std::int64_t dT = raw_temperature - (static_cast<std::int64_t>(C[5]) << 8);
+        std::int64_t temperature = 2000 + ((dT * C[6]) >> 23);
+        std::int64_t offset = (static_cast<std::int64_t>(C[2]) << Traits::OFF_C2_SHIFT) +
+                              ((C[4] * dT) >> Traits::OFF_DT_SHIFT);
+        std::int64_t sens = (static_cast<std::int64_t>(C[1]) << Traits::SENS_C1_SHIFT) +
+                            ((C[3] * dT) >> Traits::SENS_DT_SHIFT);
+
+        std::int64_t Ti = 0;
+        std::int64_t OFFi = 0;
+        std::int64_t SENSi = 0;
+        Traits::secondOrder(dT, temperature, Ti, OFFi, SENSi);
+        offset -= OFFi;
+        sens -= SENSi;
+
+        std::int64_t pressure =
+            (((raw_pressure * sens) >> 21) - offset) >> Traits::PRESSURE_SHIFT;
+
+        Compensated result;
+        result.temperature = static_cast<std::int32_t>(temperature - Ti);
+        result.pressure = static_cast<std::int32_t>(pressure * Traits::PASCAL_PER_LSB);
+        return result;
+    }
 }
 
 #endif
\ No newline at end of file
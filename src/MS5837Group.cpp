@@ -0,0 +1,79 @@
+#include <i2clib/MS5837Group.hpp>
+
+#include <algorithm>
+#include <thread>
+
+using namespace i2clib;
+using namespace std;
+
+MS5837Group::MS5837Group(int temperature_osr, int pressure_osr)
+    : m_temperature_osr(temperature_osr)
+    , m_pressure_osr(pressure_osr)
+{
+}
+
+void MS5837Group::add(MS5837& sensor)
+{
+    m_sensors.push_back(&sensor);
+    m_raw_temperatures.resize(m_sensors.size());
+    m_raw_pressures.resize(m_sensors.size());
+
+    // Restart from scratch, the new sensor has no conversion in flight
+    m_temperature_in_flight = false;
+}
+
+size_t MS5837Group::size() const
+{
+    return m_sensors.size();
+}
+
+void MS5837Group::waitConversions() const
+{
+    auto ready_at = chrono::steady_clock::time_point::min();
+    for (auto const* sensor : m_sensors) {
+        ready_at = max(ready_at, sensor->conversionReadyAt());
+    }
+    this_thread::sleep_until(ready_at);
+}
+
+void MS5837Group::read(vector<MS5837::Measurement>& measurements)
+{
+    size_t count = m_sensors.size();
+    if (!m_temperature_in_flight) {
+        for (auto* sensor : m_sensors) {
+            sensor->startTemperatureConversion(m_temperature_osr);
+        }
+    }
+
+    // Clear the flag until we restart the conversions, in case of exceptions
+    m_temperature_in_flight = false;
+    waitConversions();
+    for (size_t i = 0; i < count; ++i) {
+        m_raw_temperatures[i] = m_sensors[i]->readConversionResult();
+    }
+    for (auto* sensor : m_sensors) {
+        sensor->startPressureConversion(m_pressure_osr);
+    }
+
+    waitConversions();
+    for (size_t i = 0; i < count; ++i) {
+        m_raw_pressures[i] = m_sensors[i]->readConversionResult();
+    }
+    for (auto* sensor : m_sensors) {
+        sensor->startTemperatureConversion(m_temperature_osr);
+    }
+    m_temperature_in_flight = true;
+
+    measurements.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        measurements[i] =
+            m_sensors[i]->compensate(m_raw_temperatures[i], m_raw_pressures[i]);
+    }
+}
+
+vector<MS5837::Measurement> MS5837Group::read()
+{
+    vector<MS5837::Measurement> measurements;
+    read(measurements);
+    return measurements;
+}
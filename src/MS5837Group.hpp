@@ -0,0 +1,61 @@
+#ifndef I2CLIB_MS5837GROUP_HPP
+#define I2CLIB_MS5837GROUP_HPP
+
+#include <i2clib/MS5837.hpp>
+
+#include <vector>
+
+namespace i2clib {
+    /** Acquisition of several MS5837 in parallel
+     *
+     * \c MS5837::read performs the conversions of a single chip sequentially. This
+     * class instead starts the conversion on all the chips, waits once for the
+     * longest one and then reads all the results back-to-back. The acquisition time
+     * of N chips is therefore close to the one of a single chip.
+     *
+     * Moreover, the temperature conversion of the next acquisition is started
+     * right after the pressure has been read, before the compensation. It runs in
+     * the background until the next call to \c read.
+     *
+     * The chips can be on different buses. The group does not own them, and they
+     * must not be used directly while the group is in use.
+     */
+    class MS5837Group {
+        std::vector<MS5837*> m_sensors;
+        std::vector<int32_t> m_raw_temperatures;
+        std::vector<int32_t> m_raw_pressures;
+
+        int m_temperature_osr;
+        int m_pressure_osr;
+        bool m_temperature_in_flight = false;
+
+        void waitConversions() const;
+
+    public:
+        /**
+         * @param temperature_osr oversampling parameter, see
+         *   \c MS5837::readRawTemperature for more details
+         * @param pressure_osr oversampling parameter, see
+         *   \c MS5837::readRawPressure for more details
+         */
+        MS5837Group(int temperature_osr, int pressure_osr);
+
+        /** Add a chip to the group */
+        void add(MS5837& sensor);
+
+        /** How many chips are in the group */
+        size_t size() const;
+
+        /** Perform a measurement on all chips
+         *
+         * @param measurements the measurements, in the order in which the chips
+         *   were added. It is resized to the size of the group
+         */
+        void read(std::vector<MS5837::Measurement>& measurements);
+
+        /** @overload */
+        std::vector<MS5837::Measurement> read();
+    };
+}
+
+#endif
@@ -1,5 +1,8 @@
+#include <i2clib/I2CBus.hpp>
 #include <i2clib/MS5837.hpp>
 
+#include "StreamCommand.hpp"
+
 #include <iostream>
 
 using namespace i2clib;
@@ -16,6 +19,10 @@ void usage(string const& cmd, ostream& io)
        << "  prom: read PROM data\n"
        << "  raw: read raw data\n"
        << "  read: read and compute compensated data\n"
+       << "  stream RATE COUNT [OSR] [FORMAT]: acquire COUNT measurements at RATE Hz\n"
+       << "    and write them to stdout, then display a summary on stderr. OSR is\n"
+       << "    the oversampling parameter of both conversions, from 0 (256) to 5\n"
+       << "    (8192), default 2. FORMAT is csv (default) or binary\n"
        << flush;
 }
 
@@ -66,6 +73,25 @@ int main(int argc, char** argv) {
         cout << meas.pressure.toBar() << " Bar, "
              << meas.temperature.getCelsius() << "C" << endl;
     }
+    else if (cmd == "stream") {
+        if (argc < ARGC_MIN + 2 || argc > ARGC_MIN + 4) {
+            cerr << "stream expects RATE COUNT [OSR] [FORMAT]" << endl;
+            return 1;
+        }
+        int osr = argc > ARGC_MIN + 2 ? stoi(argv[ARGC_MIN + 2]) : 2;
+        string format = argc > ARGC_MIN + 3 ? argv[ARGC_MIN + 3] : "csv";
+        auto options = stream::parseOptions(argv[ARGC_MIN], argv[ARGC_MIN + 1], format);
+        if (osr < 0 || osr > 5) {
+            cerr << "invalid OSR " << osr << ", expected 0 (256) to 5 (8192)" << endl;
+            return 1;
+        }
+
+        auto summary = stream::run(options, [&]() {
+            auto meas = chip.read(osr, osr);
+            return stream::Sample{meas.pressure.toPa(), meas.temperature.getCelsius()};
+        }, cout);
+        stream::printSummary(options, summary, cerr);
+    }
     else {
         cerr << "Unknown command '" << cmd << "'" << endl;
         usage(argv[0], cerr);
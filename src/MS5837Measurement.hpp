@@ -7,9 +7,22 @@
 
 namespace i2clib {
     /** Measurement data from the MS5837
+     *
+     * The acquisition window is the one of the pressure conversion. The
+     * temperature used to compensate it is acquired right before.
      */
     struct MS5837Measurement {
+        /** Estimated time at which the sample was taken
+         *
+         * This is the middle of the acquisition window
+         */
         base::Time time;
+        /** Start of the window during which the chip acquired the sample */
+        base::Time acquisition_start;
+        /** End of the window during which the chip acquired the sample */
+        base::Time acquisition_end;
+        /** Duration of the i2c transaction that read the sample from the chip */
+        base::Time transport_latency;
         base::Pressure pressure;
         base::Temperature temperature;
     };
@@ -1,5 +1,7 @@
+#include <i2clib/CalibrationCache.hpp>
 #include <i2clib/PCA9685.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstdlib>
@@ -34,10 +36,36 @@ uint32_t PCA9685::prescaleToPeriod(uint8_t prescale, float freq)
     return std::round((prescale + 1) * denom);
 }
 
-PCA9685::PCA9685(I2CBus& i2c, uint8_t address)
+PCA9685::PCA9685(I2CTransport& i2c, uint8_t address)
     : m_i2c(i2c)
     , m_address(address)
 {
+    // Worst case is one write message every REGISTER_WRITE_OVERHEAD + 1 registers
+    m_batch.reserve(PWM_REGISTER_COUNT / (REGISTER_WRITE_OVERHEAD + 1) + 1);
+}
+
+PCA9685::PCA9685(I2CTransport& i2c,
+    uint8_t address,
+    CalibrationCache const& cache,
+    string const& bus_path)
+    : PCA9685(i2c, address)
+{
+    m_oscillator_frequency = loadOscillatorFrequency(cache, bus_path, address);
+}
+
+float PCA9685::loadOscillatorFrequency(CalibrationCache const& cache,
+    string const& bus_path,
+    uint8_t address)
+{
+    vector<uint8_t> entry;
+    if (!cache.get(CalibrationCache::key("pca9685", bus_path, address), entry) ||
+        entry.size() != 4) {
+        return INTERNAL_OSCILLATOR_FREQUENCY;
+    }
+
+    uint32_t freq = static_cast<uint32_t>(entry[0]) << 24 | entry[1] << 16 |
+                    entry[2] << 8 | entry[3];
+    return freq ? freq : INTERNAL_OSCILLATOR_FREQUENCY;
 }
 
 void PCA9685::writeSleepMode()
@@ -66,6 +94,35 @@ void PCA9685::writeNormalMode()
 void PCA9685::stop()
 {
     m_i2c.write(m_address, {REGISTER_ALL_LED_OFF_H, PWM_FULL_OFF});
+    setAllLEDRegisters(REGISTER_ALL_LED_OFF_H - REGISTER_ALL_LED_ON_L, &PWM_FULL_OFF, 1);
+}
+
+void PCA9685::setAllLEDRegisters(int offset, uint8_t const* values, size_t size)
+{
+    // The ALL_LED registers write the corresponding register of all PWMs
+    for (int i = 0; i < PWM_COUNT; ++i) {
+        for (size_t j = 0; j < size; ++j) {
+            int reg = i * REGISTER_COUNT_PER_PWM + offset + j;
+            m_pwm_registers[reg] = values[j];
+            m_pwm_registers_known |= 1ULL << reg;
+        }
+    }
+}
+
+void PCA9685::writeOutputChange(OutputChange mode)
+{
+    if (mode == OUTPUT_CHANGE_ON_ACK) {
+        m_mode2 |= MODE2_OCH_ACK;
+    }
+    else {
+        m_mode2 &= ~MODE2_OCH_ACK;
+    }
+    writeMode2();
+}
+
+PCA9685::OutputChange PCA9685::getOutputChange() const
+{
+    return (m_mode2 & MODE2_OCH_ACK) ? OUTPUT_CHANGE_ON_ACK : OUTPUT_CHANGE_ON_STOP;
 }
 
 void PCA9685::writeMode1(uint8_t value)
@@ -84,15 +141,20 @@ void PCA9685::writeMode2()
 }
 
 void PCA9685::pwmConfigurationToRegisters(uint8_t* registers,
-    PWMConfiguration const& configuration)
+    PWMConfiguration const& configuration,
+    uint16_t phase)
 {
     switch (configuration.mode) {
         case PWMConfiguration::MODE_ON:
+            registers[0] = 0;
             registers[1] = PWM_FULL_ON;
+            registers[2] = 0;
             registers[3] = 0;
             return;
         case PWMConfiguration::MODE_OFF: {
+            registers[0] = 0;
             registers[1] = 0;
+            registers[2] = 0;
             registers[3] = PWM_FULL_OFF;
             return;
         }
@@ -105,71 +167,358 @@ void PCA9685::pwmConfigurationToRegisters(uint8_t* registers,
                 throw invalid_argument(
                     "invalid value for off_edge: " + to_string(configuration.off_edge));
             }
-            registers[0] = configuration.on_edge & 0xFF;
-            registers[1] = configuration.on_edge >> 8;
-            registers[2] = configuration.off_edge & 0xFF;
-            registers[3] = configuration.off_edge >> 8;
+            if (phase >= 4096) {
+                throw invalid_argument("invalid value for phase: " + to_string(phase));
+            }
+            uint16_t on_edge = (configuration.on_edge + phase) & 0xFFF;
+            uint16_t off_edge = (configuration.off_edge + phase) & 0xFFF;
+            registers[0] = on_edge & 0xFF;
+            registers[1] = on_edge >> 8;
+            registers[2] = off_edge & 0xFF;
+            registers[3] = off_edge >> 8;
             return;
         }
     }
 }
 
-void PCA9685::writePWMConfigurations(int pwm,
+void PCA9685::validatePWMRange(int pwm, size_t size)
+{
+    if (pwm < 0 || size > PWM_COUNT || pwm + size > PWM_COUNT) {
+        throw invalid_argument("invalid PWM range " + to_string(pwm) + " to " +
+                               to_string(pwm + size - 1));
+    }
+}
+
+void PCA9685::stagePWMConfigurations(int pwm,
     PWMConfiguration const* configurations,
     size_t size)
 {
-    uint8_t registers[PWM_COUNT * REGISTER_COUNT_PER_PWM + 1];
-    registers[0] = REGISTER_PWM_BEGIN + pwm * REGISTER_COUNT_PER_PWM;
+    validatePWMRange(pwm, size);
 
-    uint8_t* pwm_register = registers + 1;
+    // Encode everything first, so that an invalid configuration leaves the
+    // staged registers untouched
+    uint8_t registers[PWM_REGISTER_COUNT];
+    size_t count = size * REGISTER_COUNT_PER_PWM;
     for (size_t i = 0; i < size; ++i) {
-        pwmConfigurationToRegisters(pwm_register, configurations[i]);
-        pwm_register += REGISTER_COUNT_PER_PWM;
+        pwmConfigurationToRegisters(registers + i * REGISTER_COUNT_PER_PWM,
+            configurations[i],
+            getPhase(pwm + i));
+    }
+
+    size_t begin = pwm * REGISTER_COUNT_PER_PWM;
+    copy(registers, registers + count, m_staged_registers.begin() + begin);
+    for (size_t i = begin; i < begin + count; ++i) {
+        m_staged_registers_mask |= 1ULL << i;
     }
+}
+
+bool PCA9685::hasStagedPWMConfigurations() const
+{
+    return m_staged_registers_mask != 0;
+}
+
+void PCA9685::clearStagedPWMConfigurations()
+{
+    m_staged_registers_mask = 0;
+}
+
+void PCA9685::appendStagedWrites(I2CTransactionBatch& batch, bool single_write)
+{
+    uint64_t staged = m_staged_registers_mask;
+    m_staged_bytes_saved = 0;
+    if (!staged) {
+        return;
+    }
+
+    uint64_t dirty = 0;
+    for (size_t reg = 0; reg < PWM_REGISTER_COUNT; ++reg) {
+        if (m_pwm_registers[reg] != m_staged_registers[reg]) {
+            dirty |= 1ULL << reg;
+        }
+    }
+    dirty = (dirty | ~m_pwm_registers_known) & staged;
+    if (m_mode2 & MODE2_OCH_ACK) {
+        // In this mode, the chip only updates an output once all four of its
+        // registers have been written
+        for (int pwm = 0; pwm < PWM_COUNT; ++pwm) {
+            uint64_t pwm_mask = 0xFULL << (pwm * REGISTER_COUNT_PER_PWM);
+            if (dirty & pwm_mask) {
+                dirty |= pwm_mask;
+            }
+        }
+    }
+
+    auto isStaged = [&](size_t reg) { return staged & (1ULL << reg); };
+    auto isKnown = [&](size_t reg) { return m_pwm_registers_known & (1ULL << reg); };
+    auto isDirty = [&](size_t reg) { return dirty & (1ULL << reg); };
+    // Registers between two dirty ones can be written as part of a run if we
+    // know which value to write
+    auto value = [&](size_t reg) {
+        return isStaged(reg) ? m_staged_registers[reg] : m_pwm_registers[reg];
+    };
+
+    size_t begin = 0;
+    while (!isStaged(begin)) {
+        ++begin;
+    }
+    size_t end = PWM_REGISTER_COUNT;
+    while (!isStaged(end - 1)) {
+        --end;
+    }
+
+    // Build the runs of registers that need to be written, merging runs separated
+    // by small gaps
+    uint8_t* write_buffer = m_write_buffer.data();
+    size_t transmitted = 0;
+    size_t reg = begin;
+    while (reg < end) {
+        if (!isDirty(reg)) {
+            ++reg;
+            continue;
+        }
+
+        size_t run_begin = reg;
+        size_t run_end = reg + 1;
+        for (size_t i = run_end; i < end; ++i) {
+            if (!isStaged(i) && !isKnown(i)) {
+                break;
+            }
+            else if (isDirty(i)) {
+                if (single_write || i - run_end <= REGISTER_WRITE_OVERHEAD) {
+                    run_end = i + 1;
+                }
+                else {
+                    break;
+                }
+            }
+        }
+
+        size_t run_size = run_end - run_begin;
+        write_buffer[0] = REGISTER_PWM_BEGIN + run_begin;
+        for (size_t i = 0; i < run_size; ++i) {
+            write_buffer[i + 1] = value(run_begin + i);
+        }
+        batch.write(m_address, write_buffer, run_size + 1);
+        write_buffer += run_size + 1;
+        transmitted += run_size + REGISTER_WRITE_OVERHEAD;
+        reg = run_end;
+    }
+
+    m_staged_bytes_saved = end - begin + REGISTER_WRITE_OVERHEAD - transmitted;
+}
+
+void PCA9685::completeStagedWrites(bool success)
+{
+    uint64_t staged = m_staged_registers_mask;
+    m_staged_registers_mask = 0;
+    if (!success) {
+        // We don't know which registers were actually written
+        m_pwm_registers_known &= ~staged;
+        return;
+    }
+
+    for (size_t i = 0; i < PWM_REGISTER_COUNT; ++i) {
+        if (staged & (1ULL << i)) {
+            m_pwm_registers[i] = m_staged_registers[i];
+        }
+    }
+    m_pwm_registers_known |= staged;
+    m_bytes_saved += m_staged_bytes_saved;
+}
+
+void PCA9685::commit()
+{
+    m_batch.clear();
+    appendStagedWrites(m_batch);
+    if (m_batch.empty()) {
+        completeStagedWrites(true);
+        return;
+    }
+
+    try {
+        m_i2c.transfer(m_batch);
+    }
+    catch (...) {
+        completeStagedWrites(false);
+        throw;
+    }
+    completeStagedWrites(true);
+}
+
+void PCA9685::writePWMConfigurations(int pwm,
+    PWMConfiguration const* configurations,
+    size_t size)
+{
+    stagePWMConfigurations(pwm, configurations, size);
+    commit();
+}
 
-    m_i2c.write(m_address, registers, 1 + REGISTER_COUNT_PER_PWM * size);
+void PCA9685::writePWMConfigurations(
+    array<PWMConfiguration, PWM_COUNT> const& configurations)
+{
+    writePWMConfigurations(0, configurations.data(), configurations.size());
 }
 
 void PCA9685::writePWMConfigurations(int pwm,
     vector<PWMConfiguration> const& configurations)
 {
-    return writePWMConfigurations(pwm, configurations.data(), configurations.size());
+    writePWMConfigurations(pwm, configurations.data(), configurations.size());
+}
+
+void PCA9685::setPhaseMode(PhaseMode mode)
+{
+    m_phase_mode = mode;
+}
+
+PCA9685::PhaseMode PCA9685::getPhaseMode() const
+{
+    return m_phase_mode;
+}
+
+uint16_t PCA9685::getPhase(int pwm) const
+{
+    return m_phase_mode == PHASE_STAGGERED ? pwm * STAGGER_PHASE_STEP : 0;
+}
+
+void PCA9685::invalidateRegisterCache()
+{
+    m_pwm_registers_known = 0;
+}
+
+uint64_t PCA9685::getBytesSaved() const
+{
+    return m_bytes_saved;
 }
 
 void PCA9685::writePrescale(uint8_t prescale)
 {
     m_i2c.write(m_address, {REGISTER_PRESCALE, prescale});
+    updatePrescaleCache(prescale);
+}
+
+void PCA9685::updatePrescaleCache(uint8_t prescale)
+{
+    // The chip ignores the write when it is not sleeping. Read the prescale
+    // back the next time it is needed
+    m_prescale = prescale;
+    m_prescale_known = m_mode1 & MODE1_SLEEP;
+}
+
+uint32_t PCA9685::writePWMPeriod(uint32_t ns)
+{
+    uint8_t prescale = periodToPrescale(ns, m_oscillator_frequency);
+    writePrescale(prescale);
+    return prescaleToPeriod(prescale, m_oscillator_frequency);
+}
+
+uint32_t PCA9685::readPWMPeriod()
+{
+    return readPWMPeriod(m_oscillator_frequency);
 }
 
 uint32_t PCA9685::readPWMPeriod(float freq)
 {
-    uint8_t prescale = m_i2c.read<1>(m_address, REGISTER_PRESCALE).at(0);
-    return prescaleToPeriod(prescale, freq);
+    return prescaleToPeriod(readPrescale(), freq);
 }
 
-void PCA9685::writeDutyTimes(int pwm, vector<uint32_t> const& times, uint32_t period)
+uint8_t PCA9685::readPrescale()
 {
-    // Get the duration of a single PWM step (one of 4096)
-    uint32_t quanta = period / 4096.0;
+    m_prescale = m_i2c.read<1>(m_address, REGISTER_PRESCALE).at(0);
+    m_prescale_known = true;
+    return m_prescale;
+}
 
-    PWMConfiguration configurations[PWM_COUNT];
-    for (size_t i = 0; i < times.size(); ++i) {
-        auto& c{configurations[i]};
-        int32_t off_edge = times[i] / quanta - 1;
-        c = PWMConfiguration::fromUnnormalizedOffEdge(off_edge);
+uint32_t PCA9685::getPWMPeriod()
+{
+    if (!m_prescale_known) {
+        return readPWMPeriod();
     }
+    return prescaleToPeriod(m_prescale, m_oscillator_frequency);
+}
 
-    writePWMConfigurations(pwm, configurations, times.size());
+float PCA9685::measuredOscillatorFrequency(uint8_t prescale, uint32_t measured_period)
+{
+    if (measured_period == 0) {
+        throw invalid_argument("the measured PWM period must be strictly positive");
+    }
+    return 4096.0 * (prescale + 1) * 1e9 / measured_period;
 }
 
-void PCA9685::writeDutyRatios(int pwm, vector<float> const& ratios)
+void PCA9685::setOscillatorFrequency(float freq)
 {
+    if (!(freq > 0) || isinf(freq)) {
+        throw invalid_argument("invalid oscillator frequency " + to_string(freq));
+    }
+    m_oscillator_frequency = freq;
+}
+
+float PCA9685::getOscillatorFrequency() const
+{
+    return m_oscillator_frequency;
+}
+
+void PCA9685::saveOscillatorFrequency(CalibrationCache& cache,
+    string const& bus_path) const
+{
+    // Stored in Hz, as a 32 bit big endian integer
+    uint32_t freq = lround(m_oscillator_frequency);
+    cache.set(CalibrationCache::key("pca9685", bus_path, m_address),
+        {static_cast<uint8_t>(freq >> 24),
+            static_cast<uint8_t>(freq >> 16),
+            static_cast<uint8_t>(freq >> 8),
+            static_cast<uint8_t>(freq)});
+}
+
+void PCA9685::writeDutyTimes(int pwm,
+    uint32_t const* times,
+    size_t size,
+    uint32_t period)
+{
+    validatePWMRange(pwm, size);
+
+    if (m_duty_conversion.getPeriod() != period) {
+        m_duty_conversion = PCA9685DutyConversion(period);
+    }
+
     PWMConfiguration configurations[PWM_COUNT];
-    for (size_t i = 0; i < ratios.size(); ++i) {
-        auto& c{configurations[i]};
-        int32_t off_edge = round(ratios[i] * 4096) - 1;
-        c = PWMConfiguration::fromUnnormalizedOffEdge(off_edge);
+    m_duty_conversion.fromDurations(times, size, configurations);
+
+    writePWMConfigurations(pwm, configurations, size);
+}
+
+void PCA9685::writeDutyTimes(int pwm, uint32_t const* times, size_t size)
+{
+    writeDutyTimes(pwm, times, size, getPWMPeriod());
+}
+
+void PCA9685::writeDutyTimes(array<uint32_t, PWM_COUNT> const& times, uint32_t period)
+{
+    writeDutyTimes(0, times.data(), times.size(), period);
+}
+
+void PCA9685::writeDutyTimes(int pwm, vector<uint32_t> const& times, uint32_t period)
+{
+    writeDutyTimes(pwm, times.data(), times.size(), period);
+}
+
+void PCA9685::writeDutyRatios(int pwm, float const* ratios, size_t size)
+{
+    validatePWMRange(pwm, size);
+
+    PWMConfiguration configurations[PWM_COUNT];
+    for (size_t i = 0; i < size; ++i) {
+        configurations[i] = PWMConfiguration::fromDutyRatio(ratios[i]);
     }
 
-    writePWMConfigurations(pwm, configurations, ratios.size());
+    writePWMConfigurations(pwm, configurations, size);
+}
+
+void PCA9685::writeDutyRatios(array<float, PWM_COUNT> const& ratios)
+{
+    writeDutyRatios(0, ratios.data(), ratios.size());
+}
+
+void PCA9685::writeDutyRatios(int pwm, vector<float> const& ratios)
+{
+    writeDutyRatios(pwm, ratios.data(), ratios.size());
 }
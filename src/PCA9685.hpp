@@ -1,14 +1,19 @@
 #ifndef I2CLIB_PCA9685_HPP
 #define I2CLIB_PCA9685_HPP
 
-#include <i2clib/I2CBus.hpp>
+#include <i2clib/I2CTransport.hpp>
+#include <i2clib/PCA9685DutyConversion.hpp>
 #include <i2clib/PCA9685PWMConfiguration.hpp>
 
+#include <array>
 #include <cstdint>
 #include <functional>
+#include <string>
 #include <vector>
 
 namespace i2clib {
+    class CalibrationCache;
+
     /** 16 channels, 12 bits PWM generator
      *
      * This drivers is an opinionated implementation of the chip's functions. It relies
@@ -19,6 +24,12 @@ namespace i2clib {
      * it is global, that is common to all PWM outputs. See \c writePrescale for
      * a complete discussion.
      *
+     * The frequency of the internal oscillator varies by a few percent between
+     * chips. It can be measured and given to the driver with
+     * \c setOscillatorFrequency, and persisted in a \c CalibrationCache. The
+     * conversions between durations and prescale parameter or ticks then use
+     * it.
+     *
      * We recomment calling \c stop before \c writeSleep. Some devices are known to
      * misbehave if the PWM is non-zero when the PWM generators are active.
      */
@@ -26,6 +37,34 @@ namespace i2clib {
     public:
         using PWMConfiguration = PCA9685PWMConfiguration;
 
+        /** How many PWMs this chip handles */
+        static constexpr uint8_t PWM_COUNT = 16;
+
+        /** How the on edges of the PWMs are placed in the PWM cycle */
+        enum PhaseMode {
+            /** The configured edges are written as-is. With the duty cycle
+             * methods, all PWMs switch on at the start of the cycle */
+            PHASE_ALIGNED,
+            /** The edges of each PWM are offset by \c STAGGER_PHASE_STEP
+             * times its index, spreading the switching over the cycle. The
+             * duty cycles are unchanged */
+            PHASE_STAGGERED
+        };
+
+        /** When written PWM configurations take effect (OCH bit of MODE2) */
+        enum OutputChange {
+            /** The outputs change at the STOP condition that ends the
+             * transfer. All writes of a single transfer, to one or several
+             * chips, take effect at the same time */
+            OUTPUT_CHANGE_ON_STOP,
+            /** Each output changes as soon as its four registers are written,
+             * without waiting for the end of the transfer */
+            OUTPUT_CHANGE_ON_ACK
+        };
+
+        /** Offset between the edges of successive PWMs in PHASE_STAGGERED */
+        static constexpr uint16_t STAGGER_PHASE_STEP = 4096 / PWM_COUNT;
+
     private:
         static constexpr uint8_t MODE1_ALLCALL_ENABLED = 1 << 0;
         static constexpr uint8_t MODE1_SLEEP = 1 << 4;
@@ -33,43 +72,106 @@ namespace i2clib {
         static constexpr uint8_t MODE1_EXTERNAL_CLOCK = 1 << 6;
         static constexpr uint8_t MODE1_RESTART = 1 << 7;
         static constexpr uint8_t MODE2_OUTDRV_TOTEM = 1 << 2;
+        static constexpr uint8_t MODE2_OCH_ACK = 1 << 3;
         static constexpr uint8_t PWM_FULL_ON = 1 << 4;
         static constexpr uint8_t PWM_FULL_OFF = 1 << 4;
 
         /** How many registers there are per PWM */
         static constexpr uint8_t REGISTER_COUNT_PER_PWM = 4;
-        /** How many PWMs this chip handles */
-        static constexpr uint8_t PWM_COUNT = 16;
+        /** How many PWM control registers there are */
+        static constexpr uint8_t PWM_REGISTER_COUNT = PWM_COUNT * REGISTER_COUNT_PER_PWM;
+        /** Bytes needed on top of the register values to write a run of registers
+         *
+         * This is the device address and the start register. Runs separated by gaps
+         * of that size or less are merged, as writing the gap costs as much as or
+         * less than a separate write
+         */
+        static constexpr uint8_t REGISTER_WRITE_OVERHEAD = 2;
 
         static constexpr uint8_t REGISTER_MODE1 = 0x00;
         static constexpr uint8_t REGISTER_MODE2 = 0x01;
+        static constexpr uint8_t REGISTER_ALLCALLADR = 0x05;
         /** Address of the very first PWM control register */
         static constexpr uint8_t REGISTER_PWM_BEGIN = 0x06;
+        static constexpr uint8_t REGISTER_ALL_LED_ON_L = 0xFA;
         static constexpr uint8_t REGISTER_ALL_LED_OFF_H = 0xFD;
         static constexpr uint8_t REGISTER_PRESCALE = 0xFE;
 
-        I2CBus& m_i2c;
+        I2CTransport& m_i2c;
 
         std::uint8_t m_address = 0;
         uint8_t m_mode1 =
             MODE1_SLEEP | MODE1_ALLCALL_ENABLED | MODE1_AUTO_INCREMENT_ENABLED;
         uint8_t m_mode2 = MODE2_OUTDRV_TOTEM;
+        PhaseMode m_phase_mode = PHASE_ALIGNED;
+        float m_oscillator_frequency = INTERNAL_OSCILLATOR_FREQUENCY;
+        /** Prescale parameter of the chip, valid if m_prescale_known is set */
+        uint8_t m_prescale = 0;
+        bool m_prescale_known = false;
+
+        /** Last values written to the PWM control registers */
+        std::array<uint8_t, PWM_REGISTER_COUNT> m_pwm_registers{};
+        /** Bitmask of the PWM control registers whose value is known */
+        uint64_t m_pwm_registers_known = 0;
+        /** How many bytes were not transmitted thanks to the register cache */
+        uint64_t m_bytes_saved = 0;
+
+        /** Values of the PWM control registers that are staged for writing */
+        std::array<uint8_t, PWM_REGISTER_COUNT> m_staged_registers{};
+        /** Bitmask of the staged PWM control registers */
+        uint64_t m_staged_registers_mask = 0;
+        /** Bytes saved by the writes of the last \c appendStagedWrites */
+        uint64_t m_staged_bytes_saved = 0;
+
+        /** Buffer for the register writes of a single update */
+        std::array<uint8_t, 2 * PWM_REGISTER_COUNT> m_write_buffer;
+        I2CTransactionBatch m_batch;
+
+        /** Conversion of the last period given to \c writeDutyTimes. The
+         * initial period is arbitrary */
+        PCA9685DutyConversion m_duty_conversion{prescaleToPeriod(30)};
 
         void writeMode1();
         void writeMode1(uint8_t value);
         void writeMode2();
 
-        void pwmConfigurationToRegisters(uint8_t* registers,
-            PWMConfiguration const& configuration);
+        /** The PWM period from the known prescale, read if it is not known */
+        uint32_t getPWMPeriod();
 
-        /** @overload internal non-allocating version of writePWMConfigurations */
-        void writePWMConfigurations(int pwm,
-            PWMConfiguration const* configurations,
-            size_t size);
+        /** Update the cached prescale after a write of the PRESCALE register
+         *
+         * The write only takes effect in sleep mode. Otherwise, the cache is
+         * invalidated
+         */
+        void updatePrescaleCache(uint8_t prescale);
+
+        /** Validate that the given PWM range is within the chip's */
+        static void validatePWMRange(int pwm, size_t size);
+
+        /** Update the register cache after a write to the ALL_LED registers
+         *
+         * @param offset offset of the first register written from ALL_LED_ON_L
+         */
+        void setAllLEDRegisters(int offset, uint8_t const* values, size_t size);
+
+        friend class PCA9685Array;
 
     public:
         static constexpr float INTERNAL_OSCILLATOR_FREQUENCY = 25e6;
 
+        /** Encode a PWM configuration into the values of its four control
+         * registers (ON_L, ON_H, OFF_L, OFF_H)
+         *
+         * @param phase offset added to both edges, modulo the 4096 ticks of the
+         *   cycle. An off edge that wraps around ends up before the on edge,
+         *   which the chip handles as a pulse spanning the end of the cycle
+         * @throw std::invalid_argument if the edges or the phase are out of
+         *   range
+         */
+        static void pwmConfigurationToRegisters(uint8_t* registers,
+            PWMConfiguration const& configuration,
+            uint16_t phase = 0);
+
         /** Compute the PWM period from the chip's prescale parameter
          *
          * See \c writePrescale's documentation for a discussion on the prescale
@@ -92,7 +194,55 @@ namespace i2clib {
          *
          * See the class documentation for the initialization
          */
-        PCA9685(I2CBus& i2c_bus, uint8_t address);
+        PCA9685(I2CTransport& i2c_bus, uint8_t address);
+
+        /** Create the driver, with the oscillator frequency stored in a
+         * calibration cache if there is one
+         *
+         * @param bus_path path of the bus, used to identify the chip in the
+         *   cache (see \c I2CBus::getPath)
+         * @see saveOscillatorFrequency
+         */
+        PCA9685(I2CTransport& i2c_bus,
+            uint8_t address,
+            CalibrationCache const& cache,
+            std::string const& bus_path);
+
+        /** Compute the oscillator frequency from a measurement of the PWM
+         * period
+         *
+         * @param prescale the chip's prescale parameter during the measurement
+         * @param measured_period the measured PWM period in nanoseconds, e.g.
+         *   from a capture of one of the outputs
+         */
+        static float measuredOscillatorFrequency(uint8_t prescale,
+            uint32_t measured_period);
+
+        /** Set the frequency of the chip's oscillator
+         *
+         * It is used by \c readPWMPeriod, \c writePWMPeriod and the
+         * \c writeDutyTimes overloads that do not take a period. The default
+         * is the nominal \c INTERNAL_OSCILLATOR_FREQUENCY
+         *
+         * @throw std::invalid_argument if the frequency is not strictly positive
+         */
+        void setOscillatorFrequency(float freq);
+
+        /** The frequency of the chip's oscillator */
+        float getOscillatorFrequency() const;
+
+        /** The oscillator frequency stored in a calibration cache for the
+         * given chip, or \c INTERNAL_OSCILLATOR_FREQUENCY if there is none
+         */
+        static float loadOscillatorFrequency(CalibrationCache const& cache,
+            std::string const& bus_path,
+            uint8_t address);
+
+        /** Store the oscillator frequency in a calibration cache, keyed by
+         * bus path and address
+         */
+        void saveOscillatorFrequency(CalibrationCache& cache,
+            std::string const& bus_path) const;
 
         /** Stop all PWMs (i.e. make them be all off) */
         void stop();
@@ -125,6 +275,20 @@ namespace i2clib {
          */
         void writeNormalMode();
 
+        /** Select when the written PWM configurations take effect
+         *
+         * The default is OUTPUT_CHANGE_ON_STOP, which is what makes the
+         * updates written in a single transfer (\c commit,
+         * \c PCA9685Array::commit) take effect together. With
+         * OUTPUT_CHANGE_ON_ACK, the driver writes all four registers of the
+         * PWMs that change, as the chip waits for them before updating an
+         * output
+         */
+        void writeOutputChange(OutputChange mode);
+
+        /** When written PWM configurations take effect */
+        OutputChange getOutputChange() const;
+
         /** Change the duration of the PWM cycle by writing the prescale parameter
          *
          * The chip needs to be in sleep mode to change this
@@ -145,31 +309,167 @@ namespace i2clib {
          */
         void writePrescale(uint8_t prescale);
 
+        /** Write the prescale parameter closest to the given PWM period,
+         * using the oscillator frequency
+         *
+         * The chip needs to be in sleep mode to change this
+         *
+         * @return the actual PWM period in nanoseconds
+         */
+        uint32_t writePWMPeriod(uint32_t ns);
+
         /** Write the configuration of a contiguous set of PWMs
          *
-         * It configures the PWMs from `pwm` to `pwm + conf.size() - 1`
+         * It configures the PWMs from `pwm` to `pwm + size - 1`
+         *
+         * The driver caches the values written to the PWM registers, and only
+         * writes the registers whose value changed. See \c getBytesSaved. The
+         * configurations staged with \c stagePWMConfigurations are written
+         * along
+         *
+         * This and the other pointer-based and array-based update methods do
+         * not allocate. The vector-based overloads forward to them
          *
          * @param pwm the start PWM (0-based)
-         * @param conf the PWM configurations
+         * @param configurations the PWM configurations
+         * @param size the number of configurations
+         * @throw std::invalid_argument if the PWM range is out of the chip's
          */
+        void writePWMConfigurations(int pwm,
+            PWMConfiguration const* configurations,
+            size_t size);
+
+        /** @overload configures all PWMs */
+        void writePWMConfigurations(
+            std::array<PWMConfiguration, PWM_COUNT> const& configurations);
+
+        /** @overload */
         void writePWMConfigurations(int pwm, std::vector<PWMConfiguration> const& conf);
 
+        /** Stage the configuration of a contiguous set of PWMs, without writing
+         * it
+         *
+         * Staged configurations are written by the next call to \c commit or
+         * \c writePWMConfigurations (or any method based on it), or appended
+         * to an external batch with \c appendStagedWrites. Staging the same
+         * PWM twice keeps the last configuration
+         *
+         * @throw std::invalid_argument if the PWM range is out of the chip's
+         */
+        void stagePWMConfigurations(int pwm,
+            PWMConfiguration const* configurations,
+            size_t size);
+
+        /** Whether some PWM configurations are staged */
+        bool hasStagedPWMConfigurations() const;
+
+        /** Drop the staged configurations without writing them */
+        void clearStagedPWMConfigurations();
+
+        /** Write all staged configurations in a single transfer
+         *
+         * With OUTPUT_CHANGE_ON_STOP, they all take effect at the same time
+         */
+        void commit();
+
+        /** Append the writes of the staged registers that changed to a batch
+         *
+         * This allows to write the updates of several chips in a single
+         * transfer, see \c PCA9685Array. The batch refers to an internal
+         * buffer: it must be transferred before the next update of this
+         * driver, and \c completeStagedWrites called with the outcome
+         *
+         * @param single_write write the changed registers in a single message
+         *   as long as the registers in between are known, instead of only
+         *   merging runs separated by small gaps
+         */
+        void appendStagedWrites(I2CTransactionBatch& batch, bool single_write = false);
+
+        /** Update the register cache with the outcome of the transfer of the
+         * writes appended by \c appendStagedWrites, and clear the staged
+         * configurations
+         */
+        void completeStagedWrites(bool success);
+
         /** Simplified interface to set the duty cycles in nanoseconds
+         *
+         * Each duration is rounded to the closest tick, see
+         * \c PCA9685DutyConversion. The conversion is cached between calls
+         * with the same period
          *
          * @param durations the duty durations in nanoseconds
+         * @param size the number of durations
          * @param period the chip's known PWM period. Use \c readPeriod to
          *   read it from the chip configuration, or if you are explicitly
          *   setting the prescale parameter, use \c prescaleToPeriod
          */
+        void writeDutyTimes(int pwm,
+            uint32_t const* durations,
+            size_t size,
+            uint32_t period);
+
+        /** @overload uses the PWM period from the oscillator frequency and the
+         * last prescale parameter written or read. The prescale parameter is
+         * read from the chip if it is not known yet
+         */
+        void writeDutyTimes(int pwm, uint32_t const* durations, size_t size);
+
+        /** @overload sets the duty cycles of all PWMs */
+        void writeDutyTimes(std::array<uint32_t, PWM_COUNT> const& durations,
+            uint32_t period);
+
+        /** @overload */
         void writeDutyTimes(int pwm,
             std::vector<uint32_t> const& durations,
             uint32_t period);
 
         /** Simplified interface to set the duty cycles in [0, 1] */
+        void writeDutyRatios(int pwm, float const* ratios, size_t size);
+
+        /** @overload sets the duty cycles of all PWMs */
+        void writeDutyRatios(std::array<float, PWM_COUNT> const& ratios);
+
+        /** @overload */
         void writeDutyRatios(int pwm, std::vector<float> const& cycles);
 
-        /** Read the currently configured PWM period in nanoseconds */
-        uint32_t readPWMPeriod(float freq = INTERNAL_OSCILLATOR_FREQUENCY);
+        /** Select how the PWM edges are placed in the cycle
+         *
+         * This applies to the following updates. The default is PHASE_ALIGNED
+         */
+        void setPhaseMode(PhaseMode mode);
+
+        /** How the PWM edges are placed in the cycle */
+        PhaseMode getPhaseMode() const;
+
+        /** Offset applied to the edges of a PWM in the current phase mode */
+        uint16_t getPhase(int pwm) const;
+
+        /** Forget the cached values of the PWM registers
+         *
+         * The next PWM update will write all its registers. Call this if the
+         * chip might have been reconfigured behind the driver's back, e.g. after
+         * a power cycle or a write from another process
+         */
+        void invalidateRegisterCache();
+
+        /** How many bytes the register cache avoided to transmit since the
+         * driver's creation
+         *
+         * This is counted against writing all the registers of every update
+         * in a single transaction
+         */
+        uint64_t getBytesSaved() const;
+
+        /** Read the currently configured PWM period in nanoseconds, using the
+         * oscillator frequency
+         */
+        uint32_t readPWMPeriod();
+
+        /** @overload with an explicit oscillator frequency */
+        uint32_t readPWMPeriod(float freq);
+
+        /** Read the prescale parameter, see \c writePrescale */
+        uint8_t readPrescale();
     };
 }
 
@@ -0,0 +1,332 @@
+#include <i2clib/I2CBus.hpp>
+#include <i2clib/PCA9685Array.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace i2clib;
+using namespace std;
+
+PCA9685Array::PCA9685Array(I2CTransport& i2c,
+    vector<uint8_t> const& addresses,
+    uint8_t allcall_address)
+    : m_i2c(i2c)
+    , m_allcall_address(allcall_address)
+{
+    if (addresses.empty()) {
+        throw invalid_argument("a PCA9685 array needs at least one chip");
+    }
+
+    for (uint8_t address : addresses) {
+        if (address == allcall_address) {
+            throw invalid_argument("chip address " + to_string(address) +
+                                   " is the same as the ALLCALL address");
+        }
+        m_chips.emplace_back(new PCA9685(i2c, address));
+    }
+    // Same worst case than a single chip, for each chip
+    size_t max_writes_per_chip =
+        PCA9685::PWM_REGISTER_COUNT / (PCA9685::REGISTER_WRITE_OVERHEAD + 1) + 1;
+    m_batch.reserve(addresses.size() * max_writes_per_chip);
+}
+
+size_t PCA9685Array::getChipCount() const
+{
+    return m_chips.size();
+}
+
+int PCA9685Array::getPWMCount() const
+{
+    return m_chips.size() * PCA9685::PWM_COUNT;
+}
+
+PCA9685& PCA9685Array::getChip(size_t index)
+{
+    return *m_chips.at(index);
+}
+
+uint8_t PCA9685Array::getAllCallAddress() const
+{
+    return m_allcall_address;
+}
+
+void PCA9685Array::validatePWMRange(int pwm, size_t size) const
+{
+    if (pwm < 0 || size > static_cast<size_t>(getPWMCount() - pwm)) {
+        throw invalid_argument("invalid PWM range " + to_string(pwm) + " to " +
+                               to_string(pwm + size - 1));
+    }
+}
+
+void PCA9685Array::writeAllCallAddress()
+{
+    // The ALLCALLADR register holds the address in its 7 upper bits
+    uint8_t bytes[2] = {PCA9685::REGISTER_ALLCALLADR,
+        static_cast<uint8_t>(m_allcall_address << 1)};
+
+    m_batch.clear();
+    for (auto const& chip : m_chips) {
+        m_batch.write(chip->m_address, bytes, 2);
+    }
+    m_i2c.transfer(m_batch);
+}
+
+void PCA9685Array::stop()
+{
+    m_i2c.write(m_allcall_address,
+        {PCA9685::REGISTER_ALL_LED_OFF_H, PCA9685::PWM_FULL_OFF});
+    for (auto const& chip : m_chips) {
+        chip->setAllLEDRegisters(
+            PCA9685::REGISTER_ALL_LED_OFF_H - PCA9685::REGISTER_ALL_LED_ON_L,
+            &PCA9685::PWM_FULL_OFF,
+            1);
+    }
+}
+
+void PCA9685Array::writeMode(uint8_t reg,
+    uint8_t PCA9685::*mode,
+    uint8_t set,
+    uint8_t clear)
+{
+    bool same = true;
+    for (auto const& chip : m_chips) {
+        (*chip).*mode = ((*chip).*mode | set) & ~clear;
+        same = same && (*chip).*mode == (*m_chips.front()).*mode;
+    }
+
+    if (same) {
+        m_i2c.write(m_allcall_address, {reg, (*m_chips.front()).*mode});
+        return;
+    }
+
+    // Some chips have a different configuration (e.g. external clock), write
+    // each chip's own value
+    vector<uint8_t> bytes;
+    for (auto const& chip : m_chips) {
+        bytes.push_back(reg);
+        bytes.push_back((*chip).*mode);
+    }
+    m_batch.clear();
+    for (size_t i = 0; i < m_chips.size(); ++i) {
+        m_batch.write(m_chips[i]->m_address, bytes.data() + 2 * i, 2);
+    }
+    m_i2c.transfer(m_batch);
+}
+
+void PCA9685Array::writeSleepMode()
+{
+    writeMode(PCA9685::REGISTER_MODE1, &PCA9685::m_mode1, PCA9685::MODE1_SLEEP, 0);
+}
+
+void PCA9685Array::writeNormalMode()
+{
+    writeMode(PCA9685::REGISTER_MODE1, &PCA9685::m_mode1, 0, PCA9685::MODE1_SLEEP);
+}
+
+void PCA9685Array::writeOutputChange(PCA9685::OutputChange mode)
+{
+    bool ack = mode == PCA9685::OUTPUT_CHANGE_ON_ACK;
+    writeMode(PCA9685::REGISTER_MODE2,
+        &PCA9685::m_mode2,
+        ack ? PCA9685::MODE2_OCH_ACK : 0,
+        ack ? 0 : PCA9685::MODE2_OCH_ACK);
+}
+
+void PCA9685Array::writePrescale(uint8_t prescale)
+{
+    m_i2c.write(m_allcall_address, {PCA9685::REGISTER_PRESCALE, prescale});
+    for (auto const& chip : m_chips) {
+        chip->updatePrescaleCache(prescale);
+    }
+}
+
+void PCA9685Array::setPhaseMode(PCA9685::PhaseMode mode)
+{
+    for (auto const& chip : m_chips) {
+        chip->setPhaseMode(mode);
+    }
+}
+
+void PCA9685Array::writeAllPWMConfigurations(PWMConfiguration const& configuration)
+{
+    bool staggered = false;
+    for (auto const& chip : m_chips) {
+        staggered = staggered || chip->getPhaseMode() != PCA9685::PHASE_ALIGNED;
+    }
+
+    if (staggered) {
+        // The ALL_LED registers would write the same edges on all PWMs
+        PWMConfiguration configurations[PCA9685::PWM_COUNT];
+        fill(configurations, configurations + PCA9685::PWM_COUNT, configuration);
+        for (auto const& chip : m_chips) {
+            chip->stagePWMConfigurations(0, configurations, PCA9685::PWM_COUNT);
+        }
+        commit();
+        return;
+    }
+
+    uint8_t bytes[1 + PCA9685::REGISTER_COUNT_PER_PWM];
+    bytes[0] = PCA9685::REGISTER_ALL_LED_ON_L;
+    PCA9685::pwmConfigurationToRegisters(bytes + 1, configuration);
+    m_i2c.write(m_allcall_address, bytes, sizeof(bytes));
+    for (auto const& chip : m_chips) {
+        chip->setAllLEDRegisters(0, bytes + 1, PCA9685::REGISTER_COUNT_PER_PWM);
+    }
+}
+
+void PCA9685Array::writeAllDutyRatios(float ratio)
+{
+    writeAllPWMConfigurations(PWMConfiguration::fromDutyRatio(ratio));
+}
+
+void PCA9685Array::stage(int pwm,
+    PWMConfiguration const* configurations,
+    size_t size)
+{
+    size_t offset = 0;
+    while (offset < size) {
+        int chip = (pwm + offset) / PCA9685::PWM_COUNT;
+        int chip_pwm = (pwm + offset) % PCA9685::PWM_COUNT;
+        size_t count = min<size_t>(size - offset, PCA9685::PWM_COUNT - chip_pwm);
+        m_chips[chip]->stagePWMConfigurations(chip_pwm, configurations + offset, count);
+        offset += count;
+    }
+}
+
+void PCA9685Array::stagePWMConfigurations(int pwm,
+    PWMConfiguration const* configurations,
+    size_t size)
+{
+    validatePWMRange(pwm, size);
+
+    try {
+        stage(pwm, configurations, size);
+    }
+    catch (...) {
+        clearStagedPWMConfigurations();
+        throw;
+    }
+}
+
+void PCA9685Array::stageDutyTimes(int pwm,
+    uint32_t const* durations,
+    size_t size,
+    uint32_t period)
+{
+    validatePWMRange(pwm, size);
+
+    if (m_duty_conversion.getPeriod() != period) {
+        m_duty_conversion = PCA9685DutyConversion(period);
+    }
+
+    // Convert one chip's worth of PWMs at a time to avoid allocating
+    PWMConfiguration configurations[PCA9685::PWM_COUNT];
+    for (size_t offset = 0; offset < size; offset += PCA9685::PWM_COUNT) {
+        size_t count = min<size_t>(size - offset, PCA9685::PWM_COUNT);
+        m_duty_conversion.fromDurations(durations + offset, count, configurations);
+        stage(pwm + offset, configurations, count);
+    }
+}
+
+void PCA9685Array::stageDutyRatios(int pwm, float const* ratios, size_t size)
+{
+    validatePWMRange(pwm, size);
+
+    PWMConfiguration configurations[PCA9685::PWM_COUNT];
+    for (size_t offset = 0; offset < size; offset += PCA9685::PWM_COUNT) {
+        size_t count = min<size_t>(size - offset, PCA9685::PWM_COUNT);
+        for (size_t i = 0; i < count; ++i) {
+            configurations[i] = PWMConfiguration::fromDutyRatio(ratios[offset + i]);
+        }
+        stage(pwm + offset, configurations, count);
+    }
+}
+
+bool PCA9685Array::hasStagedPWMConfigurations() const
+{
+    for (auto const& chip : m_chips) {
+        if (chip->hasStagedPWMConfigurations()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PCA9685Array::clearStagedPWMConfigurations()
+{
+    for (auto const& chip : m_chips) {
+        chip->clearStagedPWMConfigurations();
+    }
+}
+
+void PCA9685Array::commit()
+{
+    m_batch.clear();
+    for (auto const& chip : m_chips) {
+        chip->appendStagedWrites(m_batch);
+    }
+    if (m_batch.messages().size() > I2CBus::MAX_MESSAGES_PER_TRANSFER) {
+        m_batch.clear();
+        for (auto const& chip : m_chips) {
+            chip->appendStagedWrites(m_batch, true);
+        }
+    }
+
+    try {
+        if (!m_batch.empty()) {
+            m_i2c.transfer(m_batch);
+        }
+    }
+    catch (...) {
+        for (auto const& chip : m_chips) {
+            chip->completeStagedWrites(false);
+        }
+        throw;
+    }
+
+    for (auto const& chip : m_chips) {
+        chip->completeStagedWrites(true);
+    }
+}
+
+void PCA9685Array::writePWMConfigurations(int pwm,
+    PWMConfiguration const* configurations,
+    size_t size)
+{
+    stagePWMConfigurations(pwm, configurations, size);
+    commit();
+}
+
+void PCA9685Array::writePWMConfigurations(int pwm,
+    vector<PWMConfiguration> const& configurations)
+{
+    writePWMConfigurations(pwm, configurations.data(), configurations.size());
+}
+
+void PCA9685Array::writeDutyTimes(int pwm,
+    uint32_t const* durations,
+    size_t size,
+    uint32_t period)
+{
+    stageDutyTimes(pwm, durations, size, period);
+    commit();
+}
+
+void PCA9685Array::writeDutyTimes(int pwm,
+    vector<uint32_t> const& durations,
+    uint32_t period)
+{
+    writeDutyTimes(pwm, durations.data(), durations.size(), period);
+}
+
+void PCA9685Array::writeDutyRatios(int pwm, float const* ratios, size_t size)
+{
+    stageDutyRatios(pwm, ratios, size);
+    commit();
+}
+
+void PCA9685Array::writeDutyRatios(int pwm, vector<float> const& ratios)
+{
+    writeDutyRatios(pwm, ratios.data(), ratios.size());
+}
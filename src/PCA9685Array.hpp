@@ -0,0 +1,189 @@
+#ifndef I2CLIB_PCA9685ARRAY_HPP
+#define I2CLIB_PCA9685ARRAY_HPP
+
+#include <i2clib/PCA9685.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace i2clib {
+    /** Several PCA9685 on the same bus, handled as a single set of PWMs
+     *
+     * The PWMs of the chips are numbered consecutively, in the order in which
+     * the chip addresses are given: PWM 16 is the first PWM of the second
+     * chip.
+     *
+     * Commands that are the same for all chips (stop, sleep, prescale, same
+     * configuration on all PWMs) are written once to the ALLCALL address,
+     * which all chips answer to. The chips must have their ALLCALL function
+     * enabled (the driver's default), and answer the array's ALLCALL address,
+     * see \c writeAllCallAddress.
+     *
+     * Updates that span several chips are written in a single transfer, with
+     * the writes of the chips back-to-back, to minimize the delay between the
+     * updates of the different chips.
+     *
+     * Updates can also be staged with the stage methods, and written together
+     * with \c commit. As the chips change their outputs at the STOP condition
+     * by default (see \c writeOutputChange), and a single transfer has a
+     * single STOP, all the PWMs of a commit take effect at the same time.
+     */
+    class PCA9685Array {
+    public:
+        using PWMConfiguration = PCA9685PWMConfiguration;
+
+        /** The power-on ALLCALL address of the PCA9685 */
+        static constexpr uint8_t DEFAULT_ALLCALL_ADDRESS = 0x70;
+
+    private:
+        I2CTransport& m_i2c;
+        uint8_t m_allcall_address;
+        std::vector<std::unique_ptr<PCA9685>> m_chips;
+        I2CTransactionBatch m_batch;
+
+        /** Conversion of the last period given to \c writeDutyTimes */
+        PCA9685DutyConversion m_duty_conversion{PCA9685::prescaleToPeriod(30)};
+
+        void validatePWMRange(int pwm, size_t size) const;
+
+        /** Stage PWM configurations on the chips they belong to */
+        void stage(int pwm, PWMConfiguration const* configurations, size_t size);
+
+        /** Write a MODE register on all chips, over ALLCALL if they all have
+         * the same value */
+        void writeMode(uint8_t reg, uint8_t PCA9685::*mode, uint8_t set, uint8_t clear);
+
+    public:
+        /**
+         * @param i2c_bus the bus all chips are connected to
+         * @param addresses the addresses of the chips
+         * @param allcall_address the address all chips answer to
+         */
+        PCA9685Array(I2CTransport& i2c_bus,
+            std::vector<uint8_t> const& addresses,
+            uint8_t allcall_address = DEFAULT_ALLCALL_ADDRESS);
+
+        /** How many chips this array contains */
+        size_t getChipCount() const;
+
+        /** How many PWMs this array contains */
+        int getPWMCount() const;
+
+        /** The driver of a single chip */
+        PCA9685& getChip(size_t index);
+
+        /** The address all chips answer to */
+        uint8_t getAllCallAddress() const;
+
+        /** Program the array's ALLCALL address in all chips
+         *
+         * This is only needed if it is not the chips' power-on default
+         */
+        void writeAllCallAddress();
+
+        /** Stop all PWMs of all chips */
+        void stop();
+
+        /** Put all chips to sleep */
+        void writeSleepMode();
+
+        /** Put all chips to active */
+        void writeNormalMode();
+
+        /** Change the duration of the PWM cycle of all chips
+         *
+         * The chips need to be in sleep mode. See \c PCA9685::writePrescale
+         */
+        void writePrescale(uint8_t prescale);
+
+        /** Select when the written PWM configurations take effect on all
+         * chips, see \c PCA9685::writeOutputChange
+         */
+        void writeOutputChange(PCA9685::OutputChange mode);
+
+        /** Set the phase mode of all chips, see \c PCA9685::setPhaseMode */
+        void setPhaseMode(PCA9685::PhaseMode mode);
+
+        /** Write the same configuration to all PWMs of all chips
+         *
+         * It is written once over ALLCALL, unless the edges of the PWMs are
+         * staggered
+         */
+        void writeAllPWMConfigurations(PWMConfiguration const& configuration);
+
+        /** Set the same duty cycle, in [0, 1], on all PWMs of all chips */
+        void writeAllDutyRatios(float ratio);
+
+        /** Stage the configuration of a contiguous set of PWMs, to be written
+         * by the next \c commit
+         *
+         * The range may span several chips. Staging the same PWM twice keeps
+         * the last configuration
+         *
+         * @throw std::invalid_argument if the PWM range is out of the array's
+         */
+        void stagePWMConfigurations(int pwm,
+            PWMConfiguration const* configurations,
+            size_t size);
+
+        /** Stage duty cycles in nanoseconds, see \c writeDutyTimes */
+        void stageDutyTimes(int pwm,
+            uint32_t const* durations,
+            size_t size,
+            uint32_t period);
+
+        /** Stage duty cycles in [0, 1] */
+        void stageDutyRatios(int pwm, float const* ratios, size_t size);
+
+        /** Whether some PWM configurations are staged on any chip */
+        bool hasStagedPWMConfigurations() const;
+
+        /** Drop the staged configurations of all chips */
+        void clearStagedPWMConfigurations();
+
+        /** Write the staged configurations of all chips in a single transfer
+         *
+         * If the changed registers need more messages than the kernel accepts
+         * in a single transfer (\c I2CBus::MAX_MESSAGES_PER_TRANSFER), each
+         * chip's registers are written in a single message, including the
+         * unchanged registers in between. The transfer is split only if this
+         * is still not enough, in which case the PWMs are not guaranteed to
+         * take effect at the same time
+         */
+        void commit();
+
+        /** Write the configuration of a contiguous set of PWMs
+         *
+         * The range may span several chips. See
+         * \c PCA9685::writePWMConfigurations
+         *
+         * @throw std::invalid_argument if the PWM range is out of the array's
+         */
+        void writePWMConfigurations(int pwm,
+            PWMConfiguration const* configurations,
+            size_t size);
+
+        /** @overload */
+        void writePWMConfigurations(int pwm,
+            std::vector<PWMConfiguration> const& configurations);
+
+        /** Set the duty cycles in nanoseconds, see \c PCA9685::writeDutyTimes */
+        void writeDutyTimes(int pwm,
+            uint32_t const* durations,
+            size_t size,
+            uint32_t period);
+
+        /** @overload */
+        void writeDutyTimes(int pwm,
+            std::vector<uint32_t> const& durations,
+            uint32_t period);
+
+        /** Set the duty cycles in [0, 1] */
+        void writeDutyRatios(int pwm, float const* ratios, size_t size);
+
+        /** @overload */
+        void writeDutyRatios(int pwm, std::vector<float> const& ratios);
+    };
+}
+
+#endif
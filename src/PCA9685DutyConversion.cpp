@@ -0,0 +1,89 @@
+#include <i2clib/PCA9685DutyConversion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace i2clib;
+using namespace std;
+
+PCA9685DutyConversion::PCA9685DutyConversion(uint32_t period)
+    : m_period(period)
+{
+    if (period == 0) {
+        throw invalid_argument("the PWM period must be strictly positive");
+    }
+    m_reciprocal = (static_cast<uint64_t>(TICKS) << SHIFT) / period;
+}
+
+uint32_t PCA9685DutyConversion::getPeriod() const
+{
+    return m_period;
+}
+
+uint32_t PCA9685DutyConversion::durationToTicks(uint32_t ns) const
+{
+    uint32_t ticks;
+    durationsToTicks(&ns, 1, &ticks);
+    return ticks;
+}
+
+void PCA9685DutyConversion::durationsToTicks(uint32_t const* ns,
+    size_t size,
+    uint32_t* ticks) const
+{
+    uint64_t period = m_period;
+    for (size_t i = 0; i < size; ++i) {
+        // Saturating to the period bounds the product below 2^(SHIFT + 12)
+        uint64_t duration = min<uint64_t>(ns[i], period);
+
+        // The estimate is floor(duration * TICKS / period) or one less. Fix
+        // it with the remainder, and round to nearest
+        uint64_t q = (duration * m_reciprocal) >> SHIFT;
+        uint64_t r = duration * TICKS - q * period;
+        uint64_t carry = r >= period;
+        q += carry;
+        r -= carry * period;
+        q += 2 * r >= period;
+        ticks[i] = q;
+    }
+}
+
+PCA9685PWMConfiguration PCA9685DutyConversion::fromDuration(uint32_t ns) const
+{
+    return fromTicks(durationToTicks(ns));
+}
+
+void PCA9685DutyConversion::fromDurations(uint32_t const* ns,
+    size_t size,
+    PCA9685PWMConfiguration* configurations) const
+{
+    uint32_t ticks[BATCH_SIZE];
+    for (size_t begin = 0; begin < size; begin += BATCH_SIZE) {
+        size_t count = min(size - begin, BATCH_SIZE);
+        durationsToTicks(ns + begin, count, ticks);
+        for (size_t i = 0; i < count; ++i) {
+            configurations[begin + i] = fromTicks(ticks[i]);
+        }
+    }
+}
+
+uint32_t PCA9685DutyConversion::ratioToTicks(float ratio)
+{
+    if (!(ratio > 0)) {
+        return 0;
+    }
+    else if (ratio >= 1) {
+        return TICKS;
+    }
+    // ratio * TICKS is exact, as TICKS is a power of two. Adding one half
+    // and truncating would not be: the sum rounds up to 1 for the largest
+    // float below 0.5
+    return lround(ratio * TICKS);
+}
+
+PCA9685PWMConfiguration PCA9685DutyConversion::fromTicks(uint32_t ticks)
+{
+    return PCA9685PWMConfiguration::fromUnnormalizedOffEdge(
+        static_cast<int32_t>(ticks) - 1);
+}
@@ -0,0 +1,80 @@
+#ifndef I2CLIB_PCA9685DUTYCONVERSION_HPP
+#define I2CLIB_PCA9685DUTYCONVERSION_HPP
+
+#include <i2clib/PCA9685PWMConfiguration.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace i2clib {
+    /** Conversion of duty durations into PWM configurations for a given PWM
+     * period
+     *
+     * The duration is converted into the closest number of ticks of the
+     * 4096-ticks cycle. The division by the period is precomputed as a
+     * fixed-point reciprocal, and the multiply-shift result is corrected with
+     * the exact remainder, so that the rounding is the same as an exact
+     * division (halves are rounded up).
+     */
+    class PCA9685DutyConversion {
+        /** Fixed-point precision of the reciprocal */
+        static constexpr int SHIFT = 39;
+        /** How many durations \c fromDurations converts at once */
+        static constexpr std::size_t BATCH_SIZE = 16;
+
+        std::uint32_t m_period = 0;
+        /** floor(2^SHIFT * 4096 / period) */
+        std::uint64_t m_reciprocal = 0;
+
+    public:
+        /** The number of ticks in a PWM cycle */
+        static constexpr std::uint32_t TICKS = 4096;
+
+        /**
+         * @param period the PWM period in nanoseconds, see
+         *   \c PCA9685::prescaleToPeriod and \c PCA9685::readPWMPeriod
+         * @throw std::invalid_argument if the period is zero
+         */
+        explicit PCA9685DutyConversion(std::uint32_t period);
+
+        /** The PWM period in nanoseconds */
+        std::uint32_t getPeriod() const;
+
+        /** The number of ticks closest to a duty duration
+         *
+         * Durations longer than the period saturate to \c TICKS
+         */
+        std::uint32_t durationToTicks(std::uint32_t ns) const;
+
+        /** Convert a series of duty durations into ticks
+         *
+         * The results are the same than \c durationToTicks. The conversion
+         * loop is branch-free so that the compiler may vectorize it
+         */
+        void durationsToTicks(std::uint32_t const* ns,
+            std::size_t size,
+            std::uint32_t* ticks) const;
+
+        /** The PWM configuration for a duty duration */
+        PCA9685PWMConfiguration fromDuration(std::uint32_t ns) const;
+
+        /** Convert a series of duty durations, e.g. the 16 outputs of a chip,
+         * into PWM configurations
+         */
+        void fromDurations(std::uint32_t const* ns,
+            std::size_t size,
+            PCA9685PWMConfiguration* configurations) const;
+
+        /** The number of ticks closest to a duty ratio, within [0, TICKS] */
+        static std::uint32_t ratioToTicks(float ratio);
+
+        /** The PWM configuration for a number of ticks
+         *
+         * This follows \c PCA9685PWMConfiguration::fromUnnormalizedOffEdge,
+         * with an off edge one tick before the given number of ticks
+         */
+        static PCA9685PWMConfiguration fromTicks(std::uint32_t ticks);
+    };
+}
+
+#endif
@@ -1,8 +1,12 @@
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <thread>
 
+#include <i2clib/CalibrationCache.hpp>
+#include <i2clib/I2CBus.hpp>
 #include <i2clib/PCA9685.hpp>
 
 using namespace std;
@@ -10,6 +14,8 @@ using namespace i2clib;
 
 static constexpr int ARGC_MIN = 4;
 static constexpr int ARG_INDEX_CMD = 3;
+/** Environment variable holding the path of the calibration cache */
+static char const* CALIBRATION_CACHE_ENV = "I2CLIB_CALIBRATION_CACHE";
 
 void usage(string const& cmd, ostream& io)
 {
@@ -34,6 +40,14 @@ void usage(string const& cmd, ostream& io)
        << "    whose frequency is not 25MHz\n"
        << "  set-duty-ratio PWM RATIO where RATIO is the ratio of the ON phase of \n"
        << "    the PWM period, as a float between 0 and 1\n"
+       << "  calibrate PERIOD_US compute the oscillator frequency from the PWM\n"
+       << "    period measured on one of the outputs (in microseconds), and store\n"
+       << "    it in the calibration cache\n"
+       << "  show-calibration display the oscillator frequency used for this chip\n"
+       << "\n"
+       << "If the " << CALIBRATION_CACHE_ENV << " environment variable is set, the\n"
+       << "oscillator frequency stored by `calibrate` in that file is used instead\n"
+       << "of 25MHz when FREQ is not given\n"
        << flush;
 }
 
@@ -71,10 +85,17 @@ int main(int argc, char** argv)
     int address = stoi(argv[2]);
     string cmd = argv[ARG_INDEX_CMD];
 
+    unique_ptr<CalibrationCache> cache;
+    float calibrated_freq = PCA9685::INTERNAL_OSCILLATOR_FREQUENCY;
+    if (char const* cache_path = getenv(CALIBRATION_CACHE_ENV)) {
+        cache.reset(new CalibrationCache(cache_path));
+        calibrated_freq = PCA9685::loadOscillatorFrequency(*cache, i2c_dev, address);
+    }
+
     if (cmd == "prescale-to-period") {
         auto cmdArgs = validateCmdArgc(argc, argv, 1, 2);
         uint8_t prescale = stoi(cmdArgs[0]);
-        float freq = PCA9685::INTERNAL_OSCILLATOR_FREQUENCY;
+        float freq = calibrated_freq;
         if (cmdArgs.size() == 2) {
             freq = stof(cmdArgs[1]);
         }
@@ -84,7 +105,7 @@ int main(int argc, char** argv)
     else if (cmd == "period-to-prescale") {
         auto cmdArgs = validateCmdArgc(argc, argv, 1, 2);
         uint32_t period = stoi(cmdArgs[0]);
-        float freq = PCA9685::INTERNAL_OSCILLATOR_FREQUENCY;
+        float freq = calibrated_freq;
         if (cmdArgs.size() == 2) {
             freq = stof(cmdArgs[1]);
         }
@@ -106,6 +127,7 @@ int main(int argc, char** argv)
     I2CBus bus(i2c_dev);
 
     i2clib::PCA9685 chip(bus, address);
+    chip.setOscillatorFrequency(calibrated_freq);
     if (cmd == "sleep") {
         chip.writeSleepMode();
     }
@@ -137,14 +159,15 @@ int main(int argc, char** argv)
         auto cmdArgs = validateCmdArgc(argc, argv, 2, 3);
         auto pwm = stoi(cmdArgs[0]);
         uint32_t duty_duration_us = stoi(cmdArgs[1]);
-        float freq = PCA9685::INTERNAL_OSCILLATOR_FREQUENCY;
+        float freq = calibrated_freq;
         if (cmdArgs.size() == 3) {
             freq = stof(cmdArgs[2]);
         }
         uint32_t period = chip.readPWMPeriod(freq);
 
         chip.writeNormalMode();
-        chip.writeDutyTimes(pwm, {duty_duration_us * 1000}, period);
+        uint32_t duty_duration_ns = duty_duration_us * 1000;
+        chip.writeDutyTimes(pwm, &duty_duration_ns, 1, period);
     }
     else if (cmd == "set-duty-ratio") {
         auto cmdArgs = validateCmdArgc(argc, argv, 2);
@@ -152,7 +175,28 @@ int main(int argc, char** argv)
         auto ratio = stof(argv[ARG_INDEX_CMD + 2]);
 
         chip.writeNormalMode();
-        chip.writeDutyRatios(pwm, {ratio});
+        chip.writeDutyRatios(pwm, &ratio, 1);
+    }
+    else if (cmd == "calibrate") {
+        auto cmdArgs = validateCmdArgc(argc, argv, 1);
+        if (!cache) {
+            cerr << "calibrate: set " << CALIBRATION_CACHE_ENV
+                 << " to the path of the calibration cache" << endl;
+            return 1;
+        }
+
+        uint32_t measured_period = stod(cmdArgs[0]) * 1000;
+        uint8_t prescale = chip.readPrescale();
+        chip.setOscillatorFrequency(
+            PCA9685::measuredOscillatorFrequency(prescale, measured_period));
+        chip.saveOscillatorFrequency(*cache, i2c_dev);
+        cout << "oscillator frequency: " << chip.getOscillatorFrequency() << " Hz\n"
+             << "nominal period: " << PCA9685::prescaleToPeriod(prescale) << " ns\n";
+    }
+    else if (cmd == "show-calibration") {
+        validateCmdArgc(argc, argv, 0);
+        cout << "oscillator frequency: " << chip.getOscillatorFrequency() << " Hz\n"
+             << "PWM period: " << chip.readPWMPeriod() << " ns\n";
     }
     else {
         cerr << "invalid command " << cmd << endl;
@@ -1,3 +1,4 @@
+#include <i2clib/PCA9685DutyConversion.hpp>
 #include <i2clib/PCA9685PWMConfiguration.hpp>
 
 using namespace i2clib;
@@ -19,4 +20,9 @@ PCA9685PWMConfiguration PCA9685PWMConfiguration::fromUnnormalizedOffEdge(int32_t
     c.on_edge = 0;
     c.off_edge = off_edge;
     return c;
-}
\ No newline at end of file
+}
+
+PCA9685PWMConfiguration PCA9685PWMConfiguration::fromDutyRatio(float ratio)
+{
+    return PCA9685DutyConversion::fromTicks(PCA9685DutyConversion::ratioToTicks(ratio));
+}
@@ -27,6 +27,12 @@ namespace i2clib {
          * into a proper configuration
          */
         static PCA9685PWMConfiguration fromUnnormalizedOffEdge(int32_t off_edge);
+
+        /** Configuration for a duty cycle in [0, 1]
+         *
+         * Values outside of this range saturate to full off or full on
+         */
+        static PCA9685PWMConfiguration fromDutyRatio(float ratio);
     };
 }
 
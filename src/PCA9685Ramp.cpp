@@ -0,0 +1,177 @@
+#include <i2clib/PCA9685Ramp.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace i2clib;
+using namespace std;
+
+PCA9685Ramp::PCA9685Ramp(PCA9685& chip, int pwm, int count, base::Time const& tick)
+    : m_chip(chip)
+    , m_pwm(pwm)
+    , m_count(count)
+    , m_tick(tick.toSeconds())
+{
+    if (pwm < 0 || count <= 0 || pwm + count > PCA9685::PWM_COUNT) {
+        throw invalid_argument("invalid PWM range " + to_string(pwm) + " to " +
+                               to_string(pwm + count - 1));
+    }
+    if (m_tick <= 0) {
+        throw invalid_argument("the ramp tick must be strictly positive");
+    }
+}
+
+void PCA9685Ramp::validate(int pwm) const
+{
+    if (pwm < m_pwm || pwm >= m_pwm + m_count) {
+        throw invalid_argument("PWM " + to_string(pwm) + " is not controlled by this ramp");
+    }
+}
+
+PCA9685Ramp::Channel& PCA9685Ramp::channel(int pwm)
+{
+    validate(pwm);
+    return m_channels[pwm];
+}
+
+PCA9685Ramp::Channel const& PCA9685Ramp::channel(int pwm) const
+{
+    validate(pwm);
+    return m_channels[pwm];
+}
+
+base::Time PCA9685Ramp::getTick() const
+{
+    return base::Time::fromSeconds(static_cast<double>(m_tick));
+}
+
+void PCA9685Ramp::setLimits(int pwm, Limits const& limits)
+{
+    if (!(limits.max_rate > 0) || !(limits.max_acceleration > 0)) {
+        throw invalid_argument("ramp limits must be strictly positive");
+    }
+    channel(pwm).limits = limits;
+}
+
+void PCA9685Ramp::setTarget(int pwm, float ratio)
+{
+    channel(pwm).target = ratio;
+}
+
+void PCA9685Ramp::setTargets(int pwm, float const* ratios, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        setTarget(pwm + i, ratios[i]);
+    }
+}
+
+void PCA9685Ramp::setPosition(int pwm, float ratio)
+{
+    auto& c = channel(pwm);
+    c.position = ratio;
+    c.target = ratio;
+    c.velocity = 0;
+}
+
+float PCA9685Ramp::getPosition(int pwm) const
+{
+    return channel(pwm).position;
+}
+
+float PCA9685Ramp::getTarget(int pwm) const
+{
+    return channel(pwm).target;
+}
+
+bool PCA9685Ramp::isSettled() const
+{
+    for (int i = m_pwm; i < m_pwm + m_count; ++i) {
+        auto const& c = m_channels[i];
+        if (c.position != c.target || c.velocity != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PCA9685Ramp::advance(Channel& c) const
+{
+    float distance = c.target - c.position;
+    float max_acceleration = c.limits.max_acceleration;
+
+    // Fastest velocity from which the output can still stop at the target.
+    // Decelerating from n * a * tick takes n ticks and covers
+    // a * tick^2 * n * (n + 1) / 2
+    float stopping_speed = numeric_limits<float>::infinity();
+    if (!isinf(max_acceleration)) {
+        float step = max_acceleration * m_tick;
+        float n = sqrt(0.25f + 2 * abs(distance) / (step * m_tick)) - 0.5f;
+        stopping_speed = n * step;
+    }
+    float speed = min(c.limits.max_rate, stopping_speed);
+    if (isinf(speed)) {
+        c.position = c.target;
+        c.velocity = 0;
+        return;
+    }
+
+    float velocity = copysign(speed, distance);
+    float max_delta = max_acceleration * m_tick;
+    if (!isinf(max_acceleration)) {
+        velocity = min(max(velocity, c.velocity - max_delta), c.velocity + max_delta);
+    }
+
+    // Stopping at the target is only possible if the acceleration limit let
+    // the output slow down to the stopping speed (up to rounding). Otherwise
+    // (e.g. the target moved to the current position), keep decelerating past
+    // the target and come back
+    float next = c.position + velocity * m_tick;
+    bool reached =
+        (distance >= 0 && next >= c.target) || (distance <= 0 && next <= c.target);
+    if (reached && abs(velocity) <= stopping_speed + max_delta * 0.01f) {
+        c.position = c.target;
+        c.velocity = 0;
+    }
+    else {
+        c.position = next;
+        c.velocity = velocity;
+    }
+}
+
+static bool isSameConfiguration(PCA9685PWMConfiguration const& a,
+    PCA9685PWMConfiguration const& b)
+{
+    return a.mode == b.mode && a.on_edge == b.on_edge && a.off_edge == b.off_edge;
+}
+
+bool PCA9685Ramp::step()
+{
+    int dirty_begin = m_written ? m_pwm + m_count : m_pwm;
+    int dirty_end = m_written ? m_pwm : m_pwm + m_count;
+    bool moving = false;
+    for (int i = m_pwm; i < m_pwm + m_count; ++i) {
+        auto& c = m_channels[i];
+        advance(c);
+        moving = moving || c.position != c.target || c.velocity != 0;
+
+        auto configuration = PCA9685::PWMConfiguration::fromDutyRatio(c.position);
+        if (!isSameConfiguration(configuration, m_configurations[i])) {
+            m_configurations[i] = configuration;
+            dirty_begin = min(dirty_begin, i);
+            dirty_end = max(dirty_end, i + 1);
+        }
+    }
+
+    if (dirty_begin < dirty_end) {
+        // Write everything on the next step if this one fails
+        m_written = false;
+        m_chip.writePWMConfigurations(dirty_begin,
+            m_configurations.data() + dirty_begin,
+            dirty_end - dirty_begin);
+        m_written = true;
+    }
+    return moving;
+}
@@ -0,0 +1,105 @@
+#ifndef I2CLIB_PCA9685RAMP_HPP
+#define I2CLIB_PCA9685RAMP_HPP
+
+#include <base/Time.hpp>
+#include <i2clib/PCA9685.hpp>
+
+#include <array>
+#include <cstddef>
+#include <limits>
+
+namespace i2clib {
+    /** Rate-limited transitions of the duty cycles of a contiguous range of
+     * PCA9685 outputs
+     *
+     * Each output moves from its current duty ratio towards its target, with
+     * limits on the rate of change and on the acceleration. The trajectories
+     * are computed on a fixed tick: \c step is meant to be called at that
+     * period, e.g. from an I2CBusScheduler task. Each step writes only the
+     * outputs whose registers changed, in a single transfer, on top of the
+     * driver's own register cache.
+     *
+     * The ramp does not allocate once constructed
+     */
+    class PCA9685Ramp {
+    public:
+        struct Limits {
+            /** Maximum rate of change of the duty ratio, in 1/s */
+            float max_rate = std::numeric_limits<float>::infinity();
+            /** Maximum acceleration of the duty ratio, in 1/s^2 */
+            float max_acceleration = std::numeric_limits<float>::infinity();
+        };
+
+    private:
+        struct Channel {
+            float position = 0;
+            float velocity = 0;
+            float target = 0;
+            Limits limits;
+        };
+
+        PCA9685& m_chip;
+        int m_pwm;
+        int m_count;
+        float m_tick;
+
+        std::array<Channel, PCA9685::PWM_COUNT> m_channels;
+        /** Configuration last written for each output */
+        std::array<PCA9685::PWMConfiguration, PCA9685::PWM_COUNT> m_configurations;
+        /** Whether the outputs have been written since the ramp was created */
+        bool m_written = false;
+
+        void validate(int pwm) const;
+        Channel& channel(int pwm);
+        Channel const& channel(int pwm) const;
+
+        /** Advance a single channel by one tick */
+        void advance(Channel& channel) const;
+
+    public:
+        /**
+         * @param chip the chip
+         * @param pwm the first output controlled by this ramp
+         * @param count how many outputs are controlled by this ramp
+         * @param tick the period at which \c step is called
+         */
+        PCA9685Ramp(PCA9685& chip, int pwm, int count, base::Time const& tick);
+
+        /** The period at which \c step is meant to be called */
+        base::Time getTick() const;
+
+        /** Set the limits of an output. By default, outputs are not limited */
+        void setLimits(int pwm, Limits const& limits);
+
+        /** Set the duty ratio an output should move to */
+        void setTarget(int pwm, float ratio);
+
+        /** Set the duty ratio of the outputs from \c pwm to \c pwm + size - 1 */
+        void setTargets(int pwm, float const* ratios, std::size_t size);
+
+        /** Set the current duty ratio of an output, without ramp
+         *
+         * This also stops the output at that ratio. Outputs start at zero, use
+         * this to start from a different state. The value is written on the
+         * next call to \c step
+         */
+        void setPosition(int pwm, float ratio);
+
+        /** The duty ratio of an output, as of the last \c step */
+        float getPosition(int pwm) const;
+
+        /** The duty ratio an output is moving to */
+        float getTarget(int pwm) const;
+
+        /** Whether all outputs reached their targets */
+        bool isSettled() const;
+
+        /** Advance all outputs by one tick and write the ones that changed
+         *
+         * @return true if some outputs did not reach their target yet
+         */
+        bool step();
+    };
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/RecordingI2CBus.hpp>
+
+#include <cstdint>
+#include <exception>
+#include <ostream>
+
+using namespace i2clib;
+using namespace std;
+
+static base::Time toTime(chrono::steady_clock::duration duration)
+{
+    return base::Time::fromMicroseconds(
+        chrono::duration_cast<chrono::microseconds>(duration).count());
+}
+
+RecordingI2CBus::RecordingI2CBus(I2CTransport& transport, ostream& log)
+    : m_transport(transport)
+    , m_log(log)
+    , m_start(chrono::steady_clock::now())
+{
+    I2CTransactionLog::writeHeader(m_log);
+}
+
+void RecordingI2CBus::record(chrono::steady_clock::time_point start,
+    chrono::steady_clock::time_point end,
+    uint8_t address,
+    uint8_t const* write_bytes,
+    size_t write_size,
+    uint8_t const* read_bytes,
+    size_t read_size,
+    int flags,
+    int error)
+{
+    m_entry.time = toTime(start - m_start);
+    m_entry.duration = toTime(end - start);
+    m_entry.address = address;
+    m_entry.flags = flags;
+    m_entry.error = error;
+    m_entry.write_bytes.assign(write_bytes, write_bytes + write_size);
+    m_entry.read_bytes.assign(read_bytes, read_bytes + read_size);
+    I2CTransactionLog::writeEntry(m_log, m_entry);
+}
+
+void RecordingI2CBus::read(uint8_t address,
+    uint8_t* write_bytes,
+    size_t write_size,
+    uint8_t* bytes,
+    size_t size)
+{
+    int flags = I2CTransactionLog::HAS_WRITE | I2CTransactionLog::HAS_READ;
+    auto start = chrono::steady_clock::now();
+    try {
+        m_transport.read(address, write_bytes, write_size, bytes, size);
+    }
+    catch (IOError const& e) {
+        record(start, chrono::steady_clock::now(), address, write_bytes, write_size,
+            bytes, size, flags, e.error_code);
+        throw;
+    }
+    record(start, chrono::steady_clock::now(), address, write_bytes, write_size,
+        bytes, size, flags, 0);
+}
+
+void RecordingI2CBus::write(uint8_t address, uint8_t* bytes, size_t size)
+{
+    int flags = I2CTransactionLog::HAS_WRITE;
+    auto start = chrono::steady_clock::now();
+    try {
+        m_transport.write(address, bytes, size);
+    }
+    catch (IOError const& e) {
+        record(start, chrono::steady_clock::now(), address, bytes, size,
+            nullptr, 0, flags, e.error_code);
+        throw;
+    }
+    record(start, chrono::steady_clock::now(), address, bytes, size,
+        nullptr, 0, flags, 0);
+}
+
+void RecordingI2CBus::transfer(I2CTransactionBatch const& batch)
+{
+    size_t failed_message = SIZE_MAX;
+    int error = 0;
+    exception_ptr failure;
+    auto start = chrono::steady_clock::now();
+    try {
+        m_transport.transfer(batch);
+    }
+    catch (BatchError const& e) {
+        failed_message = e.first_message;
+        error = e.error_code;
+        failure = current_exception();
+    }
+    auto end = chrono::steady_clock::now();
+
+    // The messages of a batch transaction are an optional write followed by
+    // an optional read
+    auto const& messages = batch.messages();
+    for (size_t i = 0; i < messages.size();) {
+        size_t first = i;
+        I2CTransactionBatch::Message const* write = nullptr;
+        I2CTransactionBatch::Message const* read = nullptr;
+        for (; i < messages.size() &&
+               messages[i].transaction == messages[first].transaction;
+             ++i) {
+            (messages[i].read ? read : write) = &messages[i];
+        }
+
+        bool failed = failed_message < i;
+        record(start, end, messages[first].address,
+            write ? write->buffer : nullptr, write ? write->size : 0,
+            read ? read->buffer : nullptr, read ? read->size : 0,
+            (write ? I2CTransactionLog::HAS_WRITE : 0) |
+                (read ? I2CTransactionLog::HAS_READ : 0),
+            failed ? error : 0);
+        if (failed) {
+            break;
+        }
+    }
+
+    if (failure) {
+        rethrow_exception(failure);
+    }
+}
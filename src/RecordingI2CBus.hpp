@@ -0,0 +1,57 @@
+#ifndef I2CLIB_RECORDINGI2CBUS_HPP
+#define I2CLIB_RECORDINGI2CBUS_HPP
+
+#include <i2clib/I2CTransactionLog.hpp>
+#include <i2clib/I2CTransport.hpp>
+
+#include <chrono>
+#include <iosfwd>
+
+namespace i2clib {
+    /** Transport that records all transactions performed on another transport
+     *
+     * Every transaction is written to a binary log (see I2CTransactionLog),
+     * along with its outcome and timing. The log can be played back with
+     * ReplayI2CBus.
+     *
+     * Transactions that are not performed because a previous one of the same
+     * batch failed are not recorded.
+     */
+    class RecordingI2CBus : public I2CTransport {
+        I2CTransport& m_transport;
+        std::ostream& m_log;
+        std::chrono::steady_clock::time_point m_start;
+        I2CTransactionLog::Entry m_entry;
+
+        void record(std::chrono::steady_clock::time_point start,
+            std::chrono::steady_clock::time_point end,
+            std::uint8_t address,
+            std::uint8_t const* write_bytes,
+            size_t write_size,
+            std::uint8_t const* read_bytes,
+            size_t read_size,
+            int flags,
+            int error);
+
+    public:
+        /** Record the transactions performed on \c transport to \c log
+         *
+         * The log header is written immediately. Neither the transport nor the
+         * stream are owned by this object
+         */
+        RecordingI2CBus(I2CTransport& transport, std::ostream& log);
+
+        using I2CTransport::read;
+        using I2CTransport::write;
+
+        void read(uint8_t address,
+            uint8_t* write_bytes,
+            size_t write_size,
+            uint8_t* bytes,
+            size_t size) override;
+        void write(uint8_t address, uint8_t* bytes, size_t size) override;
+        void transfer(I2CTransactionBatch const& batch) override;
+    };
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/ReplayI2CBus.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+using namespace i2clib;
+using namespace std;
+
+ReplayI2CBus::ReplayI2CBus(istream& stream, Timing timing)
+    : ReplayI2CBus(I2CTransactionLog::readAll(stream), timing)
+{
+}
+
+ReplayI2CBus::ReplayI2CBus(vector<I2CTransactionLog::Entry> entries, Timing timing)
+    : m_entries(move(entries))
+    , m_timing(timing)
+{
+}
+
+size_t ReplayI2CBus::getPosition() const
+{
+    return m_position;
+}
+
+size_t ReplayI2CBus::size() const
+{
+    return m_entries.size();
+}
+
+bool ReplayI2CBus::atEnd() const
+{
+    return m_position == m_entries.size();
+}
+
+void ReplayI2CBus::rewind()
+{
+    m_position = 0;
+}
+
+I2CTransactionLog::Entry const& ReplayI2CBus::next(uint8_t address,
+    uint8_t const* write_bytes,
+    size_t write_size,
+    size_t read_size,
+    int flags)
+{
+    if (atEnd()) {
+        throw ReplayError("replay log exhausted after " + to_string(m_position) +
+                          " transactions");
+    }
+
+    auto const& entry = m_entries[m_position];
+    bool match = entry.address == address && entry.flags == flags &&
+                 entry.write_bytes.size() == write_size &&
+                 entry.read_bytes.size() == read_size &&
+                 equal(entry.write_bytes.begin(), entry.write_bytes.end(), write_bytes);
+    if (!match) {
+        ostringstream message;
+        message << "transaction " << m_position << " does not match the log: "
+                << "expected address " << static_cast<int>(entry.address) << " with "
+                << entry.write_bytes.size() << " bytes written and "
+                << entry.read_bytes.size() << " bytes read, got address "
+                << static_cast<int>(address) << " with " << write_size
+                << " bytes written and " << read_size << " bytes read";
+        throw ReplayError(message.str());
+    }
+
+    if (m_timing == REPLAY_ORIGINAL_TIMING) {
+        wait(entry);
+    }
+    ++m_position;
+    return entry;
+}
+
+void ReplayI2CBus::wait(I2CTransactionLog::Entry const& entry)
+{
+    auto entry_time = chrono::microseconds(entry.time.toMicroseconds());
+    if (m_position == 0) {
+        m_start = chrono::steady_clock::now() - entry_time;
+    }
+    auto end = entry_time + chrono::microseconds(entry.duration.toMicroseconds());
+    this_thread::sleep_until(m_start + end);
+}
+
+void ReplayI2CBus::read(uint8_t address,
+    uint8_t* write_bytes,
+    size_t write_size,
+    uint8_t* bytes,
+    size_t size)
+{
+    auto const& entry = next(address,
+        write_bytes,
+        write_size,
+        size,
+        I2CTransactionLog::HAS_WRITE | I2CTransactionLog::HAS_READ);
+    if (entry.error) {
+        throw ReadError("replayed read from address " + to_string(address) +
+                            " failed: " + strerror(entry.error),
+            entry.error);
+    }
+    copy(entry.read_bytes.begin(), entry.read_bytes.end(), bytes);
+}
+
+void ReplayI2CBus::write(uint8_t address, uint8_t* bytes, size_t size)
+{
+    auto const& entry = next(address, bytes, size, 0, I2CTransactionLog::HAS_WRITE);
+    if (entry.error) {
+        throw WriteError("replayed write to address " + to_string(address) +
+                             " failed: " + strerror(entry.error),
+            entry.error);
+    }
+}
+
+void ReplayI2CBus::transfer(I2CTransactionBatch const& batch)
+{
+    auto const& messages = batch.messages();
+    for (size_t i = 0; i < messages.size();) {
+        size_t first = i;
+        I2CTransactionBatch::Message const* write = nullptr;
+        I2CTransactionBatch::Message const* read = nullptr;
+        for (; i < messages.size() &&
+               messages[i].transaction == messages[first].transaction;
+             ++i) {
+            (messages[i].read ? read : write) = &messages[i];
+        }
+
+        auto const& entry = next(messages[first].address,
+            write ? write->buffer : nullptr,
+            write ? write->size : 0,
+            read ? read->size : 0,
+            (write ? I2CTransactionLog::HAS_WRITE : 0) |
+                (read ? I2CTransactionLog::HAS_READ : 0));
+        if (entry.error) {
+            throw BatchError("replayed batch transfer failed at message " +
+                                 to_string(first) + ": " + strerror(entry.error),
+                entry.error,
+                first,
+                messages.size() - first);
+        }
+        if (read) {
+            copy(entry.read_bytes.begin(), entry.read_bytes.end(), read->buffer);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef I2CLIB_REPLAYI2CBUS_HPP
+#define I2CLIB_REPLAYI2CBUS_HPP
+
+#include <i2clib/I2CTransactionLog.hpp>
+#include <i2clib/I2CTransport.hpp>
+
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+
+namespace i2clib {
+    /** Transport that plays back a log written by RecordingI2CBus
+     *
+     * Each transaction requested by the drivers is matched against the next
+     * entry of the log. The address, the written bytes and the number of read
+     * bytes must be the same as during the recording. The bytes read during
+     * the recording are then returned, or the recorded error is thrown.
+     *
+     * Transactions can be served as fast as possible, or with the timing of
+     * the recording, relative to the first transaction that is replayed.
+     *
+     * @throw ReplayError if the drivers diverge from the log, or the log is
+     *   exhausted
+     */
+    class ReplayI2CBus : public I2CTransport {
+    public:
+        enum Timing {
+            /** Serve the transactions immediately */
+            REPLAY_FULL_SPEED,
+            /** Wait until the time at which the transaction was completed in
+             * the recording */
+            REPLAY_ORIGINAL_TIMING
+        };
+
+    private:
+        std::vector<I2CTransactionLog::Entry> m_entries;
+        Timing m_timing;
+        size_t m_position = 0;
+        std::chrono::steady_clock::time_point m_start;
+
+        I2CTransactionLog::Entry const& next(std::uint8_t address,
+            std::uint8_t const* write_bytes,
+            size_t write_size,
+            size_t read_size,
+            int flags);
+        void wait(I2CTransactionLog::Entry const& entry);
+
+    public:
+        /** Replay the log read from \c stream */
+        explicit ReplayI2CBus(std::istream& stream,
+            Timing timing = REPLAY_FULL_SPEED);
+
+        /** Replay the given entries */
+        explicit ReplayI2CBus(std::vector<I2CTransactionLog::Entry> entries,
+            Timing timing = REPLAY_FULL_SPEED);
+
+        /** Index of the next entry to be replayed */
+        size_t getPosition() const;
+
+        /** Total number of entries in the log */
+        size_t size() const;
+
+        /** Whether all entries have been replayed */
+        bool atEnd() const;
+
+        /** Restart from the beginning of the log
+         *
+         * With REPLAY_ORIGINAL_TIMING, the timing is also restarted from the
+         * next transaction
+         */
+        void rewind();
+
+        using I2CTransport::read;
+        using I2CTransport::write;
+
+        void read(uint8_t address,
+            uint8_t* write_bytes,
+            size_t write_size,
+            uint8_t* bytes,
+            size_t size) override;
+        void write(uint8_t address, uint8_t* bytes, size_t size) override;
+        void transfer(I2CTransactionBatch const& batch) override;
+    };
+}
+
+#endif
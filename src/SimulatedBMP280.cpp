@@ -0,0 +1,105 @@
+#include <i2clib/SimulatedBMP280.hpp>
+
+using namespace i2clib;
+using namespace std;
+
+SimulatedBMP280::SimulatedBMP280()
+{
+    m_registers[REGISTER_ID] = CHIP_ID;
+    updateDataRegisters();
+}
+
+static void write_lsb_msb(uint8_t* registers, uint16_t value)
+{
+    registers[0] = value & 0xFF;
+    registers[1] = value >> 8;
+}
+
+void SimulatedBMP280::setCalibration(BMP280::Calibration const& c)
+{
+    uint8_t* registers = m_registers.data() + REGISTER_COMPENSATION_PARAMETERS_START;
+    write_lsb_msb(registers + 0, c.dig_T1);
+    write_lsb_msb(registers + 2, c.dig_T2);
+    write_lsb_msb(registers + 4, c.dig_T3);
+    write_lsb_msb(registers + 6, c.dig_P1);
+    write_lsb_msb(registers + 8, c.dig_P2);
+    write_lsb_msb(registers + 10, c.dig_P3);
+    write_lsb_msb(registers + 12, c.dig_P4);
+    write_lsb_msb(registers + 14, c.dig_P5);
+    write_lsb_msb(registers + 16, c.dig_P6);
+    write_lsb_msb(registers + 18, c.dig_P7);
+    write_lsb_msb(registers + 20, c.dig_P8);
+    write_lsb_msb(registers + 22, c.dig_P9);
+}
+
+void SimulatedBMP280::setRawMeasurements(BMP280::RawMeasurements const& raw)
+{
+    m_raw = raw;
+    if ((m_registers[REGISTER_MEASUREMENT_CONTROL] & 0x3) == BMP280::MODE_NORMAL) {
+        updateDataRegisters();
+    }
+}
+
+void SimulatedBMP280::setMeasurementDuration(base::Time const& duration)
+{
+    m_measurement_duration = chrono::microseconds(duration.toMicroseconds());
+}
+
+static void write_raw(uint8_t* registers, uint32_t value)
+{
+    registers[0] = (value >> 12) & 0xFF;
+    registers[1] = (value >> 4) & 0xFF;
+    registers[2] = (value << 4) & 0xF0;
+}
+
+void SimulatedBMP280::updateDataRegisters()
+{
+    write_raw(m_registers.data() + REGISTER_PRESSURE_START, m_raw.pressure);
+    write_raw(m_registers.data() + REGISTER_PRESSURE_START + 3, m_raw.temperature);
+}
+
+void SimulatedBMP280::writeRegister(uint8_t reg, uint8_t value)
+{
+    if (reg != REGISTER_MEASUREMENT_CONTROL) {
+        SimulatedRegisterDevice::writeRegister(reg, value);
+        return;
+    }
+
+    int mode = value & 0x3;
+    if (mode == BMP280::MODE_SLEEP) {
+        m_registers[reg] = value;
+        return;
+    }
+
+    if (mode == BMP280::MODE_NORMAL) {
+        updateDataRegisters();
+        m_registers[reg] = value;
+        return;
+    }
+
+    m_registers[reg] = value;
+    m_measuring = true;
+    m_measurement_end = chrono::steady_clock::now() + m_measurement_duration;
+    updateMeasurement();
+}
+
+void SimulatedBMP280::updateMeasurement()
+{
+    if (!m_measuring || chrono::steady_clock::now() < m_measurement_end) {
+        return;
+    }
+
+    // Forced mode goes back to sleep at the end of the measurement
+    updateDataRegisters();
+    m_measuring = false;
+    m_registers[REGISTER_MEASUREMENT_CONTROL] &= ~0x3;
+}
+
+uint8_t SimulatedBMP280::readRegister(uint8_t reg)
+{
+    updateMeasurement();
+    if (reg == REGISTER_STATUS) {
+        return m_measuring ? STATUS_MEASURING : 0;
+    }
+    return m_registers[reg];
+}
@@ -0,0 +1,64 @@
+#ifndef I2CLIB_SIMULATEDBMP280_HPP
+#define I2CLIB_SIMULATEDBMP280_HPP
+
+#include <i2clib/BMP280.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+
+#include <chrono>
+
+namespace i2clib {
+    /** Register-level model of the BMP280
+     *
+     * It models the ID, calibration, control and data registers. The raw ADC
+     * values that the device "measures" are set with \c setRawMeasurements. They
+     * are made available in the data registers when a forced measurement is
+     * triggered, or immediately in normal mode.
+     *
+     * Measurements in forced mode take the time configured with
+     * \c setMeasurementDuration. The status register reports the measurement
+     * in progress, and the data registers are updated at its end.
+     */
+    class SimulatedBMP280 : public SimulatedRegisterDevice {
+    public:
+        static constexpr uint8_t REGISTER_COMPENSATION_PARAMETERS_START = 0x88;
+        static constexpr uint8_t REGISTER_ID = 0xD0;
+        static constexpr uint8_t REGISTER_STATUS = 0xF3;
+        static constexpr uint8_t REGISTER_MEASUREMENT_CONTROL = 0xF4;
+        static constexpr uint8_t REGISTER_PRESSURE_START = 0xF7;
+
+        static constexpr uint8_t CHIP_ID = 0x58;
+
+    private:
+        static constexpr uint8_t STATUS_MEASURING = 1 << 3;
+
+        BMP280::RawMeasurements m_raw{0x80000, 0x80000};
+
+        std::chrono::microseconds m_measurement_duration{0};
+        bool m_measuring = false;
+        std::chrono::steady_clock::time_point m_measurement_end;
+
+        void updateDataRegisters();
+        void updateMeasurement();
+
+    protected:
+        void writeRegister(uint8_t reg, uint8_t value) override;
+        uint8_t readRegister(uint8_t reg) override;
+
+    public:
+        SimulatedBMP280();
+
+        /** Set the calibration registers */
+        void setCalibration(BMP280::Calibration const& calibration);
+
+        /** Set the raw values the device will report on its next measurement */
+        void setRawMeasurements(BMP280::RawMeasurements const& raw);
+
+        /** Set how long a measurement in forced mode takes
+         *
+         * The default is zero, that is the measurement is available immediately
+         */
+        void setMeasurementDuration(base::Time const& duration);
+    };
+}
+
+#endif
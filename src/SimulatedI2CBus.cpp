@@ -0,0 +1,196 @@
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <stdexcept>
+#include <string>
+
+using namespace i2clib;
+using namespace std;
+
+bool SimulatedRegisterDevice::autoIncrement() const
+{
+    return true;
+}
+
+void SimulatedRegisterDevice::writeRegister(uint8_t reg, uint8_t value)
+{
+    m_registers[reg] = value;
+}
+
+uint8_t SimulatedRegisterDevice::readRegister(uint8_t reg)
+{
+    return m_registers[reg];
+}
+
+void SimulatedRegisterDevice::write(uint8_t const* bytes, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    m_pointer = bytes[0];
+    for (size_t i = 1; i < size; ++i) {
+        writeRegister(m_pointer, bytes[i]);
+        if (autoIncrement()) {
+            ++m_pointer;
+        }
+    }
+}
+
+void SimulatedRegisterDevice::read(uint8_t* bytes, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = readRegister(m_pointer);
+        if (autoIncrement()) {
+            ++m_pointer;
+        }
+    }
+}
+
+uint8_t SimulatedRegisterDevice::getRegister(uint8_t reg) const
+{
+    return m_registers[reg];
+}
+
+void SimulatedRegisterDevice::setRegister(uint8_t reg, uint8_t value)
+{
+    m_registers[reg] = value;
+}
+
+void SimulatedBroadcastDevice::add(SimulatedI2CDevice& device)
+{
+    m_devices.push_back(&device);
+}
+
+void SimulatedBroadcastDevice::write(uint8_t const* bytes, size_t size)
+{
+    for (auto* device : m_devices) {
+        device->write(bytes, size);
+    }
+}
+
+void SimulatedBroadcastDevice::read(uint8_t* bytes, size_t size)
+{
+    fill(bytes, bytes + size, 0xFF);
+
+    vector<uint8_t> device_bytes(size);
+    for (auto* device : m_devices) {
+        device->read(device_bytes.data(), size);
+        for (size_t i = 0; i < size; ++i) {
+            bytes[i] &= device_bytes[i];
+        }
+    }
+}
+
+void SimulatedI2CBus::attach(uint8_t address, SimulatedI2CDevice& device)
+{
+    if (address >= m_devices.size()) {
+        throw invalid_argument("invalid i2c address " + to_string(address));
+    }
+    m_devices[address] = &device;
+}
+
+void SimulatedI2CBus::detach(uint8_t address)
+{
+    if (address < m_devices.size()) {
+        m_devices[address] = nullptr;
+    }
+}
+
+void SimulatedI2CBus::setLatency(base::Time const& transfer, base::Time const& byte)
+{
+    m_transfer_latency = transfer;
+    m_byte_latency = byte;
+}
+
+SimulatedI2CDevice& SimulatedI2CBus::resolve(uint8_t address, bool read)
+{
+    SimulatedI2CDevice* device = address < m_devices.size() ? m_devices[address] : nullptr;
+    if (device) {
+        return *device;
+    }
+
+    string message = string("failed ") + (read ? "read" : "write") + " to address " +
+                     to_string(address) + ": no device attached";
+    if (read) {
+        throw ReadError(message, ENXIO);
+    }
+    else {
+        throw WriteError(message, ENXIO);
+    }
+}
+
+uint64_t SimulatedI2CBus::getTransferCount() const
+{
+    return m_transfer_count;
+}
+
+uint64_t SimulatedI2CBus::getByteCount() const
+{
+    return m_byte_count;
+}
+
+void SimulatedI2CBus::simulateTransfer(size_t byte_count)
+{
+    ++m_transfer_count;
+    m_byte_count += byte_count;
+
+    auto duration = chrono::microseconds(m_transfer_latency.toMicroseconds() +
+                                         m_byte_latency.toMicroseconds() * byte_count);
+    if (duration.count() <= 0) {
+        return;
+    }
+
+    auto deadline = chrono::steady_clock::now() + duration;
+    while (chrono::steady_clock::now() < deadline) {
+    }
+}
+
+void SimulatedI2CBus::read(uint8_t address,
+    uint8_t* write_bytes,
+    size_t write_size,
+    uint8_t* bytes,
+    size_t size)
+{
+    auto& device = resolve(address, true);
+    simulateTransfer(2 + write_size + size);
+    device.write(write_bytes, write_size);
+    device.read(bytes, size);
+}
+
+void SimulatedI2CBus::write(uint8_t address, uint8_t* bytes, size_t size)
+{
+    auto& device = resolve(address, false);
+    simulateTransfer(1 + size);
+    device.write(bytes, size);
+}
+
+void SimulatedI2CBus::transfer(I2CTransactionBatch const& batch)
+{
+    auto const& messages = batch.messages();
+
+    size_t byte_count = 0;
+    for (auto const& m : messages) {
+        byte_count += 1 + m.size;
+    }
+    simulateTransfer(byte_count);
+
+    for (size_t i = 0; i < messages.size(); ++i) {
+        auto const& m = messages[i];
+        try {
+            auto& device = resolve(m.address, m.read);
+            if (m.read) {
+                device.read(m.buffer, m.size);
+            }
+            else {
+                device.write(m.buffer, m.size);
+            }
+        }
+        catch (IOError const& e) {
+            throw BatchError(e.what(), e.error_code, i, 1);
+        }
+    }
+}
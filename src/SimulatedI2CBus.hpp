@@ -0,0 +1,151 @@
+#ifndef I2CLIB_SIMULATEDI2CBUS_HPP
+#define I2CLIB_SIMULATEDI2CBUS_HPP
+
+#include <base/Time.hpp>
+#include <i2clib/I2CTransport.hpp>
+
+#include <array>
+#include <vector>
+
+namespace i2clib {
+    /** Model of a device attached to a SimulatedI2CBus
+     */
+    class SimulatedI2CDevice {
+    public:
+        virtual ~SimulatedI2CDevice() = default;
+
+        /** Process a write message */
+        virtual void write(uint8_t const* bytes, size_t size) = 0;
+
+        /** Process a read message */
+        virtual void read(uint8_t* bytes, size_t size) = 0;
+    };
+
+    /** Device model based on a 256-bytes register file
+     *
+     * A write sets the register pointer with its first byte, and writes the
+     * remaining bytes starting at that register. A read returns the registers
+     * starting at the register pointer. The pointer is auto-incremented after
+     * each byte, unless \c autoIncrement returns false.
+     *
+     * Subclasses customize the behavior of specific registers by overloading
+     * \c writeRegister and \c readRegister
+     */
+    class SimulatedRegisterDevice : public SimulatedI2CDevice {
+        uint8_t m_pointer = 0;
+
+    protected:
+        std::array<uint8_t, 256> m_registers{};
+
+        /** Whether the register pointer is incremented after each byte */
+        virtual bool autoIncrement() const;
+
+        /** Called for each byte written to the device */
+        virtual void writeRegister(uint8_t reg, uint8_t value);
+
+        /** Called for each byte read from the device */
+        virtual uint8_t readRegister(uint8_t reg);
+
+    public:
+        void write(uint8_t const* bytes, size_t size) override;
+        void read(uint8_t* bytes, size_t size) override;
+
+        /** Direct access to the register file, bypassing the device logic */
+        uint8_t getRegister(uint8_t reg) const;
+
+        /** Direct access to the register file, bypassing the device logic */
+        void setRegister(uint8_t reg, uint8_t value);
+    };
+
+    /** Model of a broadcast address, such as the PCA9685 ALLCALL address,
+     * that several devices answer to
+     *
+     * Writes are forwarded to all devices. Reads return the wired-AND of what
+     * all devices return, as the open-drain bus would
+     */
+    class SimulatedBroadcastDevice : public SimulatedI2CDevice {
+        std::vector<SimulatedI2CDevice*> m_devices;
+
+    public:
+        /** Add a device that answers this address
+         *
+         * This does not take ownership of the device
+         */
+        void add(SimulatedI2CDevice& device);
+
+        void write(uint8_t const* bytes, size_t size) override;
+        void read(uint8_t* bytes, size_t size) override;
+    };
+
+    /** In-process simulation of an i2c bus
+     *
+     * Devices are modelled by \c SimulatedI2CDevice objects attached to a given
+     * address. Transactions to an address that has no device attached fail the
+     * way a NAK would on a real bus (ENXIO).
+     *
+     * The latency of a real adapter can be simulated with \c setLatency. The
+     * simulated latency is a busy wait, to be representative of the timing of
+     * a real bus at the microsecond scale.
+     *
+     * This class is not thread-safe
+     */
+    class SimulatedI2CBus : public I2CTransport {
+        std::array<SimulatedI2CDevice*, 128> m_devices{};
+
+        base::Time m_transfer_latency;
+        base::Time m_byte_latency;
+
+        uint64_t m_transfer_count = 0;
+        uint64_t m_byte_count = 0;
+
+        SimulatedI2CDevice& resolve(uint8_t address, bool read);
+        void simulateTransfer(size_t byte_count);
+
+    public:
+        /** Attach a device to the given address
+         *
+         * The bus does not take ownership of the device
+         */
+        void attach(uint8_t address, SimulatedI2CDevice& device);
+
+        /** Remove the device attached to the given address, if there is one */
+        void detach(uint8_t address);
+
+        /** Configure the simulated latency
+         *
+         * @param transfer fixed cost of every transfer, i.e. of every call to
+         *   \c read, \c write or \c transfer
+         * @param byte cost of every byte transferred, including the address byte
+         *   of every message
+         */
+        void setLatency(base::Time const& transfer, base::Time const& byte = base::Time());
+
+        /** How many transfers were performed since the bus was created
+         *
+         * Every call to \c read, \c write and \c transfer is a transfer, i.e.
+         * the equivalent of a system call on a real bus
+         */
+        uint64_t getTransferCount() const;
+
+        /** How many bytes were transferred since the bus was created
+         *
+         * This includes the address byte of every message
+         */
+        uint64_t getByteCount() const;
+
+        using I2CTransport::read;
+        using I2CTransport::write;
+
+        void read(uint8_t address,
+            uint8_t* write_bytes,
+            size_t write_size,
+            uint8_t* bytes,
+            size_t size) override;
+
+        void write(uint8_t address, uint8_t* bytes, size_t size) override;
+
+        void transfer(I2CTransactionBatch const& batch) override;
+    };
+}
+
+#endif
@@ -0,0 +1,100 @@
+#include <i2clib/SimulatedMS5837.hpp>
+
+using namespace i2clib;
+using namespace std;
+
+const chrono::microseconds SimulatedMS5837::CONVERSION_TIMES[6] = {
+    chrono::microseconds(600),
+    chrono::microseconds(1170),
+    chrono::microseconds(2280),
+    chrono::microseconds(4540),
+    chrono::microseconds(9040),
+    chrono::microseconds(18080)};
+
+void SimulatedMS5837::setPROM(MS5837::PROM const& prom)
+{
+    m_prom = prom;
+    m_prom.C[0] &= 0x0FFF;
+    m_prom.C[0] |= static_cast<uint16_t>(MS5837::crc4(m_prom.C)) << 12;
+}
+
+MS5837::PROM SimulatedMS5837::getPROM() const
+{
+    return m_prom;
+}
+
+void SimulatedMS5837::setRawMeasurements(uint32_t pressure, uint32_t temperature)
+{
+    m_raw_pressure = pressure;
+    m_raw_temperature = temperature;
+}
+
+void SimulatedMS5837::setSimulateConversionTime(bool enable)
+{
+    m_simulate_conversion_time = enable;
+}
+
+void SimulatedMS5837::write(uint8_t const* bytes, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    m_command = bytes[0];
+    if (m_command == CMD_RESET) {
+        m_conversion = CONVERSION_NONE;
+        return;
+    }
+
+    bool d1 = m_command >= CMD_CONVERT_D1_BASE && m_command <= CMD_CONVERT_D1_BASE + 10;
+    bool d2 = m_command >= CMD_CONVERT_D2_BASE && m_command <= CMD_CONVERT_D2_BASE + 10;
+    if (d1 || d2) {
+        int osr = (m_command & 0x0F) / 2;
+        m_conversion = d1 ? CONVERSION_D1 : CONVERSION_D2;
+        m_conversion_end = chrono::steady_clock::now();
+        if (m_simulate_conversion_time) {
+            m_conversion_end += CONVERSION_TIMES[osr];
+        }
+    }
+}
+
+uint32_t SimulatedMS5837::readADC()
+{
+    Conversion conversion = m_conversion;
+    m_conversion = CONVERSION_NONE;
+    if (chrono::steady_clock::now() < m_conversion_end) {
+        return 0;
+    }
+
+    switch (conversion) {
+        case CONVERSION_D1:
+            return m_raw_pressure;
+        case CONVERSION_D2:
+            return m_raw_temperature;
+        default:
+            return 0;
+    }
+}
+
+void SimulatedMS5837::read(uint8_t* bytes, size_t size)
+{
+    uint8_t result[3] = {0, 0, 0};
+    size_t result_size = 0;
+    if (m_command == CMD_ADC_READ) {
+        uint32_t adc = readADC();
+        result[0] = adc >> 16;
+        result[1] = adc >> 8;
+        result[2] = adc;
+        result_size = 3;
+    }
+    else if (m_command >= CMD_PROM_READ_BASE && m_command < CMD_PROM_READ_BASE + 14) {
+        uint16_t word = m_prom.C[(m_command - CMD_PROM_READ_BASE) / 2];
+        result[0] = word >> 8;
+        result[1] = word;
+        result_size = 2;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = i < result_size ? result[i] : 0;
+    }
+}
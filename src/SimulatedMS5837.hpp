@@ -0,0 +1,71 @@
+#ifndef I2CLIB_SIMULATEDMS5837_HPP
+#define I2CLIB_SIMULATEDMS5837_HPP
+
+#include <i2clib/MS5837.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+
+#include <chrono>
+
+namespace i2clib {
+    /** Command-level model of the MS5837
+     *
+     * It models the PROM read, conversion and ADC read commands. As on the real
+     * chip, reading the ADC while a conversion is in progress, or without having
+     * started one, returns zero. The conversion durations are the maximum values
+     * from the datasheet.
+     */
+    class SimulatedMS5837 : public SimulatedI2CDevice {
+    public:
+        static constexpr uint8_t CMD_RESET = 0x1e;
+        static constexpr uint8_t CMD_CONVERT_D1_BASE = 0x40;
+        static constexpr uint8_t CMD_CONVERT_D2_BASE = 0x50;
+        static constexpr uint8_t CMD_ADC_READ = 0x00;
+        static constexpr uint8_t CMD_PROM_READ_BASE = 0xA0;
+
+        /** Maximum conversion times from the datasheet, indexed by OSR */
+        static const std::chrono::microseconds CONVERSION_TIMES[6];
+
+    private:
+        enum Conversion {
+            CONVERSION_NONE,
+            CONVERSION_D1,
+            CONVERSION_D2
+        };
+
+        MS5837::PROM m_prom{};
+        uint32_t m_raw_pressure = 0;
+        uint32_t m_raw_temperature = 0;
+        bool m_simulate_conversion_time = true;
+
+        uint8_t m_command = CMD_RESET;
+        Conversion m_conversion = CONVERSION_NONE;
+        std::chrono::steady_clock::time_point m_conversion_end;
+
+        uint32_t readADC();
+
+    public:
+        /** Set the PROM contents
+         *
+         * The CRC stored in C[0] is computed from the other coefficients
+         */
+        void setPROM(MS5837::PROM const& prom);
+
+        /** The PROM contents, including the CRC */
+        MS5837::PROM getPROM() const;
+
+        /** Set the raw values the device will report (D1 and D2) */
+        void setRawMeasurements(uint32_t pressure, uint32_t temperature);
+
+        /** Whether conversions take time
+         *
+         * If false, the result of a conversion is available immediately. This is
+         * meant for benchmarks that only measure the software overhead.
+         */
+        void setSimulateConversionTime(bool enable);
+
+        void write(uint8_t const* bytes, size_t size) override;
+        void read(uint8_t* bytes, size_t size) override;
+    };
+}
+
+#endif
@@ -0,0 +1,66 @@
+#include <i2clib/SimulatedPCA9685.hpp>
+
+using namespace i2clib;
+
+SimulatedPCA9685::SimulatedPCA9685()
+{
+    m_registers[REGISTER_MODE1] = MODE1_SLEEP | 0x01;
+    m_registers[REGISTER_MODE2] = 0x04;
+    for (int i = 0; i < PWM_COUNT; ++i) {
+        m_registers[REGISTER_PWM_BEGIN + i * 4 + 3] = 0x10;
+    }
+    m_registers[REGISTER_PRESCALE] = 0x1E;
+}
+
+bool SimulatedPCA9685::autoIncrement() const
+{
+    return m_registers[REGISTER_MODE1] & MODE1_AUTO_INCREMENT_ENABLED;
+}
+
+void SimulatedPCA9685::writeRegister(uint8_t reg, uint8_t value)
+{
+    if (reg >= REGISTER_ALL_LED_BEGIN && reg < REGISTER_PRESCALE) {
+        int offset = reg - REGISTER_ALL_LED_BEGIN;
+        for (int i = 0; i < PWM_COUNT; ++i) {
+            m_registers[REGISTER_PWM_BEGIN + i * 4 + offset] = value;
+        }
+    }
+    else if (reg == REGISTER_PRESCALE) {
+        if (m_registers[REGISTER_MODE1] & MODE1_SLEEP) {
+            m_registers[reg] = value;
+        }
+    }
+    else if (reg == REGISTER_MODE1) {
+        m_registers[reg] = value & ~MODE1_RESTART;
+    }
+    else {
+        m_registers[reg] = value;
+    }
+}
+
+uint8_t SimulatedPCA9685::readRegister(uint8_t reg)
+{
+    if (reg >= REGISTER_ALL_LED_BEGIN && reg < REGISTER_PRESCALE) {
+        return 0;
+    }
+    return m_registers[reg];
+}
+
+PCA9685PWMConfiguration SimulatedPCA9685::getPWMConfiguration(int channel) const
+{
+    uint8_t const* registers = m_registers.data() + REGISTER_PWM_BEGIN + channel * 4;
+
+    PCA9685PWMConfiguration result;
+    if (registers[3] & 0x10) {
+        result.mode = PCA9685PWMConfiguration::MODE_OFF;
+    }
+    else if (registers[1] & 0x10) {
+        result.mode = PCA9685PWMConfiguration::MODE_ON;
+    }
+    else {
+        result.mode = PCA9685PWMConfiguration::MODE_NORMAL;
+        result.on_edge = registers[0] | (registers[1] & 0x0F) << 8;
+        result.off_edge = registers[2] | (registers[3] & 0x0F) << 8;
+    }
+    return result;
+}
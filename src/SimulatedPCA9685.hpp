@@ -0,0 +1,42 @@
+#ifndef I2CLIB_SIMULATEDPCA9685_HPP
+#define I2CLIB_SIMULATEDPCA9685_HPP
+
+#include <i2clib/PCA9685PWMConfiguration.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+
+namespace i2clib {
+    /** Register-level model of the PCA9685
+     *
+     * It models the register file in its power-on state, the auto-increment
+     * function of MODE1, the ALL_LED registers and the fact that the prescale
+     * register can only be written in sleep mode. It does not model the PWM
+     * generation itself.
+     */
+    class SimulatedPCA9685 : public SimulatedRegisterDevice {
+    public:
+        static constexpr uint8_t REGISTER_MODE1 = 0x00;
+        static constexpr uint8_t REGISTER_MODE2 = 0x01;
+        static constexpr uint8_t REGISTER_PWM_BEGIN = 0x06;
+        static constexpr uint8_t REGISTER_ALL_LED_BEGIN = 0xFA;
+        static constexpr uint8_t REGISTER_PRESCALE = 0xFE;
+
+        static constexpr uint8_t MODE1_SLEEP = 1 << 4;
+        static constexpr uint8_t MODE1_AUTO_INCREMENT_ENABLED = 1 << 5;
+        static constexpr uint8_t MODE1_RESTART = 1 << 7;
+
+        static constexpr int PWM_COUNT = 16;
+
+    protected:
+        bool autoIncrement() const override;
+        void writeRegister(uint8_t reg, uint8_t value) override;
+        uint8_t readRegister(uint8_t reg) override;
+
+    public:
+        SimulatedPCA9685();
+
+        /** Decode the PWM registers of the given channel */
+        PCA9685PWMConfiguration getPWMConfiguration(int channel) const;
+    };
+}
+
+#endif
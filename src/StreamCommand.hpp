@@ -0,0 +1,216 @@
+#ifndef I2CLIB_STREAMCOMMAND_HPP
+#define I2CLIB_STREAMCOMMAND_HPP
+
+#include <i2clib/Exceptions.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+/** Implementation of the `stream` command shared by the sensor ctl tools
+ *
+ * This is not part of the library's installed headers
+ */
+namespace i2clib {
+    namespace stream {
+        enum Format { FORMAT_CSV, FORMAT_BINARY };
+
+        struct Options {
+            /** Requested sample rate in Hz */
+            double rate = 0;
+            /** Number of samples to acquire */
+            uint64_t count = 0;
+            Format format = FORMAT_CSV;
+        };
+
+        struct Sample {
+            double pressure_pa = 0;
+            double temperature_c = 0;
+        };
+
+        /** Size of a record in the binary format
+         *
+         * The fields are in the host byte order: the sample index (uint32),
+         * the start of the acquisition in microseconds since the start of the
+         * stream (int64), the pressure in Pa and the temperature in degrees
+         * Celsius (both float64). Failed acquisitions have no record, which
+         * shows as a gap in the indexes
+         */
+        static constexpr size_t BINARY_RECORD_SIZE = 4 + 8 + 8 + 8;
+
+        struct Summary {
+            uint64_t samples = 0;
+            uint64_t errors = 0;
+            /** Acquisitions that started more than one period late */
+            uint64_t overruns = 0;
+            /** Time between the first acquisition start and the last
+             * acquisition end */
+            double duration = 0;
+            /** Acquisitions per second, from the first to the last acquisition
+             * start */
+            double achieved_rate = 0;
+            /** Mean and standard deviation of the difference between the
+             * interval between successive samples and the period, in seconds */
+            double jitter_mean = 0;
+            double jitter_stddev = 0;
+            /** Largest absolute difference between the interval between
+             * successive samples and the period, in seconds */
+            double jitter_max = 0;
+        };
+
+        inline Format parseFormat(std::string const& name)
+        {
+            if (name == "csv") {
+                return FORMAT_CSV;
+            }
+            else if (name == "binary") {
+                return FORMAT_BINARY;
+            }
+            throw std::invalid_argument("unknown stream format '" + name +
+                                        "', expected csv or binary");
+        }
+
+        inline void writeRecord(std::ostream& out,
+            Format format,
+            uint32_t index,
+            int64_t time_us,
+            Sample const& sample)
+        {
+            if (format == FORMAT_CSV) {
+                out << index << "," << time_us << "," << sample.pressure_pa << ","
+                    << sample.temperature_c << "\n";
+                return;
+            }
+
+            char record[BINARY_RECORD_SIZE];
+            std::memcpy(record, &index, 4);
+            std::memcpy(record + 4, &time_us, 8);
+            std::memcpy(record + 12, &sample.pressure_pa, 8);
+            std::memcpy(record + 20, &sample.temperature_c, 8);
+            out.write(record, BINARY_RECORD_SIZE);
+        }
+
+        /** Acquire samples at a fixed rate and write them to \c out
+         *
+         * Acquisitions are scheduled on absolute deadlines, so that the rate
+         * does not drift. An acquisition that starts more than a period late
+         * is counted as an overrun, and the schedule restarts from it.
+         * Acquisitions that fail with an IOError are counted and skipped
+         */
+        inline Summary run(Options const& options,
+            std::function<Sample()> const& acquire,
+            std::ostream& out)
+        {
+            using clock = std::chrono::steady_clock;
+            auto period = std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<double>(1 / options.rate));
+
+            if (options.format == FORMAT_CSV) {
+                out.precision(10);
+                out << "index,time_us,pressure_pa,temperature_c\n";
+            }
+
+            Summary summary;
+            double jitter_m2 = 0;
+            uint64_t intervals = 0;
+            double period_s = 1 / options.rate;
+
+            auto start = clock::now();
+            auto deadline = start;
+            auto last_start = start;
+            auto end = start;
+            for (uint64_t i = 0; i < options.count; ++i) {
+                std::this_thread::sleep_until(deadline);
+                auto sample_start = clock::now();
+                if (sample_start - deadline > period) {
+                    ++summary.overruns;
+                    deadline = sample_start;
+                }
+                deadline += period;
+
+                if (i > 0) {
+                    // Welford's online mean and variance
+                    double interval =
+                        std::chrono::duration<double>(sample_start - last_start).count();
+                    double deviation = interval - period_s;
+                    ++intervals;
+                    double delta = deviation - summary.jitter_mean;
+                    summary.jitter_mean += delta / intervals;
+                    jitter_m2 += delta * (deviation - summary.jitter_mean);
+                    summary.jitter_max = std::max(summary.jitter_max, std::abs(deviation));
+                }
+                last_start = sample_start;
+
+                try {
+                    Sample sample = acquire();
+                    auto time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        sample_start - start);
+                    writeRecord(out, options.format, i, time_us.count(), sample);
+                    ++summary.samples;
+                }
+                catch (IOError const& e) {
+                    std::cerr << "sample " << i << ": " << e.what() << "\n";
+                    ++summary.errors;
+                }
+                end = clock::now();
+            }
+            out.flush();
+
+            summary.duration = std::chrono::duration<double>(end - start).count();
+            double span = std::chrono::duration<double>(last_start - start).count();
+            if (span > 0) {
+                summary.achieved_rate = intervals / span;
+            }
+            if (intervals > 1) {
+                summary.jitter_stddev = std::sqrt(jitter_m2 / (intervals - 1));
+            }
+            return summary;
+        }
+
+        inline void printSummary(Options const& options,
+            Summary const& summary,
+            std::ostream& io)
+        {
+            io << "samples: " << summary.samples << "/" << options.count << "\n"
+               << "errors: " << summary.errors << "\n"
+               << "overruns: " << summary.overruns << "\n"
+               << "duration: " << summary.duration << " s\n"
+               << "requested rate: " << options.rate << " Hz\n"
+               << "achieved rate: " << summary.achieved_rate << " Hz\n"
+               << "jitter: mean " << summary.jitter_mean * 1e6 << " us, stddev "
+               << summary.jitter_stddev * 1e6 << " us, max "
+               << summary.jitter_max * 1e6 << " us" << std::endl;
+        }
+
+        /** Parse the RATE, COUNT and FORMAT arguments of the stream command
+         *
+         * @throw std::invalid_argument if they are invalid
+         */
+        inline Options parseOptions(std::string const& rate,
+            std::string const& count,
+            std::string const& format)
+        {
+            Options options;
+            options.rate = std::stod(rate);
+            long long parsed_count = std::stoll(count);
+            if (!(options.rate > 0) || std::isinf(options.rate)) {
+                throw std::invalid_argument("the stream rate must be strictly positive");
+            }
+            else if (parsed_count <= 0) {
+                throw std::invalid_argument("the sample count must be strictly positive");
+            }
+            options.count = parsed_count;
+            options.format = parseFormat(format);
+            return options;
+        }
+    }
+}
+
+#endif
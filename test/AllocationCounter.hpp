@@ -0,0 +1,17 @@
+#ifndef I2CLIB_TEST_ALLOCATIONCOUNTER_HPP
+#define I2CLIB_TEST_ALLOCATIONCOUNTER_HPP
+
+#include <cstdint>
+
+namespace i2clib {
+    namespace tests {
+        /** Number of calls to operator new since the start of the program
+         *
+         * It is counted by the replacement operator new in
+         * AllocationCounter.cpp, which must be linked into the program
+         */
+        std::uint64_t allocationCount();
+    }
+}
+
+#endif
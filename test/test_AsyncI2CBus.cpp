@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <i2clib/AsyncI2CBus.hpp>
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace i2clib;
+
+struct AsyncI2CBusTest : public ::testing::Test {
+    SimulatedRegisterDevice device;
+    SimulatedI2CBus* simulated_bus = new SimulatedI2CBus();
+    std::unique_ptr<AsyncI2CBus> bus;
+
+    AsyncI2CBusTest()
+    {
+        simulated_bus->attach(0x40, device);
+        bus.reset(new AsyncI2CBus(std::unique_ptr<I2CTransport>(simulated_bus)));
+    }
+};
+
+TEST_F(AsyncI2CBusTest, it_provides_blocking_read_and_write)
+{
+    bus->write(0x40, {0x10, 1, 2});
+    auto bytes = bus->read<2>(0x40, 0x10);
+    ASSERT_EQ(1, bytes[0]);
+    ASSERT_EQ(2, bytes[1]);
+}
+
+TEST_F(AsyncI2CBusTest, it_reports_errors_of_blocking_calls_as_read_and_write_errors)
+{
+    ASSERT_THROW(bus->write(0x41, {0x10, 1, 2}), WriteError);
+    ASSERT_THROW(bus->read<2>(0x41, 0x10), ReadError);
+}
+
+TEST_F(AsyncI2CBusTest, it_completes_submissions_through_futures)
+{
+    uint8_t write_bytes[] = {0x10, 42};
+    uint8_t read_bytes[1] = {0};
+    I2CTransactionBatch batch;
+    batch.write(0x40, write_bytes, 2);
+    batch.read(0x40, write_bytes, 1, read_bytes, 1);
+
+    auto result = bus->submit(batch);
+    result.get();
+    ASSERT_EQ(42, read_bytes[0]);
+
+    I2CTransactionBatch failing;
+    failing.write(0x41, write_bytes, 2);
+    ASSERT_THROW(bus->submit(failing).get(), BatchError);
+}
+
+TEST_F(AsyncI2CBusTest, it_performs_higher_priority_submissions_first)
+{
+    uint8_t write_bytes[] = {0x10, 42};
+    I2CTransactionBatch batch;
+    batch.write(0x40, write_bytes, 2);
+
+    std::mutex mutex;
+    std::vector<int> order;
+    auto record = [&](int i) {
+        return [&, i](std::exception_ptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(i);
+        };
+    };
+
+    // Block the worker in the callback of the first submission while we queue
+    // the others
+    std::promise<void> started;
+    std::promise<void> release;
+    auto released = release.get_future();
+    bus->submit(batch, AsyncI2CBus::PRIORITY_LOW, [&](std::exception_ptr error) {
+        record(0)(error);
+        started.set_value();
+        released.wait();
+    });
+    started.get_future().wait();
+
+    bus->submit(batch, AsyncI2CBus::PRIORITY_LOW, record(1));
+    bus->submit(batch, AsyncI2CBus::PRIORITY_NORMAL, record(2));
+    bus->submit(batch, AsyncI2CBus::PRIORITY_HIGH, record(3));
+    auto last = bus->submit(batch, AsyncI2CBus::PRIORITY_LOW);
+    release.set_value();
+    last.get();
+
+    ASSERT_EQ((std::vector<int>{0, 3, 2, 1}), order);
+}
+
+TEST_F(AsyncI2CBusTest, it_provides_transports_bound_to_a_priority)
+{
+    auto& high = bus->withPriority(AsyncI2CBus::PRIORITY_HIGH);
+    high.write(0x40, {0x10, 1});
+    ASSERT_EQ(1, high.read<1>(0x40, 0x10)[0]);
+}
+
+TEST_F(AsyncI2CBusTest, it_fails_pending_submissions_on_destruction)
+{
+    simulated_bus->setLatency(base::Time::fromMilliseconds(5));
+
+    uint8_t write_bytes[] = {0x10, 42};
+    I2CTransactionBatch batch;
+    batch.write(0x40, write_bytes, 2);
+
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < 10; ++i) {
+        results.push_back(bus->submit(batch));
+    }
+    bus.reset();
+
+    ASSERT_THROW(results.back().get(), IOError);
+}
+
+TEST_F(AsyncI2CBusTest, it_calls_the_callbacks_of_failed_submissions_from_the_worker)
+{
+    simulated_bus->setLatency(base::Time::fromMilliseconds(5));
+
+    uint8_t write_bytes[] = {0x10, 42};
+    I2CTransactionBatch batch;
+    batch.write(0x40, write_bytes, 2);
+
+    std::mutex mutex;
+    std::vector<std::thread::id> threads;
+    std::exception_ptr last_error;
+    for (int i = 0; i < 10; ++i) {
+        bus->submit(batch, AsyncI2CBus::PRIORITY_NORMAL, [&](std::exception_ptr error) {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.push_back(std::this_thread::get_id());
+            last_error = error;
+        });
+    }
+    bus.reset();
+
+    ASSERT_EQ(10, threads.size());
+    ASSERT_TRUE(last_error);
+    for (auto const& id : threads) {
+        ASSERT_NE(std::this_thread::get_id(), id);
+    }
+}
@@ -1,29 +1,98 @@
 #include <gtest/gtest.h>
 #include <i2clib/BMP280.hpp>
+#include <i2clib/CalibrationCache.hpp>
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/SimulatedBMP280.hpp>
+
+#include <random>
+#include <vector>
 
 using namespace i2clib;
 
+// Bosch's reference implementation, from the datasheet
+typedef int32_t BMP280_S32_t;
+typedef uint32_t BMP280_U32_t;
+
+static BMP280_S32_t bmp280_compensate_T_int32(BMP280_S32_t adc_T,
+    BMP280::Calibration const& c,
+    BMP280_S32_t& t_fine)
+{
+    BMP280_S32_t var1, var2, T;
+    var1 = ((((adc_T >> 3) - ((BMP280_S32_t)c.dig_T1 << 1))) * ((BMP280_S32_t)c.dig_T2)) >> 11;
+    var2 = (((((adc_T >> 4) - ((BMP280_S32_t)c.dig_T1)) *
+                 ((adc_T >> 4) - ((BMP280_S32_t)c.dig_T1))) >>
+                12) *
+               ((BMP280_S32_t)c.dig_T3)) >>
+           14;
+    t_fine = var1 + var2;
+    T = (t_fine * 5 + 128) >> 8;
+    return T;
+}
+
+static BMP280_U32_t bmp280_compensate_P_int32(BMP280_S32_t adc_P,
+    BMP280::Calibration const& c,
+    BMP280_S32_t t_fine)
+{
+    BMP280_S32_t var1, var2;
+    BMP280_U32_t p;
+    var1 = (((BMP280_S32_t)t_fine) >> 1) - (BMP280_S32_t)64000;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((BMP280_S32_t)c.dig_P6);
+    var2 = var2 + ((var1 * ((BMP280_S32_t)c.dig_P5)) << 1);
+    var2 = (var2 >> 2) + (((BMP280_S32_t)c.dig_P4) << 16);
+    var1 = (((c.dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) +
+               ((((BMP280_S32_t)c.dig_P2) * var1) >> 1)) >>
+           18;
+    var1 = ((((32768 + var1)) * ((BMP280_S32_t)c.dig_P1)) >> 15);
+    if (var1 == 0) {
+        return 0;
+    }
+    p = (((BMP280_U32_t)(((BMP280_S32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
+    if (p < 0x80000000) {
+        p = (p << 1) / ((BMP280_U32_t)var1);
+    }
+    else {
+        p = (p / (BMP280_U32_t)var1) * 2;
+    }
+    var1 = (((BMP280_S32_t)c.dig_P9) * ((BMP280_S32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+    var2 = (((BMP280_S32_t)(p >> 2)) * ((BMP280_S32_t)c.dig_P8)) >> 13;
+    p = (BMP280_U32_t)((BMP280_S32_t)p + ((var1 + var2 + c.dig_P7) >> 4));
+    return p;
+}
+
 struct BMP280Test : public ::testing::Test {
+    BMP280::Calibration calibration;
+
+    BMP280Test()
+    {
+        calibration.dig_T1 = 27504;
+        calibration.dig_T2 = 26435;
+        calibration.dig_T3 = -1000;
+        calibration.dig_P1 = 36477;
+        calibration.dig_P2 = -10685;
+        calibration.dig_P3 = 3024;
+        calibration.dig_P4 = 2855;
+        calibration.dig_P5 = 140;
+        calibration.dig_P6 = -7;
+        calibration.dig_P7 = 15500;
+        calibration.dig_P8 = -14600;
+        calibration.dig_P9 = 6000;
+    }
+
+    static void assertCalibrationEq(BMP280::Calibration const& expected,
+        BMP280::Calibration const& actual)
+    {
+        ASSERT_EQ(expected.dig_T1, actual.dig_T1);
+        ASSERT_EQ(expected.dig_T2, actual.dig_T2);
+        ASSERT_EQ(expected.dig_T3, actual.dig_T3);
+        ASSERT_EQ(expected.dig_P1, actual.dig_P1);
+        ASSERT_EQ(expected.dig_P9, actual.dig_P9);
+    }
 };
 
 TEST_F(BMP280Test, it_performs_conversion_according_to_the_datasheet) {
     // The datasheet has an example conversion. This test makes sure our implementation
     // matches that example
 
-    BMP280::Calibration calibration;
-    calibration.dig_T1 = 27504;
-    calibration.dig_T2 = 26435;
-    calibration.dig_T3 = -1000;
-    calibration.dig_P1 = 36477;
-    calibration.dig_P2 = -10685;
-    calibration.dig_P3 = 3024;
-    calibration.dig_P4 = 2855;
-    calibration.dig_P5 = 140;
-    calibration.dig_P6 = -7;
-    calibration.dig_P7 = 15500;
-    calibration.dig_P8 = -14600;
-    calibration.dig_P9 = 6000;
-
     int32_t raw_T = 519888;
     int32_t raw_P = 415148;
 
@@ -32,4 +101,256 @@ TEST_F(BMP280Test, it_performs_conversion_according_to_the_datasheet) {
 
     ASSERT_NEAR(25.08, temperature.first.getCelsius(), 1e-2);
     ASSERT_NEAR(100653, pressure.toPa(), 10);
-}
\ No newline at end of file
+}
+
+TEST_F(BMP280Test, it_compensates_batches_bit_exactly_with_the_reference) {
+    // Calibrations and raw values are drawn around the datasheet example, in
+    // the range where the reference code does not overflow
+    std::mt19937 rng(42);
+    auto perturbate = [&rng](int value, float ratio) {
+        std::uniform_real_distribution<float> distribution(1 - ratio, 1 + ratio);
+        return static_cast<int>(value * distribution(rng));
+    };
+    std::uniform_int_distribution<int32_t> raw_T_distribution(350000, 650000);
+    std::uniform_int_distribution<int32_t> raw_P_distribution(100000, 700000);
+
+    for (int trial = 0; trial < 20; ++trial) {
+        BMP280::Calibration c = calibration;
+        c.dig_T1 = perturbate(c.dig_T1, 0.05);
+        c.dig_T2 = perturbate(c.dig_T2, 0.05);
+        c.dig_T3 = perturbate(c.dig_T3, 0.5);
+        c.dig_P1 = perturbate(c.dig_P1, 0.05);
+        c.dig_P2 = perturbate(c.dig_P2, 0.2);
+        c.dig_P3 = perturbate(c.dig_P3, 0.2);
+        c.dig_P4 = perturbate(c.dig_P4, 0.5);
+        c.dig_P5 = perturbate(c.dig_P5, 0.5);
+        c.dig_P6 = perturbate(c.dig_P6, 0.5);
+        c.dig_P7 = perturbate(c.dig_P7, 0.2);
+        c.dig_P8 = perturbate(c.dig_P8, 0.2);
+        c.dig_P9 = perturbate(c.dig_P9, 0.2);
+
+        // Odd size to exercise the scalar tail of the SIMD implementations
+        size_t count = 1021;
+        std::vector<int32_t> raw_T(count), raw_P(count);
+        std::vector<int32_t> expected_T(count);
+        std::vector<uint32_t> expected_P(count);
+        for (size_t i = 0; i < count; ++i) {
+            raw_T[i] = raw_T_distribution(rng);
+            raw_P[i] = raw_P_distribution(rng);
+            int32_t t_fine;
+            expected_T[i] = bmp280_compensate_T_int32(raw_T[i], c, t_fine);
+            expected_P[i] = bmp280_compensate_P_int32(raw_P[i], c, t_fine);
+            ASSERT_EQ(t_fine, BMP280::compensate_T_int32(raw_T[i], c).second);
+        }
+
+        for (auto implementation : {BMP280::BATCH_AUTO,
+                 BMP280::BATCH_SCALAR,
+                 BMP280::BATCH_SSE41,
+                 BMP280::BATCH_AVX2,
+                 BMP280::BATCH_NEON}) {
+            if (!BMP280::hasBatchImplementation(implementation)) {
+                continue;
+            }
+
+            std::vector<int32_t> T(count);
+            std::vector<uint32_t> P(count);
+            BMP280::compensateBatch(
+                count, raw_T.data(), raw_P.data(), c, T.data(), P.data(), implementation);
+            ASSERT_EQ(expected_T, T) << "implementation " << implementation;
+            ASSERT_EQ(expected_P, P) << "implementation " << implementation;
+        }
+    }
+}
+
+TEST_F(BMP280Test, it_returns_zero_in_batches_if_the_calibration_leads_to_a_division_by_zero) {
+    calibration.dig_P1 = 0;
+    std::vector<int32_t> raw_T(16, 519888), raw_P(16, 415148);
+    std::vector<int32_t> T(16);
+    std::vector<uint32_t> P(16, 1);
+    BMP280::compensateBatch(16, raw_T.data(), raw_P.data(), calibration, T.data(), P.data());
+    ASSERT_EQ(std::vector<uint32_t>(16, 0), P);
+    ASSERT_EQ(2508, T[0]);
+}
+
+TEST_F(BMP280Test, it_reads_and_compensates_the_measurements_from_the_chip) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setCalibration(calibration);
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+
+    BMP280 chip(bus, 0x76);
+    ASSERT_EQ(0x58, chip.readID());
+    chip.writeMode(BMP280::MODE_FORCED);
+    auto measurement = chip.read();
+
+    ASSERT_NEAR(25.08, measurement.temperature.getCelsius(), 1e-2);
+    ASSERT_NEAR(100653, measurement.pressure.toPa(), 10);
+}
+
+TEST_F(BMP280Test, it_computes_the_measurement_duration_from_the_datasheet) {
+    // "Ultra high resolution" setting of table 13
+    BMP280Configuration conf;
+    conf.temperature_oversampling = BMP280Configuration::OVERSAMPLING_2;
+    conf.pressure_oversampling = BMP280Configuration::OVERSAMPLING_16;
+
+    ASSERT_EQ(37500, BMP280::measurementDuration(conf).toMicroseconds());
+    ASSERT_EQ(43225, BMP280::measurementDuration(conf, true).toMicroseconds());
+}
+
+TEST_F(BMP280Test, it_triggers_a_forced_measurement_and_waits_for_its_end) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setCalibration(calibration);
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+    device.setMeasurementDuration(base::Time::fromMicroseconds(5800));
+
+    BMP280 chip(bus, 0x76);
+    auto measurement = chip.readForced();
+    ASSERT_NEAR(25.08, measurement.temperature.getCelsius(), 1e-2);
+    ASSERT_NEAR(100653, measurement.pressure.toPa(), 10);
+    ASSERT_EQ(0, chip.readStatus());
+}
+
+TEST_F(BMP280Test, it_fails_if_the_forced_measurement_does_not_finish) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setMeasurementDuration(base::Time::fromMilliseconds(100));
+
+    BMP280 chip(bus, 0x76);
+    ASSERT_THROW(chip.readForced(), ReadError);
+}
+
+TEST_F(BMP280Test, it_reads_a_forced_measurement_that_ends_just_before_the_maximum_duration) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setCalibration(calibration);
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+    // The maximum duration of the default configuration is 6425us
+    device.setMeasurementDuration(base::Time::fromMicroseconds(6300));
+
+    BMP280 chip(bus, 0x76);
+    auto measurement = chip.readForced();
+    ASSERT_NEAR(25.08, measurement.temperature.getCelsius(), 1e-2);
+}
+
+TEST_F(BMP280Test, it_rejects_forced_measurements_without_polls) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+
+    BMP280 chip(bus, 0x76);
+    auto transfers = bus.getTransferCount();
+    ASSERT_THROW(chip.readForced(0), std::invalid_argument);
+    ASSERT_EQ(transfers, bus.getTransferCount());
+}
+
+TEST_F(BMP280Test, it_timestamps_forced_measurements_with_the_measurement_window) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setCalibration(calibration);
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+    device.setMeasurementDuration(base::Time::fromMicroseconds(5800));
+    bus.setLatency(base::Time::fromMicroseconds(200));
+
+    BMP280 chip(bus, 0x76);
+    auto before = base::Time::now();
+    auto measurement = chip.readForced();
+    auto after = base::Time::now();
+
+    auto window = measurement.acquisition_end - measurement.acquisition_start;
+    // The end of the window is sampled before the status read, which has its
+    // own latency
+    ASSERT_GE(window.toMicroseconds(), 5800 - 200);
+    ASSERT_LT(window.toMicroseconds(), 7000);
+    ASSERT_LT(before, measurement.acquisition_start);
+    ASSERT_LT(measurement.acquisition_end, after);
+    ASSERT_GE(measurement.transport_latency.toMicroseconds(), 200);
+}
+
+TEST_F(BMP280Test, it_initializes_and_acquires_a_first_measurement_in_two_transfers) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setCalibration(calibration);
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+
+    BMP280Measurement measurement;
+    auto chip = BMP280::fastInit(bus, 0x76, BMP280Configuration(), measurement);
+    ASSERT_EQ(2, bus.getTransferCount());
+    assertCalibrationEq(calibration, chip.getCalibration());
+    ASSERT_NEAR(25.08, measurement.temperature.getCelsius(), 1e-2);
+    ASSERT_NEAR(100653, measurement.pressure.toPa(), 10);
+}
+
+TEST_F(BMP280Test, it_skips_the_calibration_read_if_it_is_cached) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setCalibration(calibration);
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+
+    CalibrationCache cache;
+    BMP280Measurement measurement;
+    BMP280::fastInit(bus, 0x76, BMP280Configuration(), measurement, &cache, "/dev/i2c-1");
+    uint64_t cold_bytes = bus.getByteCount();
+
+    auto chip = BMP280::fastInit(bus, 0x76, BMP280Configuration(), measurement, &cache,
+        "/dev/i2c-1");
+    ASSERT_EQ(4, bus.getTransferCount());
+    ASSERT_EQ(cold_bytes - 22, bus.getByteCount() - cold_bytes);
+    assertCalibrationEq(calibration, chip.getCalibration());
+    ASSERT_NEAR(100653, measurement.pressure.toPa(), 10);
+}
+
+TEST_F(BMP280Test, it_reads_the_calibration_again_if_the_cached_one_does_not_match) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setCalibration(calibration);
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+
+    CalibrationCache cache;
+    BMP280Measurement measurement;
+    BMP280::fastInit(bus, 0x76, BMP280Configuration(), measurement, &cache, "/dev/i2c-1");
+
+    auto modified = calibration;
+    modified.dig_T1 += 1;
+    device.setCalibration(modified);
+    auto chip = BMP280::fastInit(bus, 0x76, BMP280Configuration(), measurement, &cache,
+        "/dev/i2c-1");
+    assertCalibrationEq(modified, chip.getCalibration());
+
+}
+
+TEST_F(BMP280Test, it_rejects_a_chip_that_is_not_a_BMP280_on_fast_init) {
+    SimulatedI2CBus bus;
+    SimulatedBMP280 device;
+    bus.attach(0x76, device);
+    device.setCalibration(calibration);
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+
+    CalibrationCache cache;
+    BMP280Measurement measurement;
+    BMP280::fastInit(bus, 0x76, BMP280Configuration(), measurement, &cache, "/dev/i2c-1");
+    std::vector<uint8_t> entry;
+    ASSERT_TRUE(cache.get(CalibrationCache::key("bmp280", "/dev/i2c-1", 0x76), entry));
+
+    device.setRegister(SimulatedBMP280::REGISTER_ID, 0x60);
+    ASSERT_THROW(BMP280::fastInit(bus, 0x76, BMP280Configuration(), measurement, &cache,
+                     "/dev/i2c-1"),
+        ReadError);
+    std::vector<uint8_t> unchanged;
+    ASSERT_TRUE(cache.get(CalibrationCache::key("bmp280", "/dev/i2c-1", 0x76), unchanged));
+    ASSERT_EQ(entry, unchanged);
+
+    CalibrationCache cold_cache;
+    ASSERT_THROW(BMP280::fastInit(bus, 0x76, BMP280Configuration(), measurement,
+                     &cold_cache, "/dev/i2c-1"),
+        ReadError);
+    ASSERT_FALSE(cold_cache.get(CalibrationCache::key("bmp280", "/dev/i2c-1", 0x76), entry));
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <i2clib/CalibrationCache.hpp>
+
+#include <cstdio>
+#include <fstream>
+
+using namespace i2clib;
+
+struct CalibrationCacheTest : public ::testing::Test {
+    std::string path = ::testing::TempDir() + "i2clib_calibration_cache_test";
+
+    CalibrationCacheTest()
+    {
+        std::remove(path.c_str());
+    }
+
+    ~CalibrationCacheTest()
+    {
+        std::remove(path.c_str());
+    }
+};
+
+TEST_F(CalibrationCacheTest, it_builds_keys_from_the_driver_bus_and_address) {
+    ASSERT_EQ("bmp280@/dev/i2c-1:0x76", CalibrationCache::key("bmp280", "/dev/i2c-1", 0x76));
+}
+
+TEST_F(CalibrationCacheTest, it_stores_entries_in_memory) {
+    CalibrationCache cache;
+    std::vector<uint8_t> data{1, 2, 3};
+    ASSERT_FALSE(cache.get("a", data));
+    ASSERT_EQ(3, data.size());
+
+    cache.set("a", {4, 5});
+    ASSERT_TRUE(cache.get("a", data));
+    ASSERT_EQ((std::vector<uint8_t>{4, 5}), data);
+
+    cache.erase("a");
+    ASSERT_FALSE(cache.get("a", data));
+}
+
+TEST_F(CalibrationCacheTest, it_persists_entries_in_a_file) {
+    {
+        CalibrationCache cache(path);
+        cache.set("bmp280@/dev/i2c 1:0x76", {0x58, 0xab, 0x00});
+        cache.set("ms5837@/dev/i2c-1:0x76", {});
+    }
+
+    CalibrationCache cache(path);
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(cache.get("bmp280@/dev/i2c 1:0x76", data));
+    ASSERT_EQ((std::vector<uint8_t>{0x58, 0xab, 0x00}), data);
+    ASSERT_TRUE(cache.get("ms5837@/dev/i2c-1:0x76", data));
+    ASSERT_TRUE(data.empty());
+}
+
+TEST_F(CalibrationCacheTest, it_ignores_malformed_lines) {
+    {
+        std::ofstream file(path);
+        file << "garbage\n"
+             << "odd 123\n"
+             << "invalid 0g\n"
+             << "valid 0102\n";
+    }
+
+    CalibrationCache cache(path);
+    std::vector<uint8_t> data;
+    ASSERT_FALSE(cache.get("garbage", data));
+    ASSERT_FALSE(cache.get("odd", data));
+    ASSERT_FALSE(cache.get("invalid", data));
+    ASSERT_TRUE(cache.get("valid", data));
+    ASSERT_EQ((std::vector<uint8_t>{1, 2}), data);
+}
+
+TEST_F(CalibrationCacheTest, it_rejects_keys_that_would_break_the_file_format) {
+    CalibrationCache cache(path);
+    ASSERT_THROW(cache.set("", {1}), std::invalid_argument);
+    ASSERT_THROW(cache.set("a\nb", {1}), std::invalid_argument);
+}
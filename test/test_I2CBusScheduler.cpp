@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <i2clib/I2CBusScheduler.hpp>
+
+#include <thread>
+
+using namespace i2clib;
+
+struct I2CBusSchedulerTest : public ::testing::Test {
+    I2CBusScheduler scheduler;
+
+    I2CBusScheduler::Task makeTask(std::string const& name,
+        int period_ms,
+        int cost_ms,
+        std::function<void()> callback = [] {})
+    {
+        I2CBusScheduler::Task task;
+        task.name = name;
+        task.period = base::Time::fromMilliseconds(period_ms);
+        task.cost = base::Time::fromMilliseconds(cost_ms);
+        task.callback = callback;
+        return task;
+    }
+};
+
+TEST_F(I2CBusSchedulerTest, it_estimates_the_bus_time_of_a_transaction)
+{
+    // start + (address + 2 bytes) * 9 bits + stop = 29 bits
+    ASSERT_EQ(73, I2CBusScheduler::transferDuration(2, 0, 400000).toMicroseconds());
+    // 29 bits + restart + (address + 3 bytes) * 9 bits = 66 bits
+    ASSERT_EQ(165, I2CBusScheduler::transferDuration(2, 3, 400000).toMicroseconds());
+    ASSERT_EQ(660, I2CBusScheduler::transferDuration(2, 3, 100000).toMicroseconds());
+}
+
+TEST_F(I2CBusSchedulerTest, it_estimates_a_batch_as_a_single_transaction)
+{
+    uint8_t bytes[3];
+    I2CTransactionBatch batch;
+    batch.read(0x40, bytes, 2, bytes, 3);
+    ASSERT_EQ(I2CBusScheduler::transferDuration(2, 3, 400000),
+        I2CBusScheduler::transferDuration(batch, 400000));
+}
+
+TEST_F(I2CBusSchedulerTest, it_places_the_tasks_in_rate_monotonic_order)
+{
+    scheduler.add(makeTask("slow", 40, 3));
+    scheduler.add(makeTask("medium", 20, 5));
+    scheduler.add(makeTask("fast", 10, 2));
+    scheduler.plan();
+
+    ASSERT_EQ(40, scheduler.getHyperperiod().toMilliseconds());
+    ASSERT_EQ(0, scheduler.getOffset(2).toMilliseconds());
+    ASSERT_EQ(2, scheduler.getOffset(1).toMilliseconds());
+    ASSERT_EQ(7, scheduler.getOffset(0).toMilliseconds());
+    ASSERT_NEAR(0.525, scheduler.getUtilization(), 1e-9);
+}
+
+TEST_F(I2CBusSchedulerTest, it_builds_a_timeline_without_overlapping_jobs)
+{
+    scheduler.add(makeTask("a", 10, 2));
+    scheduler.add(makeTask("b", 20, 5));
+    scheduler.add(makeTask("c", 40, 3));
+    scheduler.plan();
+
+    auto const& timeline = scheduler.getTimeline();
+    ASSERT_EQ(4u + 2u + 1u, timeline.size());
+    for (size_t i = 1; i < timeline.size(); ++i) {
+        auto const& previous = timeline[i - 1];
+        auto previous_end =
+            previous.start + base::Time::fromMilliseconds(
+                                 previous.task == 0 ? 2 : previous.task == 1 ? 5 : 3);
+        ASSERT_LE(previous_end, timeline[i].start);
+    }
+}
+
+TEST_F(I2CBusSchedulerTest, it_names_the_task_that_cannot_be_placed)
+{
+    scheduler.add(makeTask("a", 10, 6));
+    scheduler.add(makeTask("b", 20, 9));
+    try {
+        scheduler.plan();
+        FAIL() << "plan() did not throw";
+    }
+    catch (std::invalid_argument const& e) {
+        ASSERT_NE(std::string::npos, std::string(e.what()).find("task b"));
+    }
+}
+
+TEST_F(I2CBusSchedulerTest, it_rejects_a_deadline_greater_than_the_period)
+{
+    auto task = makeTask("a", 10, 1);
+    task.deadline = base::Time::fromMilliseconds(11);
+    ASSERT_THROW(scheduler.add(task), std::invalid_argument);
+}
+
+TEST_F(I2CBusSchedulerTest, it_executes_the_timeline_and_reports_deadline_misses)
+{
+    int fast_runs = 0;
+    scheduler.add(makeTask("fast", 10, 1, [&fast_runs] { ++fast_runs; }));
+    auto slow = makeTask("slow", 20, 2, [] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(6));
+    });
+    slow.deadline = base::Time::fromMilliseconds(5);
+    scheduler.add(slow);
+    scheduler.plan();
+
+    scheduler.runUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(55));
+
+    ASSERT_EQ(6, fast_runs);
+    ASSERT_EQ(6u, scheduler.getStatistics(0).runs);
+    ASSERT_EQ(0u, scheduler.getStatistics(0).deadline_misses);
+    ASSERT_EQ(3u, scheduler.getStatistics(1).runs);
+    ASSERT_EQ(3u, scheduler.getStatistics(1).deadline_misses);
+    ASSERT_GE(scheduler.getStatistics(1).max_duration.toMilliseconds(), 6);
+}
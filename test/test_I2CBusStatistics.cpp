@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <i2clib/I2CBusStatistics.hpp>
+
+#include <thread>
+#include <vector>
+
+using namespace i2clib;
+using namespace std::chrono;
+
+struct I2CBusStatisticsTest : public ::testing::Test {
+    I2CBusStatistics statistics;
+    uint8_t buffer[16];
+
+    void recordBatch(I2CTransactionBatch const& batch,
+        size_t completed,
+        int error,
+        steady_clock::duration latency = microseconds(100))
+    {
+        auto const& messages = batch.messages();
+        statistics.record(messages.data(), messages.size(), completed, error, latency);
+    }
+};
+
+TEST_F(I2CBusStatisticsTest, it_bounds_the_relative_error_of_the_histogram_buckets)
+{
+    for (uint64_t ns = 1; ns < (uint64_t(1) << 40); ns = ns * 3 + 1) {
+        unsigned index = LatencyHistogram::bucketIndex(ns);
+        ASSERT_LT(index, LatencyHistogram::BUCKET_COUNT);
+        uint64_t upper = LatencyHistogram::bucketUpperBound(index);
+        ASSERT_GE(upper, ns);
+        ASSERT_LE(upper - ns, ns / LatencyHistogram::SUB_BUCKET_COUNT);
+        if (index > 0) {
+            ASSERT_LT(LatencyHistogram::bucketUpperBound(index - 1), ns);
+        }
+    }
+}
+
+TEST_F(I2CBusStatisticsTest, it_clamps_values_past_the_last_bucket)
+{
+    ASSERT_EQ(LatencyHistogram::BUCKET_COUNT - 1,
+        LatencyHistogram::bucketIndex(~uint64_t(0)));
+}
+
+TEST_F(I2CBusStatisticsTest, it_counts_transactions_and_bytes_per_address)
+{
+    I2CTransactionBatch batch;
+    batch.write(0x40, buffer, 5);
+    batch.read(0x40, buffer, 1, buffer, 4);
+    batch.read(0x76, buffer, 1, buffer, 6);
+    recordBatch(batch, batch.messages().size(), 0);
+
+    auto snapshot = statistics.snapshot();
+    ASSERT_EQ(1u, snapshot.bus.transfers);
+    ASSERT_EQ(3u, snapshot.bus.transactions);
+    ASSERT_EQ(7u, snapshot.bus.bytes_written);
+    ASSERT_EQ(10u, snapshot.bus.bytes_read);
+    ASSERT_EQ(0u, snapshot.bus.errors);
+
+    ASSERT_EQ(2u, snapshot.addresses.size());
+    auto const& pca = snapshot.addresses.at(0x40);
+    ASSERT_EQ(1u, pca.transfers);
+    ASSERT_EQ(2u, pca.transactions);
+    ASSERT_EQ(6u, pca.bytes_written);
+    ASSERT_EQ(4u, pca.bytes_read);
+    ASSERT_EQ(1u, pca.latency.count());
+    auto const& sensor = snapshot.addresses.at(0x76);
+    ASSERT_EQ(1u, sensor.transactions);
+    ASSERT_EQ(1u, sensor.bytes_written);
+    ASSERT_EQ(6u, sensor.bytes_read);
+}
+
+TEST_F(I2CBusStatisticsTest, it_attributes_errors_to_the_first_message_not_completed)
+{
+    I2CTransactionBatch batch;
+    batch.write(0x40, buffer, 5);
+    batch.read(0x76, buffer, 1, buffer, 6);
+    recordBatch(batch, 1, EIO);
+    recordBatch(batch, 0, ENXIO);
+
+    auto snapshot = statistics.snapshot();
+    ASSERT_EQ(2u, snapshot.bus.errors);
+    ASSERT_EQ(1u, snapshot.bus.errors_by_errno.at(EIO));
+    ASSERT_EQ(1u, snapshot.bus.errors_by_errno.at(ENXIO));
+    ASSERT_EQ(5u, snapshot.bus.bytes_written);
+    ASSERT_EQ(0u, snapshot.bus.bytes_read);
+
+    ASSERT_EQ(1u, snapshot.addresses.at(0x40).errors);
+    ASSERT_EQ(1u, snapshot.addresses.at(0x40).errors_by_errno.at(ENXIO));
+    ASSERT_EQ(1u, snapshot.addresses.at(0x76).errors);
+    ASSERT_EQ(1u, snapshot.addresses.at(0x76).errors_by_errno.at(EIO));
+}
+
+TEST_F(I2CBusStatisticsTest, it_computes_latency_percentiles)
+{
+    I2CTransactionBatch batch;
+    batch.write(0x40, buffer, 1);
+    for (int i = 0; i < 98; ++i) {
+        recordBatch(batch, 1, 0, microseconds(200));
+    }
+    recordBatch(batch, 1, 0, microseconds(1000));
+    recordBatch(batch, 1, 0, microseconds(5000));
+
+    auto latency = statistics.snapshot().addresses.at(0x40).latency;
+    ASSERT_EQ(100u, latency.count());
+    ASSERT_EQ(5000, latency.max.toMicroseconds());
+    ASSERT_NEAR(200, latency.percentile(0.5).toMicroseconds(), 200 / 16);
+    ASSERT_NEAR(1000, latency.percentile(0.99).toMicroseconds(), 1000 / 16);
+    ASSERT_EQ(5000, latency.percentile(1).toMicroseconds());
+}
+
+TEST_F(I2CBusStatisticsTest, it_reports_the_bus_utilization)
+{
+    I2CTransactionBatch batch;
+    batch.write(0x40, buffer, 1);
+    std::this_thread::sleep_for(milliseconds(10));
+    recordBatch(batch, 1, 0, milliseconds(2));
+
+    auto snapshot = statistics.snapshot();
+    ASSERT_EQ(2000, snapshot.bus.busy_time.toMicroseconds());
+    ASSERT_GT(snapshot.getUtilization(), 0);
+    ASSERT_LT(snapshot.getUtilization(), 0.2);
+}
+
+TEST_F(I2CBusStatisticsTest, it_zeroes_the_counters_on_reset)
+{
+    I2CTransactionBatch batch;
+    batch.write(0x40, buffer, 1);
+    recordBatch(batch, 0, EIO);
+    statistics.reset();
+
+    auto snapshot = statistics.snapshot();
+    ASSERT_EQ(0u, snapshot.bus.transfers);
+    ASSERT_EQ(0u, snapshot.addresses.at(0x40).errors);
+    ASSERT_TRUE(snapshot.addresses.at(0x40).errors_by_errno.empty());
+    ASSERT_EQ(0u, snapshot.addresses.at(0x40).latency.count());
+}
+
+TEST_F(I2CBusStatisticsTest, it_accepts_concurrent_recording)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([this, t] {
+            I2CTransactionBatch batch;
+            batch.write(0x40 + t, buffer, 2);
+            batch.write(0x50, buffer, 1);
+            for (int i = 0; i < 1000; ++i) {
+                recordBatch(batch, 2, 0);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto snapshot = statistics.snapshot();
+    ASSERT_EQ(4000u, snapshot.bus.transfers);
+    ASSERT_EQ(8000u, snapshot.bus.transactions);
+    ASSERT_EQ(12000u, snapshot.bus.bytes_written);
+    ASSERT_EQ(4000u, snapshot.addresses.at(0x50).transactions);
+    ASSERT_EQ(4000u, snapshot.addresses.at(0x50).latency.count());
+    ASSERT_EQ(1000u, snapshot.addresses.at(0x42).transactions);
+}
@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include <i2clib/I2CTransactionBatch.hpp>
+
+using namespace i2clib;
+
+struct I2CTransactionBatchTest : public ::testing::Test {
+    I2CTransactionBatch batch;
+    uint8_t buffer[8];
+};
+
+TEST_F(I2CTransactionBatchTest, it_queues_one_message_per_write_and_two_per_read)
+{
+    batch.write(0x40, buffer, 2);
+    batch.read(0x76, buffer, 1, buffer + 2, 6);
+    batch.read(0x76, buffer, 3);
+
+    auto const& messages = batch.messages();
+    ASSERT_EQ(4, messages.size());
+    ASSERT_EQ(3, batch.transactionCount());
+
+    ASSERT_EQ(0x40, messages[0].address);
+    ASSERT_FALSE(messages[0].read);
+    ASSERT_EQ(0, messages[0].transaction);
+
+    ASSERT_FALSE(messages[1].read);
+    ASSERT_EQ(1, messages[1].size);
+    ASSERT_TRUE(messages[2].read);
+    ASSERT_EQ(buffer + 2, messages[2].buffer);
+    ASSERT_EQ(6, messages[2].size);
+    ASSERT_EQ(1, messages[1].transaction);
+    ASSERT_EQ(1, messages[2].transaction);
+
+    ASSERT_TRUE(messages[3].read);
+    ASSERT_EQ(2, messages[3].transaction);
+}
+
+TEST_F(I2CTransactionBatchTest, it_does_not_split_a_write_then_read_transaction)
+{
+    batch.write(0x40, buffer, 2);
+    batch.read(0x76, buffer, 1, buffer, 6);
+    batch.write(0x40, buffer, 2);
+
+    ASSERT_EQ(1, batch.splitPoint(0, 2));
+    ASSERT_EQ(3, batch.splitPoint(1, 2));
+    ASSERT_EQ(4, batch.splitPoint(3, 2));
+}
+
+TEST_F(I2CTransactionBatchTest, it_rejects_a_split_that_cannot_fit_a_transaction)
+{
+    batch.read(0x76, buffer, 1, buffer, 6);
+    ASSERT_THROW(batch.splitPoint(0, 1), std::invalid_argument);
+}
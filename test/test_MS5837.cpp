@@ -1,23 +1,35 @@
 #include <gtest/gtest.h>
+#include <i2clib/CalibrationCache.hpp>
 #include <i2clib/MS5837.hpp>
+#include <i2clib/MS5837Group.hpp>
+#include <i2clib/SimulatedMS5837.hpp>
+
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
 
 using namespace i2clib;
 
 struct MS5837Test : public ::testing::Test {
+    MS5837::PROM prom;
+
+    MS5837Test()
+    {
+        prom.C[0] = 0;
+        prom.C[1] = 34982;
+        prom.C[2] = 36352;
+        prom.C[3] = 20328;
+        prom.C[4] = 22354;
+        prom.C[5] = 26646;
+        prom.C[6] = 26146;
+    }
 };
 
 TEST_F(MS5837Test, it_performs_conversion_according_to_the_datasheet) {
     // The datasheet has an example conversion. This test makes sure our implementation
     // matches that example
 
-    MS5837::PROM prom;
-    prom.C[1] = 34982;
-    prom.C[2] = 36352;
-    prom.C[3] = 20328;
-    prom.C[4] = 22354;
-    prom.C[5] = 26646;
-    prom.C[6] = 26146;
-
     int32_t raw_T = 6815414;
     int32_t raw_P = 4958179;
 
@@ -26,4 +38,269 @@ TEST_F(MS5837Test, it_performs_conversion_according_to_the_datasheet) {
 
     ASSERT_NEAR(19.81, temperature.getCelsius(), 1e-2);
     ASSERT_NEAR(3.9998, pressure.toBar(), 1e-4);
-}
\ No newline at end of file
+}
+
+/** Datasheet compensation of both models, in floating point
+ *
+ * TEMP is kept integral as the second-order terms are computed from it
+ */
+static MS5837::Compensated referenceCompensation(MS5837::Models model,
+    double D2,
+    double D1,
+    MS5837::PROM const& prom)
+{
+    bool is_02BA = (model == MS5837::MODEL_02BA);
+    auto const& C = prom.C;
+    double dT = D2 - C[5] * std::pow(2, 8);
+    double TEMP = std::floor(2000 + dT * C[6] / std::pow(2, 23));
+    double OFF = is_02BA ? C[2] * std::pow(2, 17) + C[4] * dT / std::pow(2, 6)
+                         : C[2] * std::pow(2, 16) + C[4] * dT / std::pow(2, 7);
+    double SENS = is_02BA ? C[1] * std::pow(2, 16) + C[3] * dT / std::pow(2, 7)
+                          : C[1] * std::pow(2, 15) + C[3] * dT / std::pow(2, 8);
+
+    double Ti = 0, OFFi = 0, SENSi = 0;
+    double delta2 = (TEMP - 2000) * (TEMP - 2000);
+    if (is_02BA) {
+        if (TEMP < 2000) {
+            Ti = 11 * dT * dT / std::pow(2, 35);
+            OFFi = 31 * delta2 / std::pow(2, 3);
+            SENSi = 63 * delta2 / std::pow(2, 5);
+        }
+    }
+    else if (TEMP < 2000) {
+        Ti = 3 * dT * dT / std::pow(2, 33);
+        OFFi = 3 * delta2 / 2;
+        SENSi = 5 * delta2 / std::pow(2, 3);
+        if (TEMP < -1500) {
+            OFFi += 7 * (TEMP + 1500) * (TEMP + 1500);
+            SENSi += 4 * (TEMP + 1500) * (TEMP + 1500);
+        }
+    }
+    else {
+        Ti = 2 * dT * dT / std::pow(2, 37);
+        OFFi = delta2 / std::pow(2, 4);
+    }
+
+    double P = (D1 * (SENS - SENSi) / std::pow(2, 21) - (OFF - OFFi)) /
+               std::pow(2, is_02BA ? 15 : 13);
+    MS5837::Compensated result;
+    result.temperature = std::lround(TEMP - Ti);
+    result.pressure = std::lround(P * (is_02BA ? 1 : 10));
+    return result;
+}
+
+TEST_F(MS5837Test, it_applies_the_second_order_compensation_in_fixed_point) {
+    auto result = MS5837::compensateFixed<MS5837::MODEL_30BA>(6815414, 4958179, prom);
+    ASSERT_EQ(1981, result.temperature);
+    ASSERT_EQ(399980, result.pressure);
+}
+
+TEST_F(MS5837Test, it_matches_the_datasheet_compensation_over_the_operating_range) {
+    for (auto model : {MS5837::MODEL_30BA, MS5837::MODEL_02BA}) {
+        // -40 to 85 degrees
+        for (int32_t D2 = 4850000; D2 < 8950000; D2 += 10007) {
+            for (int32_t D1 : {1000000, 4958179, 9000000}) {
+                MS5837::Compensated result =
+                    model == MS5837::MODEL_30BA
+                        ? MS5837::compensateFixed<MS5837::MODEL_30BA>(D2, D1, prom)
+                        : MS5837::compensateFixed<MS5837::MODEL_02BA>(D2, D1, prom);
+                auto expected = referenceCompensation(model, D2, D1, prom);
+                // The fixed-point implementation truncates at each step
+                int pressure_tolerance = model == MS5837::MODEL_30BA ? 30 : 3;
+                ASSERT_NEAR(expected.temperature, result.temperature, 1)
+                    << "model=" << model << " D2=" << D2 << " D1=" << D1;
+                ASSERT_NEAR(expected.pressure, result.pressure, pressure_tolerance)
+                    << "model=" << model << " D2=" << D2 << " D1=" << D1;
+            }
+        }
+    }
+}
+
+TEST_F(MS5837Test, it_corrects_the_first_order_bias_at_low_temperature) {
+    int32_t raw_T = 5000000;
+    int32_t raw_P = 4958179;
+    auto [temperature, dT] = MS5837::compensateRawTemperature(raw_T, prom);
+    auto pressure = MS5837::compensateRawPressure(raw_P, dT, prom);
+    ASSERT_LT(temperature.getCelsius(), -15);
+
+    auto result = MS5837::compensateFixed<MS5837::MODEL_30BA>(raw_T, raw_P, prom);
+    ASSERT_LT(result.temperature, temperature.getCelsius() * 100 - 10);
+    ASSERT_GT(std::abs(result.pressure - pressure.toPa()), 100);
+}
+
+TEST_F(MS5837Test, it_compensates_a_series_like_the_single_sample_function) {
+    std::vector<int32_t> raw_T, raw_P;
+    for (int i = 0; i < 100; ++i) {
+        raw_T.push_back(4850000 + i * 41000);
+        raw_P.push_back(1000000 + i * 80000);
+    }
+
+    std::vector<int32_t> temperature(raw_T.size()), pressure(raw_T.size());
+    MS5837::compensateBatch(MS5837::MODEL_02BA, raw_T.size(), raw_T.data(),
+        raw_P.data(), prom, temperature.data(), pressure.data());
+    for (size_t i = 0; i < raw_T.size(); ++i) {
+        auto expected =
+            MS5837::compensateFixed<MS5837::MODEL_02BA>(raw_T[i], raw_P[i], prom);
+        ASSERT_EQ(expected.temperature, temperature[i]);
+        ASSERT_EQ(expected.pressure, pressure[i]);
+    }
+}
+
+TEST_F(MS5837Test, it_uses_the_compensation_of_its_model) {
+    SimulatedI2CBus bus;
+    SimulatedMS5837 device;
+    bus.attach(118, device);
+    device.setPROM(prom);
+    device.setRawMeasurements(4958179, 6815414);
+    device.setSimulateConversionTime(false);
+
+    MS5837 chip(MS5837::MODEL_02BA, bus);
+    auto measurement = chip.read(0, 0);
+    auto expected = MS5837::compensateFixed<MS5837::MODEL_02BA>(6815414, 4958179,
+        device.getPROM());
+    ASSERT_NEAR(expected.temperature / 100.0, measurement.temperature.getCelsius(), 1e-4);
+    ASSERT_NEAR(expected.pressure, measurement.pressure.toPa(), 1e-1);
+}
+
+TEST_F(MS5837Test, it_reads_the_PROM_and_performs_a_complete_measurement_cycle) {
+    SimulatedI2CBus bus;
+    SimulatedMS5837 device;
+    bus.attach(118, device);
+    device.setPROM(prom);
+    device.setRawMeasurements(4958179, 6815414);
+
+    MS5837 chip(MS5837::MODEL_30BA, bus);
+    ASSERT_EQ(device.getPROM().C, chip.readPROM().C);
+
+    auto measurement = chip.read(0, 0);
+    ASSERT_NEAR(19.81, measurement.temperature.getCelsius(), 1e-2);
+    ASSERT_NEAR(3.9998, measurement.pressure.toBar(), 1e-4);
+}
+
+TEST_F(MS5837Test, it_advances_through_the_conversion_cycle_without_waiting) {
+    SimulatedI2CBus bus;
+    SimulatedMS5837 device;
+    bus.attach(118, device);
+    device.setPROM(prom);
+    device.setRawMeasurements(4958179, 6815414);
+
+    MS5837 chip(MS5837::MODEL_30BA, bus);
+    chip.startAcquisition(3, 3);
+    ASSERT_EQ(MS5837::CONVERSION_TEMPERATURE, chip.getConversionState());
+
+    MS5837::Measurement measurement;
+    ASSERT_FALSE(chip.poll(measurement));
+    ASSERT_EQ(MS5837::CONVERSION_TEMPERATURE, chip.getConversionState());
+
+    std::this_thread::sleep_until(chip.conversionReadyAt());
+    ASSERT_FALSE(chip.poll(measurement));
+    ASSERT_EQ(MS5837::CONVERSION_PRESSURE, chip.getConversionState());
+    ASSERT_FALSE(chip.poll(measurement));
+
+    std::this_thread::sleep_until(chip.conversionReadyAt());
+    ASSERT_TRUE(chip.poll(measurement));
+    ASSERT_EQ(MS5837::CONVERSION_IDLE, chip.getConversionState());
+    ASSERT_NEAR(19.81, measurement.temperature.getCelsius(), 1e-2);
+    ASSERT_NEAR(3.9998, measurement.pressure.toBar(), 1e-4);
+    ASSERT_FALSE(chip.poll(measurement));
+}
+
+TEST_F(MS5837Test, it_acquires_several_chips_in_parallel) {
+    SimulatedI2CBus bus;
+    SimulatedMS5837 devices[3];
+    for (int i = 0; i < 3; ++i) {
+        bus.attach(118 + i, devices[i]);
+        devices[i].setPROM(prom);
+        devices[i].setRawMeasurements(4958179, 6815414);
+    }
+
+    std::vector<std::unique_ptr<MS5837>> chips;
+    MS5837Group group(4, 4);
+    for (int i = 0; i < 3; ++i) {
+        chips.emplace_back(new MS5837(MS5837::MODEL_30BA, bus, 118 + i));
+        group.add(*chips.back());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto measurements = group.read();
+    auto duration = std::chrono::steady_clock::now() - start;
+
+    ASSERT_EQ(3, measurements.size());
+    for (auto const& measurement : measurements) {
+        ASSERT_NEAR(19.81, measurement.temperature.getCelsius(), 1e-2);
+        ASSERT_NEAR(3.9998, measurement.pressure.toBar(), 1e-4);
+    }
+    // Sequential acquisition would take 6 conversions
+    ASSERT_LT(duration, 4 * MS5837::conversionDuration(4));
+    ASSERT_EQ(MS5837::CONVERSION_TEMPERATURE, chips[0]->getConversionState());
+
+    measurements = group.read();
+    ASSERT_NEAR(3.9998, measurements[2].pressure.toBar(), 1e-4);
+}
+
+TEST_F(MS5837Test, it_timestamps_the_measurement_with_the_pressure_conversion_window) {
+    SimulatedI2CBus bus;
+    SimulatedMS5837 device;
+    bus.attach(118, device);
+    device.setPROM(prom);
+    bus.setLatency(base::Time::fromMicroseconds(200));
+
+    MS5837 chip(MS5837::MODEL_30BA, bus);
+    auto before = base::Time::now();
+    auto measurement = chip.read(2, 2);
+    auto after = base::Time::now();
+
+    auto window = measurement.acquisition_end - measurement.acquisition_start;
+    ASSERT_NEAR(MS5837::conversionDuration(2).count() / 1000, window.toMicroseconds(), 2);
+    ASSERT_EQ(measurement.acquisition_start + window / 2, measurement.time);
+    ASSERT_LT(before, measurement.acquisition_start);
+    ASSERT_LT(measurement.acquisition_end, after);
+    ASSERT_GE(measurement.transport_latency.toMicroseconds(), 200);
+}
+
+TEST_F(MS5837Test, it_reads_the_PROM_in_a_single_transfer) {
+    SimulatedI2CBus bus;
+    SimulatedMS5837 device;
+    bus.attach(118, device);
+    device.setPROM(prom);
+
+    MS5837 chip(MS5837::MODEL_30BA, bus);
+    ASSERT_EQ(1, bus.getTransferCount());
+    ASSERT_EQ(device.getPROM().C, chip.getPROM().C);
+}
+
+TEST_F(MS5837Test, it_uses_a_cached_PROM_without_accessing_the_bus) {
+    SimulatedI2CBus bus;
+    SimulatedMS5837 device;
+    bus.attach(118, device);
+    device.setPROM(prom);
+
+    CalibrationCache cache;
+    MS5837 cold(MS5837::MODEL_30BA, bus, 118, cache, "/dev/i2c-1");
+    ASSERT_EQ(1, bus.getTransferCount());
+
+    MS5837 warm(MS5837::MODEL_30BA, bus, 118, cache, "/dev/i2c-1");
+    ASSERT_EQ(1, bus.getTransferCount());
+    ASSERT_EQ(device.getPROM().C, warm.getPROM().C);
+}
+
+TEST_F(MS5837Test, it_reads_the_PROM_again_if_the_cached_one_has_an_invalid_CRC) {
+    SimulatedI2CBus bus;
+    SimulatedMS5837 device;
+    bus.attach(118, device);
+    device.setPROM(prom);
+
+    CalibrationCache cache;
+    auto key = CalibrationCache::key("ms5837", "/dev/i2c-1", 118);
+    MS5837 cold(MS5837::MODEL_30BA, bus, 118, cache, "/dev/i2c-1");
+    std::vector<uint8_t> entry;
+    ASSERT_TRUE(cache.get(key, entry));
+    entry[5] ^= 1;
+    cache.set(key, entry);
+
+    MS5837 warm(MS5837::MODEL_30BA, bus, 118, cache, "/dev/i2c-1");
+    ASSERT_EQ(2, bus.getTransferCount());
+    ASSERT_EQ(device.getPROM().C, warm.getPROM().C);
+    ASSERT_TRUE(cache.get(key, entry));
+    ASSERT_EQ(device.getPROM().C[2] & 0xFF, entry[5]);
+}
@@ -1,9 +1,26 @@
+#include "AllocationCounter.hpp"
+
 #include <gtest/gtest.h>
+#include <i2clib/CalibrationCache.hpp>
 #include <i2clib/PCA9685.hpp>
+#include <i2clib/PCA9685Array.hpp>
+#include <i2clib/PCA9685DutyConversion.hpp>
+#include <i2clib/PCA9685Ramp.hpp>
+#include <i2clib/SimulatedPCA9685.hpp>
+
+#include <cmath>
+#include <random>
 
 using namespace i2clib;
 
 struct PCA9685Test : public ::testing::Test {
+    SimulatedI2CBus bus;
+    SimulatedPCA9685 device;
+
+    PCA9685Test()
+    {
+        bus.attach(0x40, device);
+    }
 };
 
 TEST_F(PCA9685Test, it_computes_prescaling_for_200Hz_as_described_in_the_documentation)
@@ -22,3 +39,616 @@ TEST_F(PCA9685Test,
 {
     ASSERT_EQ(PCA9685::periodToPrescale(41666666), 0xfd);
 }
+
+TEST_F(PCA9685Test, it_writes_the_duty_ratios_in_the_PWM_registers)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    chip.writeDutyRatios(2, {0, 0.5, 1});
+
+    ASSERT_EQ(PCA9685PWMConfiguration::MODE_OFF, device.getPWMConfiguration(2).mode);
+    auto half = device.getPWMConfiguration(3);
+    ASSERT_EQ(PCA9685PWMConfiguration::MODE_NORMAL, half.mode);
+    ASSERT_EQ(0, half.on_edge);
+    ASSERT_EQ(2047, half.off_edge);
+    ASSERT_EQ(PCA9685PWMConfiguration::MODE_ON, device.getPWMConfiguration(4).mode);
+}
+
+TEST_F(PCA9685Test, it_reads_the_PWM_period_from_the_prescale_register)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeSleepMode();
+    chip.writePrescale(30);
+    ASSERT_EQ(PCA9685::prescaleToPeriod(30), chip.readPWMPeriod());
+}
+
+TEST_F(PCA9685Test, it_only_writes_the_registers_that_changed)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    std::vector<float> ratios(16, 0.5);
+    chip.writeDutyRatios(0, ratios);
+    ASSERT_EQ(0, chip.getBytesSaved());
+
+    auto transfers = bus.getTransferCount();
+    auto bytes = bus.getByteCount();
+    ratios[7] = 0.25;
+    chip.writeDutyRatios(0, ratios);
+
+    // Only the OFF_H register changes
+    ASSERT_EQ(transfers + 1, bus.getTransferCount());
+    ASSERT_EQ(bytes + 3, bus.getByteCount());
+    ASSERT_EQ(65 - 2, chip.getBytesSaved());
+    ASSERT_EQ(1023, device.getPWMConfiguration(7).off_edge);
+
+    chip.writeDutyRatios(0, ratios);
+    ASSERT_EQ(transfers + 1, bus.getTransferCount());
+    ASSERT_EQ(65 - 2 + 66, chip.getBytesSaved());
+}
+
+TEST_F(PCA9685Test, it_merges_register_runs_separated_by_small_gaps)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    std::vector<float> ratios(16, 0.5);
+    chip.writeDutyRatios(0, ratios);
+
+    // The OFF registers of channels 1 and 2 are separated by the 2 ON registers
+    // of channel 2, channel 8 is far apart
+    ratios[1] = 0.3;
+    ratios[2] = 0.3;
+    ratios[8] = 0.3;
+    auto bytes = bus.getByteCount();
+    chip.writeDutyRatios(0, ratios);
+    ASSERT_EQ(bytes + (2 + 6) + (2 + 2), bus.getByteCount());
+
+    for (int i = 0; i < 16; ++i) {
+        ASSERT_EQ(ratios[i] == 0.5 ? 2047 : 1228, device.getPWMConfiguration(i).off_edge);
+    }
+}
+
+TEST_F(PCA9685Test, it_writes_all_registers_after_the_cache_is_invalidated)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    std::vector<float> ratios(16, 0.5);
+    chip.writeDutyRatios(0, ratios);
+
+    auto bytes = bus.getByteCount();
+    chip.invalidateRegisterCache();
+    chip.writeDutyRatios(0, ratios);
+    ASSERT_EQ(bytes + 66, bus.getByteCount());
+}
+
+TEST_F(PCA9685Test, it_ramps_outputs_at_the_configured_rate)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    PCA9685Ramp ramp(chip, 4, 2, base::Time::fromMilliseconds(10));
+    PCA9685Ramp::Limits limits;
+    limits.max_rate = 1;
+    ramp.setLimits(4, limits);
+    ramp.setTarget(4, 0.5);
+    ramp.setTarget(5, 0.5);
+
+    for (int i = 0; i < 25; ++i) {
+        ASSERT_TRUE(ramp.step());
+    }
+    ASSERT_NEAR(0.25, ramp.getPosition(4), 1e-4);
+    ASSERT_NEAR(1023, device.getPWMConfiguration(4).off_edge, 1);
+    // Not limited
+    ASSERT_EQ(0.5, ramp.getPosition(5));
+    ASSERT_EQ(2047, device.getPWMConfiguration(5).off_edge);
+
+    int steps = 25;
+    while (ramp.step()) {
+        ASSERT_LT(++steps, 60);
+    }
+    ASSERT_NEAR(50, steps, 1);
+    ASSERT_TRUE(ramp.isSettled());
+    ASSERT_EQ(2047, device.getPWMConfiguration(4).off_edge);
+}
+
+TEST_F(PCA9685Test, it_limits_the_acceleration_of_the_outputs)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    float tick = 0.01;
+    PCA9685Ramp ramp(chip, 0, 1, base::Time::fromMilliseconds(10));
+    PCA9685Ramp::Limits limits;
+    limits.max_rate = 2;
+    limits.max_acceleration = 4;
+    ramp.setLimits(0, limits);
+    ramp.setPosition(0, 0.2);
+    ramp.setTarget(0, 0.8);
+
+    float position = 0.2;
+    float velocity = 0;
+    int steps = 0;
+    while (ramp.step()) {
+        float new_velocity = (ramp.getPosition(0) - position) / tick;
+        ASSERT_LE(std::abs(new_velocity - velocity), 4 * tick + 1e-3);
+        ASSERT_LE(new_velocity, 2 + 1e-3);
+        ASSERT_GT(ramp.getPosition(0), position);
+        ASSERT_LT(ramp.getPosition(0), 0.8);
+        position = ramp.getPosition(0);
+        velocity = new_velocity;
+        ASSERT_LT(++steps, 100);
+    }
+    // Accelerating to half-way and decelerating takes 2 * sqrt(0.6 / 4)s
+    ASSERT_NEAR(77, steps, 2);
+    ASSERT_EQ(0.8f, ramp.getPosition(0));
+}
+
+TEST_F(PCA9685Test, it_limits_the_acceleration_when_retargeting_a_moving_output)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    float tick = 0.01;
+    PCA9685Ramp ramp(chip, 0, 1, base::Time::fromMilliseconds(10));
+    PCA9685Ramp::Limits limits;
+    limits.max_rate = 2;
+    limits.max_acceleration = 4;
+    ramp.setLimits(0, limits);
+    ramp.setTarget(0, 0.8);
+
+    float position = 0;
+    float velocity = 0;
+    for (int i = 0; i < 20; ++i) {
+        ramp.step();
+        velocity = (ramp.getPosition(0) - position) / tick;
+        position = ramp.getPosition(0);
+    }
+    ASSERT_NEAR(0.8, velocity, 1e-3);
+
+    // Hold at the current position. The output has to overshoot and come back
+    float hold = position;
+    float overshoot = 0;
+    ramp.setTarget(0, hold);
+    int steps = 0;
+    while (ramp.step()) {
+        float new_velocity = (ramp.getPosition(0) - position) / tick;
+        ASSERT_LE(std::abs(new_velocity - velocity), 4 * tick + 1e-3);
+        position = ramp.getPosition(0);
+        velocity = new_velocity;
+        overshoot = std::max(overshoot, position - hold);
+        ASSERT_LT(++steps, 100);
+    }
+    // Decelerating from 0.8/s by 0.04/s per 10ms tick covers 0.076
+    ASSERT_NEAR(0.076, overshoot, 1e-3);
+    ASSERT_EQ(hold, ramp.getPosition(0));
+    ASSERT_TRUE(ramp.isSettled());
+}
+
+TEST_F(PCA9685Test, it_only_writes_the_outputs_that_moved_during_a_ramp)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    PCA9685Ramp ramp(chip, 0, 16, base::Time::fromMilliseconds(10));
+    ramp.step();
+
+    PCA9685Ramp::Limits limits;
+    limits.max_rate = 0.1;
+    ramp.setLimits(9, limits);
+    ramp.setTarget(9, 0.5);
+    for (int i = 0; i < 10; ++i) {
+        auto bytes = bus.getByteCount();
+        auto transfers = bus.getTransferCount();
+        ramp.step();
+        ASSERT_LE(bus.getTransferCount(), transfers + 1);
+        // A single run with the low and high bytes of the off edge at most
+        ASSERT_LE(bus.getByteCount(), bytes + 4);
+    }
+    ASSERT_NEAR(41, device.getPWMConfiguration(9).off_edge, 1);
+}
+
+TEST_F(PCA9685Test, it_rejects_outputs_outside_of_the_ramp_range)
+{
+    PCA9685 chip(bus, 0x40);
+    ASSERT_THROW(PCA9685Ramp(chip, 10, 7, base::Time::fromMilliseconds(10)),
+        std::invalid_argument);
+    PCA9685Ramp ramp(chip, 4, 2, base::Time::fromMilliseconds(10));
+    ASSERT_THROW(ramp.setTarget(3, 0.5), std::invalid_argument);
+    ASSERT_THROW(ramp.setTarget(6, 0.5), std::invalid_argument);
+}
+
+TEST_F(PCA9685Test, it_does_not_allocate_when_updating_the_outputs)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    std::array<float, 16> ratios;
+    ratios.fill(0.25);
+    std::array<uint32_t, 16> durations;
+    durations.fill(1500000);
+    std::array<PCA9685::PWMConfiguration, 16> configurations;
+    float ratio = 0.75;
+    uint32_t duration = 1000000;
+
+    auto before = tests::allocationCount();
+    chip.writeDutyRatios(ratios);
+    chip.writeDutyTimes(durations, 20000000);
+    chip.writePWMConfigurations(configurations);
+    chip.writeDutyRatios(3, &ratio, 1);
+    chip.writeDutyTimes(4, &duration, 1, 20000000);
+    ASSERT_EQ(before, tests::allocationCount());
+
+    ASSERT_EQ(3071, device.getPWMConfiguration(3).off_edge);
+    ASSERT_EQ(204, device.getPWMConfiguration(4).off_edge);
+}
+
+TEST_F(PCA9685Test, it_rejects_duty_updates_beyond_the_last_output)
+{
+    PCA9685 chip(bus, 0x40);
+    std::vector<float> ratios(17, 0.5);
+    ASSERT_THROW(chip.writeDutyRatios(0, ratios), std::invalid_argument);
+    ASSERT_THROW(chip.writeDutyRatios(15, ratios.data(), 2), std::invalid_argument);
+    std::vector<uint32_t> durations(17, 1000);
+    ASSERT_THROW(chip.writeDutyTimes(0, durations, 20000000), std::invalid_argument);
+}
+
+TEST_F(PCA9685Test, it_rounds_duty_durations_to_the_closest_tick)
+{
+    std::mt19937 rng(42);
+    for (int prescale = 3; prescale < 256; ++prescale) {
+        for (float freq : {25e6f, 24.6e6f, 50e6f}) {
+            uint32_t period = PCA9685::prescaleToPeriod(prescale, freq);
+            PCA9685DutyConversion conversion(period);
+            std::uniform_int_distribution<uint32_t> distribution(0, period);
+            for (int i = 0; i < 200; ++i) {
+                uint64_t ns = distribution(rng);
+                uint64_t expected = (ns * 4096 + period / 2) / period;
+                ASSERT_EQ(expected, conversion.durationToTicks(ns))
+                    << "period=" << period << " ns=" << ns;
+            }
+
+            ASSERT_EQ(4096, conversion.durationToTicks(period));
+            ASSERT_EQ(4096, conversion.durationToTicks(UINT32_MAX));
+        }
+    }
+}
+
+TEST_F(PCA9685Test, it_rounds_every_duty_duration_of_a_servo_period_exactly)
+{
+    uint32_t period = PCA9685::prescaleToPeriod(121);
+    PCA9685DutyConversion conversion(period);
+    for (uint64_t ns = 0; ns <= period; ++ns) {
+        uint64_t expected = (ns * 4096 + period / 2) / period;
+        ASSERT_EQ(expected, conversion.durationToTicks(ns)) << ns;
+    }
+}
+
+TEST_F(PCA9685Test, it_converts_batches_of_durations_like_single_durations)
+{
+    PCA9685DutyConversion conversion(PCA9685::prescaleToPeriod(121));
+    std::vector<uint32_t> durations;
+    for (int i = 0; i < 37; ++i) {
+        durations.push_back(i * 541234);
+    }
+    std::vector<PCA9685::PWMConfiguration> configurations(durations.size());
+    conversion.fromDurations(durations.data(), durations.size(), configurations.data());
+    for (size_t i = 0; i < durations.size(); ++i) {
+        auto expected = conversion.fromDuration(durations[i]);
+        ASSERT_EQ(expected.mode, configurations[i].mode);
+        ASSERT_EQ(expected.off_edge, configurations[i].off_edge);
+    }
+}
+
+TEST_F(PCA9685Test, it_rounds_duty_ratios_like_std_round)
+{
+    for (int i = -100; i < 4096 * 8 + 100; ++i) {
+        float ratio = i / (4096.0f * 8);
+        uint32_t expected = std::min<float>(std::max<float>(std::round(ratio * 4096), 0), 4096);
+        ASSERT_EQ(expected, PCA9685DutyConversion::ratioToTicks(ratio)) << ratio;
+    }
+    // The largest float below 0.5 ticks, which rounds to 1 when adding 0.5f
+    ASSERT_EQ(0, PCA9685DutyConversion::ratioToTicks(std::nextafter(0.5f, 0.0f) / 4096));
+    ASSERT_EQ(0, PCA9685DutyConversion::ratioToTicks(NAN));
+}
+
+TEST_F(PCA9685Test, it_wraps_the_edges_shifted_by_a_phase_around_the_cycle)
+{
+    PCA9685::PWMConfiguration configuration;
+    configuration.mode = PCA9685::PWMConfiguration::MODE_NORMAL;
+    configuration.on_edge = 0;
+    configuration.off_edge = 2047;
+
+    uint8_t registers[4];
+    PCA9685::pwmConfigurationToRegisters(registers, configuration, 3840);
+    ASSERT_EQ(3840, registers[0] | registers[1] << 8);
+    ASSERT_EQ(1791, registers[2] | registers[3] << 8);
+    ASSERT_THROW(PCA9685::pwmConfigurationToRegisters(registers, configuration, 4096),
+        std::invalid_argument);
+}
+
+TEST_F(PCA9685Test, it_staggers_the_on_edges_while_keeping_the_duty_cycles)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    chip.setPhaseMode(PCA9685::PHASE_STAGGERED);
+    std::array<float, 16> ratios;
+    ratios.fill(0.5);
+    ratios[2] = 0;
+    ratios[5] = 1;
+    chip.writeDutyRatios(ratios);
+
+    for (int i = 0; i < 16; ++i) {
+        auto configuration = device.getPWMConfiguration(i);
+        if (i == 2) {
+            ASSERT_EQ(PCA9685PWMConfiguration::MODE_OFF, configuration.mode);
+            continue;
+        }
+        else if (i == 5) {
+            ASSERT_EQ(PCA9685PWMConfiguration::MODE_ON, configuration.mode);
+            continue;
+        }
+
+        ASSERT_EQ(PCA9685PWMConfiguration::MODE_NORMAL, configuration.mode);
+        ASSERT_EQ(i * 256, configuration.on_edge);
+        ASSERT_EQ(2047, (configuration.off_edge - configuration.on_edge + 4096) % 4096);
+    }
+
+    chip.setPhaseMode(PCA9685::PHASE_ALIGNED);
+    chip.writeDutyRatios(ratios);
+    ASSERT_EQ(0, device.getPWMConfiguration(15).on_edge);
+    ASSERT_EQ(2047, device.getPWMConfiguration(15).off_edge);
+}
+
+TEST_F(PCA9685Test, it_writes_staged_configurations_in_a_single_transfer)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+
+    auto half = PCA9685::PWMConfiguration::fromDutyRatio(0.5);
+    chip.stagePWMConfigurations(1, &half, 1);
+    ASSERT_TRUE(chip.hasStagedPWMConfigurations());
+    auto transfers = bus.getTransferCount();
+    chip.writePWMConfigurations(12, &half, 1);
+
+    ASSERT_EQ(transfers + 1, bus.getTransferCount());
+    ASSERT_FALSE(chip.hasStagedPWMConfigurations());
+    ASSERT_EQ(2047, device.getPWMConfiguration(1).off_edge);
+    ASSERT_EQ(2047, device.getPWMConfiguration(12).off_edge);
+    ASSERT_EQ(PCA9685PWMConfiguration::MODE_OFF, device.getPWMConfiguration(2).mode);
+}
+
+struct PCA9685ArrayTest : public ::testing::Test {
+    SimulatedI2CBus bus;
+    SimulatedPCA9685 devices[6];
+    SimulatedBroadcastDevice allcall;
+
+    PCA9685ArrayTest()
+    {
+        for (int i = 0; i < 6; ++i) {
+            bus.attach(0x40 + i, devices[i]);
+            allcall.add(devices[i]);
+        }
+        bus.attach(PCA9685Array::DEFAULT_ALLCALL_ADDRESS, allcall);
+    }
+};
+
+TEST_F(PCA9685ArrayTest, it_writes_ranges_spanning_several_chips_in_a_single_transfer)
+{
+    PCA9685Array array(bus, {0x40, 0x41, 0x42});
+    ASSERT_EQ(48, array.getPWMCount());
+    array.writeNormalMode();
+
+    auto transfers = bus.getTransferCount();
+    std::vector<float> ratios(20, 0.5);
+    array.writeDutyRatios(14, ratios);
+    ASSERT_EQ(transfers + 1, bus.getTransferCount());
+
+    for (int i = 0; i < 48; ++i) {
+        auto configuration = devices[i / 16].getPWMConfiguration(i % 16);
+        if (i >= 14 && i < 34) {
+            ASSERT_EQ(PCA9685PWMConfiguration::MODE_NORMAL, configuration.mode);
+            ASSERT_EQ(2047, configuration.off_edge);
+        }
+        else {
+            ASSERT_EQ(PCA9685PWMConfiguration::MODE_OFF, configuration.mode);
+        }
+    }
+
+    // Only the chips whose registers changed are written
+    auto bytes = bus.getByteCount();
+    ratios[19] = 0.25;
+    array.writeDutyRatios(14, ratios);
+    ASSERT_EQ(bytes + 3, bus.getByteCount());
+    ASSERT_EQ(1023, devices[2].getPWMConfiguration(1).off_edge);
+}
+
+TEST_F(PCA9685ArrayTest, it_reads_back_the_prescale_if_it_was_written_while_awake)
+{
+    PCA9685Array array(bus, {0x40, 0x41, 0x42});
+    array.writeNormalMode();
+    array.writePrescale(121);
+    ASSERT_EQ(30, devices[1].getRegister(SimulatedPCA9685::REGISTER_PRESCALE));
+
+    uint32_t duration = 1500000;
+    array.getChip(1).writeDutyTimes(0, &duration, 1);
+    ASSERT_EQ(1209, devices[1].getPWMConfiguration(0).off_edge);
+}
+
+TEST_F(PCA9685ArrayTest, it_writes_global_commands_once_over_allcall)
+{
+    PCA9685Array array(bus, {0x40, 0x41, 0x42});
+
+    auto transfers = bus.getTransferCount();
+    array.writeSleepMode();
+    array.writePrescale(121);
+    array.writeNormalMode();
+    array.writeAllDutyRatios(0.5);
+    ASSERT_EQ(transfers + 4, bus.getTransferCount());
+
+    for (auto const& device : devices) {
+        ASSERT_EQ(121, device.getRegister(SimulatedPCA9685::REGISTER_PRESCALE));
+        ASSERT_FALSE(device.getRegister(SimulatedPCA9685::REGISTER_MODE1) &
+                     SimulatedPCA9685::MODE1_SLEEP);
+        for (int i = 0; i < 16; ++i) {
+            ASSERT_EQ(2047, device.getPWMConfiguration(i).off_edge);
+        }
+    }
+
+    // The register caches know what the broadcast wrote
+    std::vector<float> ratios(48, 0.5);
+    array.writeDutyRatios(0, ratios);
+    ASSERT_EQ(transfers + 4, bus.getTransferCount());
+
+    array.stop();
+    ASSERT_EQ(transfers + 5, bus.getTransferCount());
+    for (auto const& device : devices) {
+        for (int i = 0; i < 16; ++i) {
+            ASSERT_EQ(PCA9685PWMConfiguration::MODE_OFF, device.getPWMConfiguration(i).mode);
+        }
+    }
+}
+
+TEST_F(PCA9685ArrayTest, it_writes_each_chip_mode_when_they_differ)
+{
+    PCA9685Array array(bus, {0x40, 0x41, 0x42});
+    array.getChip(1).enableExternalClock();
+    array.writeNormalMode();
+
+    for (int i = 0; i < 3; ++i) {
+        uint8_t mode1 = devices[i].getRegister(SimulatedPCA9685::REGISTER_MODE1);
+        ASSERT_FALSE(mode1 & SimulatedPCA9685::MODE1_SLEEP);
+        ASSERT_EQ(i == 1, (mode1 & 0x40) != 0);
+    }
+}
+
+TEST_F(PCA9685ArrayTest, it_does_not_broadcast_identical_duty_cycles_when_staggered)
+{
+    PCA9685Array array(bus, {0x40, 0x41, 0x42});
+    array.writeNormalMode();
+    array.setPhaseMode(PCA9685::PHASE_STAGGERED);
+    array.writeAllDutyRatios(0.5);
+
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(256 * 3, devices[i].getPWMConfiguration(3).on_edge);
+    }
+}
+
+TEST_F(PCA9685ArrayTest, it_rejects_ranges_beyond_the_last_chip)
+{
+    PCA9685Array array(bus, {0x40, 0x41});
+    std::vector<float> ratios(2, 0.5);
+    ASSERT_THROW(array.writeDutyRatios(31, ratios), std::invalid_argument);
+    ASSERT_THROW(PCA9685Array(bus, {0x40, 0x70}), std::invalid_argument);
+}
+
+TEST_F(PCA9685Test, it_writes_all_registers_of_the_changed_outputs_when_changing_on_ACK)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    chip.writeOutputChange(PCA9685::OUTPUT_CHANGE_ON_ACK);
+    ASSERT_EQ(PCA9685::OUTPUT_CHANGE_ON_ACK, chip.getOutputChange());
+    ASSERT_TRUE(device.getRegister(SimulatedPCA9685::REGISTER_MODE2) & 0x08);
+
+    std::vector<float> ratios(16, 0.5);
+    chip.writeDutyRatios(0, ratios);
+
+    // Only OFF_H changes, but the chip waits for all four registers
+    auto bytes = bus.getByteCount();
+    ratios[7] = 0.25;
+    chip.writeDutyRatios(0, ratios);
+    ASSERT_EQ(bytes + 2 + 4, bus.getByteCount());
+    ASSERT_EQ(1023, device.getPWMConfiguration(7).off_edge);
+
+    chip.writeOutputChange(PCA9685::OUTPUT_CHANGE_ON_STOP);
+    ASSERT_FALSE(device.getRegister(SimulatedPCA9685::REGISTER_MODE2) & 0x08);
+}
+
+TEST_F(PCA9685ArrayTest, it_writes_staged_updates_of_all_chips_on_commit)
+{
+    PCA9685Array array(bus, {0x40, 0x41, 0x42});
+    array.writeNormalMode();
+
+    auto transfers = bus.getTransferCount();
+    float ratios[] = {0.5, 0.5};
+    array.stageDutyRatios(3, ratios, 2);
+    array.stageDutyRatios(40, ratios, 2);
+    uint32_t durations[] = {1500000};
+    array.stageDutyTimes(20, durations, 1, 20000000);
+    ASSERT_TRUE(array.hasStagedPWMConfigurations());
+    ASSERT_EQ(transfers, bus.getTransferCount());
+    ASSERT_EQ(PCA9685PWMConfiguration::MODE_OFF, devices[0].getPWMConfiguration(3).mode);
+
+    array.commit();
+    ASSERT_EQ(transfers + 1, bus.getTransferCount());
+    ASSERT_FALSE(array.hasStagedPWMConfigurations());
+    ASSERT_EQ(2047, devices[0].getPWMConfiguration(4).off_edge);
+    ASSERT_EQ(307 - 1, devices[1].getPWMConfiguration(4).off_edge);
+    ASSERT_EQ(2047, devices[2].getPWMConfiguration(9).off_edge);
+    ASSERT_EQ(PCA9685PWMConfiguration::MODE_OFF, devices[2].getPWMConfiguration(10).mode);
+}
+
+TEST_F(PCA9685ArrayTest, it_writes_one_message_per_chip_when_a_commit_needs_too_many)
+{
+    PCA9685Array array(bus, {0x40, 0x41, 0x42, 0x43, 0x44, 0x45});
+    array.writeNormalMode();
+    std::vector<float> ratios(96, 0.5);
+    array.writeDutyRatios(0, ratios);
+
+    // Changing every other output needs 8 writes per chip, 48 in total
+    for (int i = 0; i < 96; i += 2) {
+        ratios[i] = 0.25;
+    }
+    auto transfers = bus.getTransferCount();
+    auto bytes = bus.getByteCount();
+    array.writeDutyRatios(0, ratios);
+
+    // From OFF_H of the first output to OFF_H of the 15th output
+    ASSERT_EQ(transfers + 1, bus.getTransferCount());
+    ASSERT_EQ(bytes + 6 * (2 + 14 * 4 + 1), bus.getByteCount());
+    for (int i = 0; i < 96; ++i) {
+        ASSERT_EQ(i % 2 ? 2047 : 1023, devices[i / 16].getPWMConfiguration(i % 16).off_edge);
+    }
+}
+
+TEST_F(PCA9685Test, it_computes_the_oscillator_frequency_from_a_measured_period)
+{
+    ASSERT_NEAR(25e6, PCA9685::measuredOscillatorFrequency(121, 19988480), 1);
+    ASSERT_NEAR(26e6, PCA9685::measuredOscillatorFrequency(121, 19219692), 1);
+    ASSERT_THROW(PCA9685::measuredOscillatorFrequency(121, 0), std::invalid_argument);
+}
+
+TEST_F(PCA9685Test, it_uses_the_calibrated_oscillator_frequency_for_periods_and_durations)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.setOscillatorFrequency(26e6);
+    chip.writeSleepMode();
+    ASSERT_EQ(20007385, chip.writePWMPeriod(20000000));
+    ASSERT_EQ(126, device.getRegister(SimulatedPCA9685::REGISTER_PRESCALE));
+    ASSERT_EQ(20007385, chip.readPWMPeriod());
+
+    // The nominal frequency would give 410 ticks
+    chip.writeNormalMode();
+    uint32_t duration = 2000000;
+    chip.writeDutyTimes(0, &duration, 1);
+    ASSERT_EQ(408, device.getPWMConfiguration(0).off_edge);
+}
+
+TEST_F(PCA9685Test, it_reads_back_the_prescale_if_it_was_written_while_awake)
+{
+    PCA9685 chip(bus, 0x40);
+    chip.writeNormalMode();
+    // Ignored by the chip, which stays at 200Hz
+    chip.writePWMPeriod(20000000);
+    ASSERT_EQ(30, device.getRegister(SimulatedPCA9685::REGISTER_PRESCALE));
+
+    uint32_t duration = 1500000;
+    chip.writeDutyTimes(0, &duration, 1);
+    ASSERT_EQ(1209, device.getPWMConfiguration(0).off_edge);
+}
+
+TEST_F(PCA9685Test, it_persists_the_oscillator_frequency_in_a_calibration_cache)
+{
+    CalibrationCache cache;
+    PCA9685 chip(bus, 0x40);
+    chip.setOscillatorFrequency(25.6e6);
+    chip.saveOscillatorFrequency(cache, "/dev/i2c-1");
+
+    PCA9685 calibrated(bus, 0x40, cache, "/dev/i2c-1");
+    ASSERT_FLOAT_EQ(25.6e6, calibrated.getOscillatorFrequency());
+    PCA9685 other(bus, 0x41, cache, "/dev/i2c-1");
+    ASSERT_FLOAT_EQ(PCA9685::INTERNAL_OSCILLATOR_FREQUENCY, other.getOscillatorFrequency());
+}
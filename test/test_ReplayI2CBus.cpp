@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include <i2clib/BMP280.hpp>
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/MS5837.hpp>
+#include <i2clib/PCA9685.hpp>
+#include <i2clib/RecordingI2CBus.hpp>
+#include <i2clib/ReplayI2CBus.hpp>
+#include <i2clib/SimulatedBMP280.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+#include <i2clib/SimulatedMS5837.hpp>
+#include <i2clib/SimulatedPCA9685.hpp>
+
+#include <sstream>
+
+using namespace i2clib;
+
+struct ReplayI2CBusTest : public ::testing::Test {
+    SimulatedI2CBus simulated_bus;
+    std::stringstream log;
+    RecordingI2CBus recorder{simulated_bus, log};
+};
+
+TEST_F(ReplayI2CBusTest, it_replays_a_BMP280_forced_measurement)
+{
+    SimulatedBMP280 device;
+    simulated_bus.attach(0x76, device);
+    BMP280::Calibration calibration;
+    calibration.dig_T1 = 27504;
+    calibration.dig_T2 = 26435;
+    calibration.dig_T3 = -1000;
+    calibration.dig_P1 = 36477;
+    calibration.dig_P2 = -10685;
+    calibration.dig_P3 = 3024;
+    calibration.dig_P4 = 2855;
+    calibration.dig_P5 = 140;
+    calibration.dig_P6 = -7;
+    calibration.dig_P7 = 15500;
+    calibration.dig_P8 = -14600;
+    calibration.dig_P9 = 6000;
+    device.setCalibration(calibration);
+    device.setRawMeasurements(BMP280::RawMeasurements{415148, 519888});
+    device.setMeasurementDuration(base::Time::fromMicroseconds(2000));
+
+    BMP280 recorded_chip(recorder, 0x76);
+    auto recorded = recorded_chip.readForced();
+
+    ReplayI2CBus replay(log);
+    BMP280 chip(replay, 0x76);
+    auto measurement = chip.readForced();
+    ASSERT_TRUE(replay.atEnd());
+    ASSERT_FLOAT_EQ(recorded.temperature.getCelsius(), measurement.temperature.getCelsius());
+    ASSERT_FLOAT_EQ(recorded.pressure.toPa(), measurement.pressure.toPa());
+}
+
+TEST_F(ReplayI2CBusTest, it_replays_a_MS5837_measurement_cycle)
+{
+    SimulatedMS5837 device;
+    simulated_bus.attach(118, device);
+    MS5837::PROM prom;
+    prom.C[0] = 0;
+    prom.C[1] = 34982;
+    prom.C[2] = 36352;
+    prom.C[3] = 20328;
+    prom.C[4] = 22354;
+    prom.C[5] = 26646;
+    prom.C[6] = 26146;
+    device.setPROM(prom);
+    device.setRawMeasurements(4958179, 6815414);
+
+    MS5837 recorded_chip(MS5837::MODEL_30BA, recorder);
+    recorded_chip.readPROM();
+    auto recorded = recorded_chip.read(0, 0);
+
+    ReplayI2CBus replay(log);
+    MS5837 chip(MS5837::MODEL_30BA, replay);
+    ASSERT_EQ(device.getPROM().C, chip.readPROM().C);
+    auto measurement = chip.read(0, 0);
+    ASSERT_TRUE(replay.atEnd());
+    ASSERT_FLOAT_EQ(recorded.pressure.toBar(), measurement.pressure.toBar());
+}
+
+TEST_F(ReplayI2CBusTest, it_replays_PCA9685_batch_writes)
+{
+    SimulatedPCA9685 device;
+    simulated_bus.attach(0x40, device);
+
+    PCA9685 recorded_chip(recorder, 0x40);
+    recorded_chip.writeNormalMode();
+    recorded_chip.writeDutyRatios(0, {0.1, 0.2, 0.3, 0.4});
+    recorded_chip.writeDutyRatios(0, {0.1, 0.5, 0.3, 0.4});
+
+    ReplayI2CBus replay(log);
+    PCA9685 chip(replay, 0x40);
+    chip.writeNormalMode();
+    chip.writeDutyRatios(0, {0.1, 0.2, 0.3, 0.4});
+    chip.writeDutyRatios(0, {0.1, 0.5, 0.3, 0.4});
+    ASSERT_TRUE(replay.atEnd());
+}
+
+TEST_F(ReplayI2CBusTest, it_replays_errors)
+{
+    uint8_t bytes[2] = {1, 2};
+    ASSERT_THROW(recorder.write(0x41, bytes, 2), WriteError);
+
+    SimulatedRegisterDevice device;
+    simulated_bus.attach(0x40, device);
+    I2CTransactionBatch batch;
+    batch.write(0x40, bytes, 2);
+    batch.write(0x41, bytes, 2);
+    batch.write(0x40, bytes, 2);
+    ASSERT_THROW(recorder.transfer(batch), BatchError);
+
+    ReplayI2CBus replay(log);
+    try {
+        replay.write(0x41, bytes, 2);
+        FAIL() << "the write did not fail";
+    }
+    catch (WriteError const& e) {
+        ASSERT_EQ(ENXIO, e.error_code);
+    }
+    try {
+        replay.transfer(batch);
+        FAIL() << "the batch did not fail";
+    }
+    catch (BatchError const& e) {
+        ASSERT_EQ(ENXIO, e.error_code);
+        ASSERT_EQ(1u, e.first_message);
+    }
+    ASSERT_TRUE(replay.atEnd());
+}
+
+TEST_F(ReplayI2CBusTest, it_fails_if_the_transactions_do_not_match_the_log)
+{
+    SimulatedRegisterDevice device;
+    simulated_bus.attach(0x40, device);
+    recorder.write(0x40, {0x10, 1});
+
+    ReplayI2CBus replay(log);
+    ASSERT_THROW(replay.write(0x40, {0x10, 2}), ReplayError);
+    ASSERT_THROW(replay.write(0x41, {0x10, 1}), ReplayError);
+    ASSERT_THROW(replay.read<1>(0x40, 0x10), ReplayError);
+    replay.write(0x40, {0x10, 1});
+    ASSERT_THROW(replay.write(0x40, {0x10, 1}), ReplayError);
+}
+
+TEST_F(ReplayI2CBusTest, it_rejects_streams_that_are_not_logs)
+{
+    std::stringstream stream("not a log");
+    ASSERT_THROW(ReplayI2CBus{stream}, std::runtime_error);
+}
+
+TEST_F(ReplayI2CBusTest, it_optionally_replays_with_the_original_timing)
+{
+    SimulatedRegisterDevice device;
+    simulated_bus.attach(0x40, device);
+    simulated_bus.setLatency(base::Time::fromMilliseconds(5));
+    for (int i = 0; i < 4; ++i) {
+        recorder.write(0x40, {0x10, 1});
+    }
+
+    auto entries = I2CTransactionLog::readAll(log);
+    ReplayI2CBus full_speed(entries);
+    ReplayI2CBus original_timing(entries, ReplayI2CBus::REPLAY_ORIGINAL_TIMING);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; ++i) {
+        full_speed.write(0x40, {0x10, 1});
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; ++i) {
+        original_timing.write(0x40, {0x10, 1});
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    ASSERT_LT(middle - start, std::chrono::milliseconds(5));
+    ASSERT_GE(end - middle, std::chrono::milliseconds(20));
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <i2clib/Exceptions.hpp>
+#include <i2clib/SimulatedI2CBus.hpp>
+
+#include <chrono>
+
+using namespace i2clib;
+
+struct SimulatedI2CBusTest : public ::testing::Test {
+    SimulatedI2CBus bus;
+    SimulatedRegisterDevice device;
+};
+
+TEST_F(SimulatedI2CBusTest, it_writes_and_reads_registers_with_auto_increment)
+{
+    bus.attach(0x40, device);
+    bus.write(0x40, {0x10, 1, 2, 3});
+
+    auto bytes = bus.read<3>(0x40, 0x10);
+    ASSERT_EQ(1, bytes[0]);
+    ASSERT_EQ(2, bytes[1]);
+    ASSERT_EQ(3, bytes[2]);
+}
+
+TEST_F(SimulatedI2CBusTest, it_fails_like_a_NAK_if_no_device_is_attached)
+{
+    try {
+        bus.write(0x40, {0x10, 1});
+        FAIL();
+    }
+    catch (WriteError const& e) {
+        ASSERT_EQ(ENXIO, e.error_code);
+    }
+    ASSERT_THROW(bus.read<1>(0x40, 0x10), ReadError);
+}
+
+TEST_F(SimulatedI2CBusTest, it_reports_the_failed_message_of_a_batch)
+{
+    bus.attach(0x40, device);
+
+    uint8_t write_bytes[2] = {0x10, 1};
+    uint8_t read_bytes[1];
+    I2CTransactionBatch batch;
+    batch.write(0x40, write_bytes, 2);
+    batch.read(0x41, write_bytes, 1, read_bytes, 1);
+
+    try {
+        bus.transfer(batch);
+        FAIL();
+    }
+    catch (BatchError const& e) {
+        ASSERT_EQ(1, e.first_message);
+        ASSERT_EQ(1, e.message_count);
+    }
+    ASSERT_EQ(1, device.getRegister(0x10));
+}
+
+TEST_F(SimulatedI2CBusTest, it_performs_a_batch_in_a_single_transfer)
+{
+    SimulatedRegisterDevice other;
+    bus.attach(0x40, device);
+    bus.attach(0x41, other);
+
+    uint8_t write_bytes[2] = {0x10, 1};
+    uint8_t read_bytes[2];
+    I2CTransactionBatch batch;
+    batch.write(0x40, write_bytes, 2);
+    batch.write(0x41, write_bytes, 2);
+    batch.read(0x40, write_bytes, 1, read_bytes, 1);
+    batch.read(0x41, write_bytes, 1, read_bytes + 1, 1);
+    bus.transfer(batch);
+
+    ASSERT_EQ(1, read_bytes[0]);
+    ASSERT_EQ(1, read_bytes[1]);
+    ASSERT_EQ(1, bus.getTransferCount());
+    ASSERT_EQ(14, bus.getByteCount());
+}
+
+TEST_F(SimulatedI2CBusTest, it_simulates_the_transfer_latency)
+{
+    bus.attach(0x40, device);
+    bus.setLatency(base::Time::fromMilliseconds(1), base::Time::fromMicroseconds(100));
+
+    auto start = std::chrono::steady_clock::now();
+    bus.write(0x40, {0x10, 1, 2, 3});
+    auto duration = std::chrono::steady_clock::now() - start;
+    ASSERT_GE(duration, std::chrono::microseconds(1500));
+}